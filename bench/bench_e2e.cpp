@@ -0,0 +1,322 @@
+// End-to-end throughput of the convert_grayscale CLI over generated datasets,
+// for a list of thread counts, written as JSON.
+//
+// Usage: bench_e2e [--datasets small,medium,large,gigapixel] [--threads 1,2,4]
+//                  [--repetitions N] [--work DIR] [--converter PATH]
+//                  [--method M] [--args "EXTRA CLI OPTIONS"] [--output FILE]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <ctime>
+#include <filesystem>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <iterator>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "dataset.hpp"
+#include "json.hpp"
+#include "thread_pool.hpp"
+
+#ifndef GRAYSCALE_VERSION
+#define GRAYSCALE_VERSION "unknown"
+#endif
+
+namespace fs = std::filesystem;
+
+namespace {
+
+struct Preset {
+    std::string name;
+    DatasetSpec spec;
+};
+
+DatasetSpec makeSpec(std::size_t count, int minSide, int maxSide, SizeDistribution distribution,
+                     PnmEncoding encoding) {
+    DatasetSpec spec;
+    spec.count = count;
+    spec.minWidth = spec.minHeight = minSide;
+    spec.maxWidth = spec.maxHeight = maxSide;
+    spec.distribution = distribution;
+    spec.encoding = encoding;
+    spec.content = DatasetContent::Gradient;
+    spec.seed = 2024;
+    return spec;
+}
+
+// small: many files, dominated by per-file costs; medium: mixed sizes;
+// large and gigapixel: band parallelism within one image
+const std::vector<Preset>& presets() {
+    static const std::vector<Preset> all = {
+        {"small", makeSpec(2000, 100, 100, SizeDistribution::Fixed, PnmEncoding::Plain)},
+        {"medium", makeSpec(200, 256, 2048, SizeDistribution::LogUniform, PnmEncoding::Raw)},
+        {"large", makeSpec(4, 8192, 8192, SizeDistribution::Fixed, PnmEncoding::Raw)},
+        {"gigapixel", makeSpec(1, 32768, 32768, SizeDistribution::Fixed, PnmEncoding::Raw)},
+    };
+    return all;
+}
+
+std::string describe(const DatasetSpec& spec) {
+    std::ostringstream text;
+    text << "count " << spec.count << " size " << spec.minWidth << "x" << spec.minHeight << "-" << spec.maxWidth
+         << "x" << spec.maxHeight << " distribution " << static_cast<int>(spec.distribution) << " content "
+         << static_cast<int>(spec.content) << " encoding " << static_cast<int>(spec.encoding) << " seed "
+         << spec.seed << "\n";
+    return text.str();
+}
+
+// Generates the dataset into `folder` unless a previous run left the same
+// one there, recorded in dataset.txt (ignored by the converter, which only
+// lists .ppm files).
+bool prepareDataset(const DatasetSpec& spec, const fs::path& folder, ThreadPool& pool) {
+    fs::path stamp = folder / "dataset.txt";
+    std::ifstream in(stamp);
+    std::string previous((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+    if (previous == describe(spec)) return true;
+
+    std::error_code ec;
+    fs::remove_all(folder, ec);
+    fs::create_directories(folder, ec);
+    if (ec) return false;
+    std::cout << "generating " << folder.string() << "\n";
+    std::vector<char> ok(spec.count, 0);
+    for (std::size_t k = 0; k < spec.count; ++k)
+        pool.submit([&, k] { ok[k] = writeDatasetImage(spec, k, (folder / datasetImageName(k)).string()); });
+    pool.wait();
+    if (std::count(ok.begin(), ok.end(), 0) != 0) return false;
+    std::ofstream(stamp) << describe(spec);
+    return true;
+}
+
+std::uint64_t folderBytes(const fs::path& folder) {
+    std::uint64_t bytes = 0;
+    for (const auto& entry : fs::directory_iterator(folder))
+        if (entry.path().extension() == ".ppm") bytes += entry.file_size();
+    return bytes;
+}
+
+// single quotes for the shell, with embedded quotes closed and escaped
+std::string shellQuoted(const std::string& text) {
+    std::string out = "'";
+    for (char c : text) out += c == '\'' ? std::string("'\\''") : std::string(1, c);
+    return out + "'";
+}
+
+std::vector<unsigned> parseThreadList(const std::string& text) {
+    std::vector<unsigned> threads;
+    std::stringstream list(text);
+    std::string item;
+    while (std::getline(list, item, ',')) {
+        char* end = nullptr;
+        long value = std::strtol(item.c_str(), &end, 10);
+        if (item.empty() || *end != '\0' || value < 1 || value > 1024) return {};
+        threads.push_back(static_cast<unsigned>(value));
+    }
+    return threads;
+}
+
+// 1, 2, 4, ... up to the hardware threads, which are always included
+std::vector<unsigned> defaultThreads() {
+    unsigned hardware = std::max(1u, std::thread::hardware_concurrency());
+    std::vector<unsigned> threads;
+    for (unsigned t = 1; t < hardware; t *= 2) threads.push_back(t);
+    threads.push_back(hardware);
+    return threads;
+}
+
+struct Run {
+    std::string dataset;
+    unsigned threads = 0;
+    std::vector<double> seconds;
+    double best = 0;
+    double median = 0;
+};
+
+struct DatasetResult {
+    std::string name;
+    DatasetSpec spec;
+    std::uint64_t bytes = 0;
+    double pixels = 0;
+};
+
+void printUsage() {
+    std::cerr << "Usage: bench_e2e [--datasets LIST] [--threads LIST] [--repetitions N] [--work DIR]\n"
+              << "                 [--converter PATH] [--method M] [--args \"OPTIONS\"] [--output FILE]\n"
+              << "  --datasets LIST    of small, medium, large, gigapixel (default: small,medium,large)\n"
+              << "  --threads LIST     thread counts to run with (default: 1, 2, 4, ... hardware threads)\n"
+              << "  --repetitions N    timed runs after one warm-up run (default: 3)\n"
+              << "  --work DIR         where datasets are kept between runs (default: bench_e2e_data)\n"
+              << "  --converter PATH   the CLI to run (default: convert_grayscale next to bench_e2e)\n"
+              << "  --method M         methods argument of the CLI (default: Luminosity)\n"
+              << "  --args OPTIONS     extra CLI options, e.g. \"--pipeline --output-format P5\"\n"
+              << "  --output FILE      JSON results (default: bench_e2e.json)\n";
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[]) {
+    std::vector<std::string> datasetNames = {"small", "medium", "large"};
+    std::vector<unsigned> threadCounts = defaultThreads();
+    int repetitions = 3;
+    fs::path work = "bench_e2e_data";
+    fs::path converter = fs::path(argv[0]).parent_path() / "convert_grayscale";
+    std::string method = "Luminosity";
+    std::string extraArgs;
+    std::string outputPath = "bench_e2e.json";
+    for (int i = 1; i < argc; ++i) {
+        std::string option = argv[i];
+        if (i + 1 >= argc) {
+            printUsage();
+            return 1;
+        }
+        std::string value = argv[++i];
+        if (option == "--datasets") {
+            datasetNames.clear();
+            std::stringstream list(value);
+            std::string item;
+            while (std::getline(list, item, ',')) datasetNames.push_back(item);
+        } else if (option == "--threads") {
+            threadCounts = parseThreadList(value);
+        } else if (option == "--repetitions") {
+            repetitions = std::atoi(value.c_str());
+        } else if (option == "--work") {
+            work = value;
+        } else if (option == "--converter") {
+            converter = value;
+        } else if (option == "--method") {
+            method = value;
+        } else if (option == "--args") {
+            extraArgs = value;
+        } else if (option == "--output") {
+            outputPath = value;
+        } else {
+            printUsage();
+            return 1;
+        }
+    }
+    if (threadCounts.empty() || repetitions < 1) {
+        printUsage();
+        return 1;
+    }
+    if (!fs::exists(converter)) {
+        std::cerr << "Converter not found: " << converter.string() << "\n";
+        return 1;
+    }
+
+    std::vector<DatasetResult> datasets;
+    {
+        ThreadPool pool(std::thread::hardware_concurrency());
+        for (const std::string& name : datasetNames) {
+            auto preset = std::find_if(presets().begin(), presets().end(),
+                                       [&](const Preset& p) { return p.name == name; });
+            if (preset == presets().end()) {
+                std::cerr << "Unknown dataset: " << name << "\n";
+                return 1;
+            }
+            DatasetResult dataset{name, preset->spec};
+            if (!prepareDataset(dataset.spec, work / name, pool)) {
+                std::cerr << "Failed to generate " << (work / name).string() << "\n";
+                return 1;
+            }
+            dataset.bytes = folderBytes(work / name);
+            for (std::size_t k = 0; k < dataset.spec.count; ++k) {
+                int width = 0;
+                int height = 0;
+                datasetImageSize(dataset.spec, k, width, height);
+                dataset.pixels += static_cast<double>(width) * height;
+            }
+            datasets.push_back(dataset);
+        }
+    }
+
+    std::vector<Run> runs;
+    std::cout << "dataset     threads   images/s       MB/s      Mpx/s  speedup\n";
+    for (const DatasetResult& dataset : datasets) {
+        fs::path output = work / ("out-" + dataset.name);
+        double base = 0;
+        for (unsigned threads : threadCounts) {
+            std::string command = shellQuoted(converter.string()) + " " + shellQuoted((work / dataset.name).string()) +
+                                  " " + shellQuoted(output.string()) + " " + shellQuoted(method) + " --threads " +
+                                  std::to_string(threads) + " " + extraArgs + " > /dev/null";
+            Run run{dataset.name, threads, {}, 0, 0};
+            // the first run warms the page cache and is not timed
+            for (int r = 0; r <= repetitions; ++r) {
+                auto start = std::chrono::steady_clock::now();
+                int status = std::system(command.c_str());
+                std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+                if (status != 0) {
+                    std::cerr << "Failed to run: " << command << "\n";
+                    return 1;
+                }
+                if (r > 0) run.seconds.push_back(elapsed.count());
+            }
+            std::vector<double> sorted = run.seconds;
+            std::sort(sorted.begin(), sorted.end());
+            run.best = sorted.front();
+            run.median = sorted.size() % 2 ? sorted[sorted.size() / 2]
+                                           : (sorted[sorted.size() / 2 - 1] + sorted[sorted.size() / 2]) / 2;
+            if (base == 0) base = run.best;
+            std::cout << std::left << std::setw(10) << dataset.name << std::right << std::setw(9) << threads
+                      << std::fixed << std::setprecision(1) << std::setw(11) << dataset.spec.count / run.best
+                      << std::setw(11) << dataset.bytes / 1e6 / run.best << std::setw(11)
+                      << dataset.pixels / 1e6 / run.best << std::setprecision(2) << std::setw(8)
+                      << base / run.best << "x\n";
+            runs.push_back(run);
+        }
+        std::error_code ec;
+        fs::remove_all(output, ec);
+    }
+
+    std::ofstream out(outputPath);
+    if (!out) {
+        std::cerr << "Failed to write " << outputPath << "\n";
+        return 1;
+    }
+    char timestamp[32];
+    std::time_t now = std::time(nullptr);
+    std::strftime(timestamp, sizeof(timestamp), "%Y-%m-%dT%H:%M:%SZ", std::gmtime(&now));
+    out << std::setprecision(6) << "{\n"
+        << "  \"version\": " << jsonQuoted(GRAYSCALE_VERSION) << ",\n"
+        << "  \"timestamp\": " << jsonQuoted(timestamp) << ",\n"
+        << "  \"hardware_threads\": " << std::thread::hardware_concurrency() << ",\n"
+        << "  \"converter\": " << jsonQuoted(converter.string()) << ",\n"
+        << "  \"method\": " << jsonQuoted(method) << ",\n"
+        << "  \"args\": " << jsonQuoted(extraArgs) << ",\n"
+        << "  \"repetitions\": " << repetitions << ",\n"
+        << "  \"datasets\": [";
+    for (std::size_t d = 0; d < datasets.size(); ++d) {
+        const DatasetResult& dataset = datasets[d];
+        const DatasetSpec& spec = dataset.spec;
+        out << (d ? "," : "") << "\n    {\"name\": " << jsonQuoted(dataset.name) << ", \"images\": " << spec.count
+            << ", \"min_size\": " << jsonQuoted(std::to_string(spec.minWidth) + "x" + std::to_string(spec.minHeight))
+            << ", \"max_size\": " << jsonQuoted(std::to_string(spec.maxWidth) + "x" + std::to_string(spec.maxHeight))
+            << ", \"format\": " << jsonQuoted(spec.encoding == PnmEncoding::Raw ? "P6" : "P3")
+            << ", \"seed\": " << spec.seed << ", \"bytes\": " << dataset.bytes
+            << ", \"megapixels\": " << dataset.pixels / 1e6 << "}";
+    }
+    out << "\n  ],\n  \"runs\": [";
+    double base = 0;
+    for (std::size_t r = 0; r < runs.size(); ++r) {
+        const Run& run = runs[r];
+        const DatasetResult& dataset = *std::find_if(datasets.begin(), datasets.end(),
+                                                     [&](const DatasetResult& d) { return d.name == run.dataset; });
+        if (r == 0 || runs[r - 1].dataset != run.dataset) base = run.best;
+        out << (r ? "," : "") << "\n    {\"dataset\": " << jsonQuoted(run.dataset) << ", \"threads\": " << run.threads
+            << ", \"seconds\": [";
+        for (std::size_t k = 0; k < run.seconds.size(); ++k) out << (k ? ", " : "") << run.seconds[k];
+        out << "], \"best_seconds\": " << run.best << ", \"median_seconds\": " << run.median
+            << ", \"images_per_second\": " << dataset.spec.count / run.best
+            << ", \"mb_per_second\": " << dataset.bytes / 1e6 / run.best
+            << ", \"megapixels_per_second\": " << dataset.pixels / 1e6 / run.best
+            << ", \"speedup\": " << base / run.best << "}";
+    }
+    out << "\n  ]\n}\n";
+    std::cout << "results written to " << outputPath << "\n";
+    return out ? 0 : 1;
+}
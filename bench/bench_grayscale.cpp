@@ -0,0 +1,173 @@
+// Micro-benchmarks for convertToGrayscale, the PPM parser and the PGM
+// serializer, reported in pixels/s and bytes/s.
+//
+// Image sides go from 100 to 16384 for the conversion; parsing and
+// serialization stop at 4096 because a 16k x 16k plain file is several GB.
+#include <benchmark/benchmark.h>
+#include <cstdint>
+#include <ostream>
+#include <streambuf>
+#include <string>
+#include <vector>
+#include "image_processing.hpp"
+#include "ppm_io.hpp"
+
+namespace {
+
+const std::vector<std::int64_t> convertSizes = {100, 1000, 4096, 16384};
+const std::vector<std::int64_t> ioSizes = {100, 1000, 4096};
+
+// Square image of random samples. Benchmarks are registered size-major, so
+// keeping only the last image generated avoids regenerating it per method
+// without holding every size in memory at once.
+const RgbImage& syntheticImage(int side) {
+    static RgbImage image;
+    if (image.width != side) {
+        image = RgbImage();
+        image.resize(side, side);
+        std::uint32_t state = 1;
+        for (auto& sample : image.data) {
+            state = state * 1664525u + 1013904223u;
+            sample = static_cast<std::uint8_t>(state >> 24);
+        }
+    }
+    return image;
+}
+
+std::string encodePpm(const RgbImage& image, PnmEncoding encoding) {
+    std::string text = std::string(encoding == PnmEncoding::Plain ? "P3" : "P6") + "\n" +
+                       std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+    if (encoding == PnmEncoding::Raw) {
+        text.append(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+        return text;
+    }
+    for (int i = 0; i < image.height; ++i) {
+        const std::uint8_t* row = image.row(i);
+        for (int j = 0; j < 3 * image.width; ++j) {
+            text += std::to_string(row[j]);
+            text += j + 1 < 3 * image.width ? ' ' : '\n';
+        }
+    }
+    return text;
+}
+
+// Discards everything written to it and counts the bytes, so that the
+// serializer is measured without any file system cost.
+class CountingBuffer : public std::streambuf {
+public:
+    std::size_t bytes = 0;
+
+protected:
+    int_type overflow(int_type c) override {
+        if (c != traits_type::eof()) ++bytes;
+        return traits_type::not_eof(c);
+    }
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        bytes += static_cast<std::size_t>(n);
+        return n;
+    }
+};
+
+void setRates(benchmark::State& state, std::int64_t pixels, std::int64_t bytes) {
+    state.counters["pixels"] = benchmark::Counter(static_cast<double>(pixels), benchmark::Counter::kIsIterationInvariantRate);
+    state.SetBytesProcessed(state.iterations() * bytes);
+}
+
+const char* methodName(GrayscaleMethod method) {
+    switch (method) {
+        case GrayscaleMethod::Lightness: return "Lightness";
+        case GrayscaleMethod::Average: return "Average";
+        case GrayscaleMethod::Luminosity: return "Luminosity";
+        case GrayscaleMethod::RootMeanSquare: return "RootMeanSquare";
+        case GrayscaleMethod::RedChannel: return "RedChannel";
+        case GrayscaleMethod::GreenChannel: return "GreenChannel";
+        case GrayscaleMethod::BlueChannel: return "BlueChannel";
+        default: return "Invalid";
+    }
+}
+
+// args: side, method
+void BM_Convert(benchmark::State& state) {
+    const RgbImage& image = syntheticImage(static_cast<int>(state.range(0)));
+    GrayscaleMethod method = static_cast<GrayscaleMethod>(state.range(1));
+    state.SetLabel(methodName(method));
+
+    GrayImage gray;
+    for (auto _ : state) {
+        convertToGrayscale(image, method, gray);
+        benchmark::DoNotOptimize(gray.data.data());
+        benchmark::ClobberMemory();
+    }
+    std::int64_t pixels = static_cast<std::int64_t>(image.width) * image.height;
+    setRates(state, pixels, pixels * 4);
+}
+
+// args: side; every method in one fused sweep
+void BM_ConvertAllMethods(benchmark::State& state) {
+    const RgbImage& image = syntheticImage(static_cast<int>(state.range(0)));
+    std::vector<GrayscaleMethod> methods;
+    for (int m = 0; m < static_cast<int>(GrayscaleMethod::Invalid); ++m)
+        methods.push_back(static_cast<GrayscaleMethod>(m));
+
+    std::vector<GrayImage> gray;
+    for (auto _ : state) {
+        convertToGrayscale(image.view(), methods, gray);
+        benchmark::DoNotOptimize(gray.data());
+        benchmark::ClobberMemory();
+    }
+    std::int64_t pixels = static_cast<std::int64_t>(image.width) * image.height;
+    setRates(state, pixels, pixels * static_cast<std::int64_t>(3 + methods.size()));
+}
+
+// args: side, encoding; bytes/s counts the encoded input
+void BM_ParsePPM(benchmark::State& state) {
+    PnmEncoding encoding = static_cast<PnmEncoding>(state.range(1));
+    state.SetLabel(encoding == PnmEncoding::Plain ? "P3" : "P6");
+    std::string file = encodePpm(syntheticImage(static_cast<int>(state.range(0))), encoding);
+
+    RgbImage image;
+    for (auto _ : state) {
+        if (!parsePPM(file.data(), file.size(), image)) state.SkipWithError("parse failed");
+        benchmark::DoNotOptimize(image.data.data());
+    }
+    setRates(state, static_cast<std::int64_t>(image.width) * image.height, static_cast<std::int64_t>(file.size()));
+}
+
+// args: side, encoding; bytes/s counts the encoded output
+void BM_WritePGM(benchmark::State& state) {
+    PnmEncoding encoding = static_cast<PnmEncoding>(state.range(1));
+    state.SetLabel(encoding == PnmEncoding::Plain ? "P2" : "P5");
+    GrayImage gray;
+    convertToGrayscale(syntheticImage(static_cast<int>(state.range(0))), GrayscaleMethod::Luminosity, gray);
+
+    std::size_t bytes = 0;
+    for (auto _ : state) {
+        CountingBuffer buffer;
+        std::ostream out(&buffer);
+        PgmStreamWriter writer(out, gray.width, gray.height, encoding);
+        writer.writeRows(gray.view());
+        if (!writer.finish()) state.SkipWithError("write failed");
+        bytes = buffer.bytes;
+    }
+    setRates(state, static_cast<std::int64_t>(gray.width) * gray.height, static_cast<std::int64_t>(bytes));
+}
+
+std::vector<std::int64_t> allMethods() {
+    std::vector<std::int64_t> methods;
+    for (int m = 0; m < static_cast<int>(GrayscaleMethod::Invalid); ++m)
+        methods.push_back(m);
+    return methods;
+}
+
+const std::vector<std::int64_t> encodings = {static_cast<std::int64_t>(PnmEncoding::Plain),
+                                             static_cast<std::int64_t>(PnmEncoding::Raw)};
+
+} // namespace
+
+
+BENCHMARK(BM_Convert)->ArgsProduct({convertSizes, allMethods()})->ArgNames({"side", "method"})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ConvertAllMethods)->ArgsProduct({convertSizes})->ArgNames({"side"})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_ParsePPM)->ArgsProduct({ioSizes, encodings})->ArgNames({"side", "format"})->Unit(benchmark::kMillisecond);
+BENCHMARK(BM_WritePGM)->ArgsProduct({ioSizes, encodings})->ArgNames({"side", "format"})->Unit(benchmark::kMillisecond);
+
+BENCHMARK_MAIN();
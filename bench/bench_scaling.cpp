@@ -0,0 +1,109 @@
+// Scaling of the band-parallel conversion and of the parallel P3/P6 parsers
+// on one large synthetic image, for 1..N threads.
+//
+// Usage: bench_scaling [width] [height] [max_threads] [repetitions]
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+#include "image_processing.hpp"
+#include "ppm_io.hpp"
+#include "thread_pool.hpp"
+
+namespace {
+
+RgbImage syntheticImage(int width, int height) {
+    RgbImage image(width, height);
+    std::uint32_t state = 1;
+    for (auto& sample : image.data) {
+        state = state * 1664525u + 1013904223u;
+        sample = static_cast<std::uint8_t>(state >> 24);
+    }
+    return image;
+}
+
+std::string encode(const RgbImage& image, bool plain) {
+    std::string text = std::string(plain ? "P3" : "P6") + "\n" + std::to_string(image.width) + " " +
+                       std::to_string(image.height) + "\n255\n";
+    if (!plain) {
+        text.append(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+        return text;
+    }
+    for (int i = 0; i < image.height; ++i) {
+        const std::uint8_t* row = image.row(i);
+        for (int j = 0; j < 3 * image.width; ++j) {
+            text += std::to_string(row[j]);
+            text += ' ';
+        }
+        text += '\n';
+    }
+    return text;
+}
+
+// best of `repetitions` runs, in seconds
+template <typename Fn>
+double bestTime(int repetitions, Fn fn) {
+    double best = 1e300;
+    for (int r = 0; r < repetitions; ++r) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+} // namespace
+
+
+int main(int argc, char* argv[]) {
+    int width = argc > 1 ? std::atoi(argv[1]) : 8192;
+    int height = argc > 2 ? std::atoi(argv[2]) : 8192;
+    unsigned maxThreads = argc > 3 ? static_cast<unsigned>(std::atoi(argv[3])) : std::thread::hardware_concurrency();
+    int repetitions = argc > 4 ? std::atoi(argv[4]) : 3;
+    if (width < 1 || height < 1 || maxThreads < 1 || repetitions < 1) {
+        std::cerr << "Usage: bench_scaling [width] [height] [max_threads] [repetitions]\n";
+        return 1;
+    }
+
+    RgbImage image = syntheticImage(width, height);
+    std::string plain = encode(image, true);
+    std::string raw = encode(image, false);
+    const std::vector<GrayscaleMethod> methods = {GrayscaleMethod::Luminosity};
+    const double megapixels = static_cast<double>(width) * height / 1e6;
+
+    std::vector<GrayImage> reference;
+    convertToGrayscale(image.view(), methods, reference);
+
+    std::cout << width << "x" << height << ", best of " << repetitions << " (Mpx/s, speedup vs 1 thread)\n"
+              << "threads      convert          parse P3          parse P6\n";
+    double base[3] = {0, 0, 0};
+    for (unsigned threads = 1; threads <= maxThreads; ++threads) {
+        ThreadPool pool(threads);
+        std::vector<GrayImage> gray;
+        RgbImage parsed;
+        double seconds[3] = {
+            bestTime(repetitions, [&] { convertToGrayscale(image.view(), methods, gray, &pool); }),
+            bestTime(repetitions, [&] { parsePPM(plain.data(), plain.size(), parsed, &pool); }),
+            bestTime(repetitions, [&] { parsePPM(raw.data(), raw.size(), parsed, &pool); }),
+        };
+        if (gray[0].data != reference[0].data || parsed.data != image.data) {
+            std::cerr << "result with " << threads << " threads differs from the serial one\n";
+            return 1;
+        }
+
+        std::cout << std::setw(7) << threads;
+        for (int k = 0; k < 3; ++k) {
+            if (threads == 1) base[k] = seconds[k];
+            std::cout << std::fixed << std::setprecision(1) << std::setw(10) << megapixels / seconds[k]
+                      << std::setprecision(2) << std::setw(7) << base[k] / seconds[k] << "x";
+        }
+        std::cout << "\n";
+    }
+    return 0;
+}
@@ -16,69 +16,29 @@ cd "$SLURM_SUBMIT_DIR"
 
 INPUT_DIR="$SLURM_SUBMIT_DIR/input_images"
 
-OUTPUT_LIGHTNESS_DIR="$SLURM_SUBMIT_DIR/output_images/lightness"
-OUTPUT_AVERAGE_DIR="$SLURM_SUBMIT_DIR/output_images/average"
-OUTPUT_LUMINOSITY_DIR="$SLURM_SUBMIT_DIR/output_images/luminosity"
-OUTPUT_ROOTMEANSQUARE_DIR="$SLURM_SUBMIT_DIR/output_images/rootmeansquare"
-OUTPUT_REDCHANNEL_DIR="$SLURM_SUBMIT_DIR/output_images/redchannel"
-OUTPUT_GREENCHANNEL_DIR="$SLURM_SUBMIT_DIR/output_images/greenchannel"
-OUTPUT_BLUECHANNEL_DIR="$SLURM_SUBMIT_DIR/output_images/bluechannel"
+# one output directory per grayscale method (lightness, average, ...) is created
+# below OUTPUT_DIR by convert_grayscale
+OUTPUT_DIR="$SLURM_SUBMIT_DIR/output_images"
 
-
-if [ ! -d "$OUTPUT_LIGHTNESS_DIR" ]; then
-  mkdir -p "$OUTPUT_LIGHTNESS_DIR"
-fi
-if [ ! -d "$OUTPUT_AVERAGE_DIR" ]; then
-  mkdir -p "$OUTPUT_AVERAGE_DIR"
-fi
-if [ ! -d "$OUTPUT_LUMINOSITY_DIR" ]; then
-  mkdir -p "$OUTPUT_LUMINOSITY_DIR"
-fi
-if [ ! -d "$OUTPUT_ROOTMEANSQUARE_DIR" ]; then
-  mkdir -p "$OUTPUT_ROOTMEANSQUARE_DIR"
-fi
-if [ ! -d "$OUTPUT_REDCHANNEL_DIR" ]; then
-  mkdir -p "$OUTPUT_REDCHANNEL_DIR"
-fi
-if [ ! -d "$OUTPUT_GREENCHANNEL_DIR" ]; then
-  mkdir -p "$OUTPUT_GREENCHANNEL_DIR"
-fi
-if [ ! -d "$OUTPUT_BLUECHANNEL_DIR" ]; then
-  mkdir -p "$OUTPUT_BLUECHANNEL_DIR"
+if [ ! -d "$OUTPUT_DIR" ]; then
+  mkdir -p "$OUTPUT_DIR"
 fi
 
 echo "[$(date '+%F %T')] Input directory:  $INPUT_DIR"
-
-echo "[$(date '+%F %T')] Output directory (Lightness): $OUTPUT_LIGHTNESS_DIR"
-echo "[$(date '+%F %T')] Output directory (Average): $OUTPUT_AVERAGE_DIR"
-echo "[$(date '+%F %T')] Output directory (Luminosity): $OUTPUT_LUMINOSITY_DIR"
-echo "[$(date '+%F %T')] Output directory (RootMeanSquare): $OUTPUT_ROOTMEANSQUARE_DIR"
-echo "[$(date '+%F %T')] Output directory (RedChannel): $OUTPUT_REDCHANNEL_DIR"
-echo "[$(date '+%F %T')] Output directory (GreenChannel): $OUTPUT_GREENCHANNEL_DIR"
-echo "[$(date '+%F %T')] Output directory (BlueChannel): $OUTPUT_BLUECHANNEL_DIR"
+echo "[$(date '+%F %T')] Output directory: $OUTPUT_DIR"
 
 echo "[$(date '+%F %T')] Container:        $SLURM_SUBMIT_DIR/image_to_grayscale.sif"
 
+# every input image is read once and converted with all seven methods;
+# --incremental skips the images already converted by a previous run.
+# Submitted as a job array (sbatch --array=0-3 job.sh) each task converts its
+# own size-balanced shard of INPUT_DIR and writes OUTPUT_DIR/shard-I-of-N.summary;
+# "convert_grayscale --merge-summaries $OUTPUT_DIR" then checks all shards finished.
+# Scripts that convert images one at a time should start the container once,
+#   singularity exec image_to_grayscale.sif convert_grayscale --serve "$TMPDIR/gs.sock" &
+# and submit each image with "convert_grayscale --client $TMPDIR/gs.sock <method> <in> <out>".
 singularity exec "$SLURM_SUBMIT_DIR/image_to_grayscale.sif" \
-    convert_grayscale "$INPUT_DIR" "$OUTPUT_LIGHTNESS_DIR" Lightness
-
-singularity exec "$SLURM_SUBMIT_DIR/image_to_grayscale.sif" \
-    convert_grayscale "$INPUT_DIR" "$OUTPUT_AVERAGE_DIR" Average
-
-singularity exec "$SLURM_SUBMIT_DIR/image_to_grayscale.sif" \
-    convert_grayscale "$INPUT_DIR" "$OUTPUT_LUMINOSITY_DIR" Luminosity
-
-singularity exec "$SLURM_SUBMIT_DIR/image_to_grayscale.sif" \
-    convert_grayscale "$INPUT_DIR" "$OUTPUT_ROOTMEANSQUARE_DIR" RootMeanSquare
-
-singularity exec "$SLURM_SUBMIT_DIR/image_to_grayscale.sif" \
-    convert_grayscale "$INPUT_DIR" "$OUTPUT_REDCHANNEL_DIR" RedChannel
-
-singularity exec "$SLURM_SUBMIT_DIR/image_to_grayscale.sif" \
-    convert_grayscale "$INPUT_DIR" "$OUTPUT_GREENCHANNEL_DIR" GreenChannel
-
-singularity exec "$SLURM_SUBMIT_DIR/image_to_grayscale.sif" \
-    convert_grayscale "$INPUT_DIR" "$OUTPUT_BLUECHANNEL_DIR" BlueChannel
+    convert_grayscale "$INPUT_DIR" "$OUTPUT_DIR" all --threads "${SLURM_CPUS_PER_TASK:-1}" --incremental
 
 
 EXIT_CODE=$?
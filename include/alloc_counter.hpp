@@ -0,0 +1,32 @@
+#pragma once
+#include <cstdint>
+
+// Number of heap allocations (operator new) made so far by the calling
+// thread; the difference of two readings around a piece of work is what that
+// work allocated on this thread. Counting replaces the global operator
+// new/delete with malloc/free wrappers, so it is linked only into programs
+// built with GRAYSCALE_COUNT_ALLOCATIONS (the tests, and convert_grayscale
+// when configured with -DGRAYSCALE_COUNT_ALLOCATIONS=ON); elsewhere the count
+// stays 0 and costs nothing.
+#ifdef GRAYSCALE_COUNT_ALLOCATIONS
+std::uint64_t threadAllocations();
+#else
+inline std::uint64_t threadAllocations() {
+    return 0;
+}
+#endif
+
+// Adds the allocations made by the calling thread between its construction
+// and destruction to `target`.
+class AllocationScope {
+public:
+    explicit AllocationScope(std::uint64_t& target) : target_(target), start_(threadAllocations()) {}
+    ~AllocationScope() { target_ += threadAllocations() - start_; }
+
+    AllocationScope(const AllocationScope&) = delete;
+    AllocationScope& operator=(const AllocationScope&) = delete;
+
+private:
+    std::uint64_t& target_;
+    std::uint64_t start_;
+};
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <vector>
+#include "image_processing.hpp"
+#include "mapped_file.hpp"
+
+// Packed image archive (.gpak): many images in one file, so that a run opens
+// two files instead of one per image.
+//
+//   header   64 bytes  "GRAYPAK1", u32 version, u32 entry count,
+//                      u64 index offset, rest zero
+//   index    128 bytes per entry: name (96 bytes, NUL-padded), u64 payload
+//                      offset, u64 payload size, u32 width, u32 height,
+//                      u32 channels (3 = RGB, 1 = gray), u32 maxVal
+//   payloads raw 8-bit pixels, rows packed, each payload 64-byte aligned
+//
+// All integers are little-endian.
+struct ArchiveEntry {
+    std::string name;
+    std::uint64_t offset = 0;
+    std::uint64_t size = 0;
+    int width = 0;
+    int height = 0;
+    int channels = 0;
+    int maxVal = 255;
+};
+
+// Longest entry name an archive can hold.
+constexpr std::size_t archiveMaxNameLength = 95;
+
+// True if `filename` looks like an archive (".gpak" extension).
+bool isArchivePath(const std::string& filename);
+
+// Memory-mapped archive; payloads are exposed in place.
+class ArchiveReader {
+public:
+    // Maps the archive and validates its header and index.
+    bool open(const std::string& filename);
+
+    const std::vector<ArchiveEntry>& entries() const { return entries_; }
+    const ArchiveEntry* find(std::string_view name) const;
+
+    // Views of a payload; the entry must have 3 or 1 channels respectively.
+    RgbView rgb(const ArchiveEntry& entry) const;
+    GrayView gray(const ArchiveEntry& entry) const;
+
+private:
+    const std::uint8_t* payload(const ArchiveEntry& entry) const;
+
+    MappedFile file_;
+    std::vector<ArchiveEntry> entries_;
+    // entry indices sorted by name, for find()
+    std::vector<std::size_t> byName_;
+};
+
+// Builds an archive. Room for `capacity` index entries is reserved up front;
+// payloads are appended as they arrive, from any thread, and the index is
+// written by finish() in slot order, leaving out the slots never filled.
+class ArchiveWriter {
+public:
+    bool create(const std::string& filename, std::size_t capacity);
+
+    // Appends one image under index slot `slot` (< capacity). Fails on I/O
+    // errors, names longer than archiveMaxNameLength and reused slots.
+    bool add(std::size_t slot, const std::string& name, const RgbView& image, int maxVal = 255);
+    bool add(std::size_t slot, const std::string& name, const GrayView& image);
+
+    bool finish();
+
+private:
+    bool append(std::size_t slot, const std::string& name, const std::uint8_t* data, std::size_t stride,
+                std::size_t rowBytes, int height, int width, int channels, int maxVal);
+
+    std::mutex mutex_;
+    std::ofstream out_;
+    std::uint64_t end_ = 0;
+    // index records of every slot, formatted as payloads are added
+    std::vector<std::uint8_t> index_;
+    std::vector<bool> filled_;
+};
@@ -0,0 +1,50 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include "image_processing.hpp"
+#include "ppm_io.hpp"
+
+// How image sizes are spread between the smallest and the largest size.
+//   Fixed       every image has the smallest size
+//   Uniform     sides uniformly distributed
+//   LogUniform  sides uniform on a log scale: many small images, few large
+enum class SizeDistribution { Fixed, Uniform, LogUniform };
+
+// What the pixels look like.
+//   Noise     independent uniform samples (the contents of random_gen_images.py)
+//   Gradient  smooth ramps with a little noise, closer to photographs
+enum class DatasetContent { Noise, Gradient };
+
+// A synthetic PPM dataset. Everything about image k, its size and its pixels,
+// follows from the seed and k alone, so a dataset is reproduced exactly
+// whatever order or threads it is generated with.
+struct DatasetSpec {
+    std::size_t count = 100;
+    int minWidth = 100;
+    int minHeight = 100;
+    int maxWidth = 100;
+    int maxHeight = 100;
+    SizeDistribution distribution = SizeDistribution::Fixed;
+    DatasetContent content = DatasetContent::Noise;
+    PnmEncoding encoding = PnmEncoding::Plain;
+    std::uint64_t seed = 1;
+};
+
+// "WxH" sets both sizes, "WxH-WxH" the smallest and the largest.
+bool parseDatasetSizes(const std::string& text, DatasetSpec& spec);
+
+// Size of image `index`.
+void datasetImageSize(const DatasetSpec& spec, std::size_t index, int& width, int& height);
+
+// "image_000042.ppm", numbered from 1 and zero-padded so that names sort in
+// index order.
+std::string datasetImageName(std::size_t index);
+
+// Rows [first, first + band.height) of image `index`; band must already be
+// sized to the image width. Any band can be generated on its own.
+void generateDatasetRows(const DatasetSpec& spec, std::size_t index, int first, RgbImage& band);
+
+// Writes image `index` to `path` a band at a time, so that even gigapixel
+// images are written with a few MiB of memory.
+bool writeDatasetImage(const DatasetSpec& spec, std::size_t index, const std::string& path);
@@ -0,0 +1,43 @@
+#pragma once
+#include <cstdint>
+#include "image_processing.hpp"
+
+// Converts `width` packed RGB pixels of one row to gray samples.
+using GrayscaleRowKernel = void (*)(const std::uint8_t* rgb, std::uint8_t* gray, int width);
+
+// Instruction sets the row kernels are built for, in increasing order.
+enum class SimdLevel {
+    Scalar,
+    Sse41,
+    Avx2,
+    Avx512
+};
+
+// Highest level supported by both the build and the running CPU.
+SimdLevel detectSimdLevel();
+
+// Level used by convertToGrayscale. Defaults to detectSimdLevel(), or to the
+// GRAYSCALE_SIMD environment variable (scalar, sse4.1, avx2, avx512) when set.
+SimdLevel activeSimdLevel();
+
+// Overrides the active level (clamped to detectSimdLevel()); returns the level
+// actually selected. Meant for tests and benchmarks.
+SimdLevel setSimdLevel(SimdLevel level);
+
+const char* simdLevelName(SimdLevel level);
+
+// Row kernel for method at the given level; levels that were not compiled in
+// fall back to the scalar kernel. Every level, including the integer and
+// table-based scalar kernels, is bit-identical to the original double
+// formulas for all 2^24 RGB values.
+GrayscaleRowKernel rowKernel(GrayscaleMethod method, SimdLevel level);
+
+// Luminosity of a single pixel with the original double formula, used by the
+// kernels for the few pixels whose result depends on double rounding.
+int luminosityPixel(int R, int G, int B);
+
+// Per-level kernel tables, defined in the kernels_<isa>.cpp files that are
+// compiled with the matching instruction set flags.
+GrayscaleRowKernel sse41RowKernel(GrayscaleMethod method);
+GrayscaleRowKernel avx2RowKernel(GrayscaleMethod method);
+GrayscaleRowKernel avx512RowKernel(GrayscaleMethod method);
@@ -1,6 +1,10 @@
 #pragma once
 #include <vector>
 #include <array>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <string>
 
 enum class GrayscaleMethod {
     Lightness,
@@ -13,6 +17,97 @@ enum class GrayscaleMethod {
     Invalid
 };
 
+// Method named exactly as in the enum ("Luminosity", ...), or Invalid.
+GrayscaleMethod stringToGrayscaleMethod(const std::string& method);
+
+// Non-owning, read-only view of an 8-bit image with `Channels` interleaved
+// samples per pixel and rows `stride` bytes apart.
+template <int Channels>
+struct ImageView {
+    static constexpr int channels = Channels;
+
+    const std::uint8_t* data = nullptr;
+    int width = 0;
+    int height = 0;
+    std::size_t stride = 0;
+
+    const std::uint8_t* row(int y) const { return data + static_cast<std::size_t>(y) * stride; }
+
+    // view of `count` consecutive rows starting at `first`
+    ImageView rows(int first, int count) const { return {row(first), width, count, stride}; }
+};
+
+// 8-bit image stored in a single contiguous buffer.
+// Each pixel holds `Channels` interleaved samples and consecutive rows start
+// `stride` bytes apart (stride >= width * Channels).
+template <int Channels>
+struct Image {
+    static constexpr int channels = Channels;
+
+    int width = 0;
+    int height = 0;
+    std::size_t stride = 0;
+    std::vector<std::uint8_t> data;
+
+    Image() = default;
+    Image(int w, int h) { resize(w, h); }
+
+    // rowStride == 0 packs the rows tightly; existing capacity is reused
+    void resize(int w, int h, std::size_t rowStride = 0) {
+        width = w;
+        height = h;
+        stride = rowStride != 0 ? rowStride : static_cast<std::size_t>(w) * Channels;
+        data.resize(stride * static_cast<std::size_t>(h));
+    }
+
+    bool empty() const { return width == 0 || height == 0; }
+
+    std::uint8_t* row(int y) { return data.data() + static_cast<std::size_t>(y) * stride; }
+    const std::uint8_t* row(int y) const { return data.data() + static_cast<std::size_t>(y) * stride; }
+
+    std::uint8_t* pixel(int y, int x) { return row(y) + static_cast<std::size_t>(x) * Channels; }
+    const std::uint8_t* pixel(int y, int x) const { return row(y) + static_cast<std::size_t>(x) * Channels; }
+
+    ImageView<Channels> view() const { return {data.data(), width, height, stride}; }
+};
+
+using RgbImage = Image<3>;
+using GrayImage = Image<1>;
+using RgbView = ImageView<3>;
+using GrayView = ImageView<1>;
+
+class ThreadPool;
+
+// With a pool, large images are cut into L2-sized row bands that are
+// converted in parallel; the output is identical to the serial conversion.
+// The pool may be the one running the calling task.
+void convertToGrayscale(const RgbView& rgbImage, GrayscaleMethod method, GrayImage& grayscaleImage,
+                        ThreadPool* pool = nullptr);
+void convertToGrayscale(const RgbImage& rgbImage, GrayscaleMethod method, GrayImage& grayscaleImage,
+                        ThreadPool* pool = nullptr);
+
+// Produces one gray image per requested method in a single sweep over the
+// input: each RGB row is converted by every method while it is still in cache.
+void convertToGrayscale(const RgbView& rgbImage, const std::vector<GrayscaleMethod>& methods,
+                        std::vector<GrayImage>& grayscaleImages, ThreadPool* pool = nullptr);
+
+// Called with rows [first, first + rows) of every output as soon as that band
+// is converted, while it is still in cache. Bands may be handed to it
+// concurrently from different threads, in any order.
+using GrayscaleBandCallback = std::function<void(int first, int rows)>;
+
+void convertToGrayscale(const RgbView& rgbImage, const std::vector<GrayscaleMethod>& methods,
+                        std::vector<GrayImage>& grayscaleImages, ThreadPool* pool,
+                        const GrayscaleBandCallback& onBand);
+
+// As above, with every band starting at a multiple of bandAlignment rows (and
+// all but the last one spanning a multiple of it).
+void convertToGrayscale(const RgbView& rgbImage, const std::vector<GrayscaleMethod>& methods,
+                        std::vector<GrayImage>& grayscaleImages, ThreadPool* pool,
+                        const GrayscaleBandCallback& onBand, int bandAlignment);
+
+// Nested-vector adapter around the RgbImage/GrayImage overload.
+// Samples are expected in [0, 255]; values outside that range are clamped.
 void convertToGrayscale(const std::vector<std::vector<std::array<int, 3>>>& rgbImage,
                         int rows, int cols,
                         GrayscaleMethod method, std::vector<std::vector<int>>& grayscaleImage);
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <vector>
+
+// A whole file to read into `data`, which is resized to the file size.
+struct FileRead {
+    const char* path = nullptr;
+    std::vector<char>* data = nullptr;
+    bool ok = false;
+
+    // progress, managed by IoRing
+    int fd = -1;
+    std::size_t done = 0;
+};
+
+// A file to create or truncate and fill with [data, data + size).
+struct FileWrite {
+    const char* path = nullptr;
+    const char* data = nullptr;
+    std::size_t size = 0;
+    bool ok = false;
+
+    // progress, managed by IoRing
+    int fd = -1;
+    std::size_t done = 0;
+};
+
+// Batched whole-file I/O. On Linux the files of a batch go through one
+// io_uring: all opens are submitted at once, then all reads or writes, so a
+// single thread keeps up to `entries` operations in flight instead of
+// blocking on one file at a time. The ring is set up with raw system calls
+// (no liburing). Without it (other systems, kernels before 5.6, or io_uring
+// disabled by seccomp) open() fails and the batches fall back to blocking
+// calls, one file after another.
+//
+// A ring is used from one thread at a time.
+class IoRing {
+public:
+    IoRing();
+    ~IoRing();
+
+    IoRing(const IoRing&) = delete;
+    IoRing& operator=(const IoRing&) = delete;
+
+    // Sets up the ring; false if io_uring or one of the operations it needs
+    // is unavailable.
+    bool open(unsigned entries = 64);
+    bool isOpen() const { return ring_ != nullptr; }
+
+    // Every file of the batch is handled; failures only clear their own `ok`.
+    void readFiles(FileRead* reads, std::size_t count);
+    void writeFiles(FileWrite* writes, std::size_t count);
+
+private:
+    struct Ring;
+    std::unique_ptr<Ring> ring_;
+};
@@ -0,0 +1,45 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// What an output was produced from: the input file's size, modification time
+// and content hash, the conversion parameters and the tool version.
+struct ManifestEntry {
+    std::uint64_t size = 0;
+    std::int64_t mtime = 0;  // nanoseconds, as reported by the file system
+    std::uint64_t hash = 0;
+    std::string parameters;
+    std::string version;
+};
+
+// Record of the inputs converted into an output folder, keyed by input file
+// name. Stored as a text file with one tab-separated line per input.
+// All member functions are thread-safe.
+class Manifest {
+public:
+    // A missing file loads as an empty manifest; a malformed one fails.
+    bool load(const std::string& filename);
+
+    // Writes to a temporary file renamed over `filename`, so an interrupted
+    // run never leaves a truncated manifest behind.
+    bool save(const std::string& filename) const;
+
+    bool find(const std::string& input, ManifestEntry& entry) const;
+    void update(const std::string& input, const ManifestEntry& entry);
+    void remove(const std::string& input);
+    std::vector<std::string> inputs() const;
+
+private:
+    mutable std::mutex mutex_;
+    std::map<std::string, ManifestEntry> entries_;
+};
+
+// XXH64 (seed 0) of a buffer: fast, but not meant to resist deliberate collisions.
+std::uint64_t contentHash(const char* data, std::size_t size);
+
+// contentHash of a whole file; false if it cannot be read.
+bool hashFile(const std::string& filename, std::uint64_t& hash);
@@ -0,0 +1,34 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include <vector>
+
+// Read-only view of a whole file.
+// The file is memory-mapped when possible; otherwise (mapping unsupported,
+// empty or special files) its contents are read into an owned buffer.
+class MappedFile {
+public:
+    MappedFile() = default;
+    ~MappedFile();
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    // allowMap == false forces the buffered-read fallback
+    bool open(const std::string& filename, bool allowMap = true);
+    void close();
+
+    const char* data() const { return data_; }
+    std::size_t size() const { return size_; }
+    bool isMapped() const { return mapped_; }
+
+    // Faults every page of a mapping in now, so that the disk reads happen
+    // here instead of on first access. No-op for buffered files.
+    void prefetch() const;
+
+private:
+    const char* data_ = nullptr;
+    std::size_t size_ = 0;
+    bool mapped_ = false;
+    std::vector<char> buffer_;
+};
@@ -0,0 +1,120 @@
+#pragma once
+#include <array>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <utility>
+#include <vector>
+#include "image_processing.hpp"
+#include "thumbnails.hpp"
+
+using GrayHistogram = std::array<std::uint64_t, 256>;
+using GrayLut = std::array<std::uint8_t, 256>;
+
+// One per-pixel stage applied to the gray values of a conversion.
+//   stretch[:P]    maps the range of the values onto [0, 255], ignoring the
+//                  darkest and brightest P percent of the pixels (default 0)
+//   threshold[:T]  values >= T become 255 and the others 0; without T the
+//                  level is chosen with Otsu's method
+//   invert         255 - value
+struct GrayOperator {
+    enum class Kind { Stretch, Threshold, Invert };
+
+    Kind kind = Kind::Invert;
+    double clipPercent = 0;
+    // threshold level, or -1 for Otsu
+    int level = -1;
+
+    // true if the stage depends on the histogram of its input
+    bool needsHistogram() const;
+};
+
+// A grayscale method followed by operator stages, written
+// "Method|stage|stage:arg", e.g. "Luminosity|stretch|threshold:128".
+struct OperatorChain {
+    GrayscaleMethod method = GrayscaleMethod::Invalid;
+    std::vector<GrayOperator> stages;
+
+    bool needsHistogram() const;
+};
+
+// Parses a chain; on failure `error` says why.
+bool parseOperatorChain(const std::string& spec, OperatorChain& chain, std::string& error);
+
+// Composes the stages into one lookup table. `histogram` is that of the values
+// entering the first stage; each histogram-dependent stage sees it remapped
+// through the stages before it.
+GrayLut composeOperators(const std::vector<GrayOperator>& stages, const GrayHistogram& histogram);
+
+// Histogram of the values after `lut`, for values distributed as `histogram`.
+GrayHistogram remapHistogram(const GrayHistogram& histogram, const GrayLut& lut);
+
+// The chains of a run, prepared once and applied to every image.
+//
+// All stages of a chain are composed into one 256-entry table, applied to
+// each row band right after it is converted, while it is still in cache: a
+// single sweep over the pixels with no intermediate images. Chains with a
+// histogram-dependent stage count the histogram of the method's output in
+// that sweep instead, and apply their table in a second pass over the gray
+// output only. Output histograms never need a pass of their own: they are
+// counted in the sweep or derived from the counted ones.
+//
+// Thumbnails are built the same way: each band of a final output feeds its
+// mip chain while still in cache (in the sweep, or in the second pass for
+// histogram-dependent chains), so the full-size output is never reread.
+// Thumbnails of other widths are resampled from the closest mip level.
+class FusedConversion {
+public:
+    explicit FusedConversion(std::vector<OperatorChain> chains, std::vector<ThumbnailSpec> thumbnails = {});
+
+    const std::vector<OperatorChain>& chains() const { return chains_; }
+    const std::vector<GrayscaleMethod>& methods() const { return methods_; }
+    const std::vector<ThumbnailSpec>& thumbnails() const { return thumbnails_; }
+
+    // True if no chain has stages: the conversion is the plain one.
+    bool trivial() const { return trivial_; }
+
+    // True if some chain has a histogram-dependent stage. Such conversions
+    // count histograms anyway; passing `histograms` lets them reuse its storage.
+    bool needsHistograms() const { return needsHistograms_; }
+
+    // One output per chain; with `histograms`, also the histogram of each
+    // output. With `thumbnails`, also the thumbnails of each output, the one
+    // of chain c and spec s at c * thumbnails().size() + s; images past those
+    // are scratch kept for the next call.
+    void convert(const RgbView& rgbImage, std::vector<GrayImage>& outputs, std::vector<GrayHistogram>* histograms,
+                 ThreadPool* pool = nullptr, std::vector<GrayImage>* thumbnails = nullptr) const;
+
+private:
+    // Mip levels that chain c fills for an image of the given size, and the
+    // deepest of them.
+    int mipTargets(std::size_t c, int width, int height, std::vector<GrayImage>& thumbnails,
+                   GrayImage** targets) const;
+
+    std::vector<OperatorChain> chains_;
+    std::vector<GrayscaleMethod> methods_;
+    std::vector<ThumbnailSpec> thumbnails_;
+    // composed tables of the chains without histogram-dependent stages
+    std::vector<GrayLut> luts_;
+    bool trivial_ = true;
+    bool needsHistograms_ = false;
+};
+
+// --histogram report: the histogram of every output of every image, collected
+// from any thread and written as JSON, in an "inputs" array sorted by input
+// path.
+class HistogramReport {
+public:
+    // the operator chains of the run, one per output
+    std::vector<std::string> methods;
+
+    void add(const std::string& input, const std::vector<GrayHistogram>& histograms);
+
+    void writeJson(std::ostream& out) const;
+    bool write(const std::string& filename) const;
+
+private:
+    mutable std::mutex mutex_;
+    std::vector<std::pair<std::string, std::vector<GrayHistogram>>> images_;
+};
@@ -0,0 +1,23 @@
+#pragma once
+#include <cstddef>
+#include <functional>
+
+// Thread counts of the three stages and depth of the queues between them.
+struct PipelineOptions {
+    unsigned readers = 1;
+    unsigned converters = 1;
+    unsigned writers = 1;
+    std::size_t queueDepth = 4;
+};
+
+// Runs every item index in [0, count) through read, convert and write. Each
+// stage has its own threads, and the stages are connected by bounded
+// lock-free queues, so reading the next files overlaps converting and writing
+// the previous ones. A full queue stalls the stage feeding it, so at most
+// 2 * queueDepth + readers + converters + writers items are in flight at any
+// time. Items are read in index order; later stages may see them in any order.
+// Returns once every item has been written.
+void runPipeline(std::size_t count, const PipelineOptions& options,
+                 const std::function<void(std::size_t)>& read,
+                 const std::function<void(std::size_t)>& convert,
+                 const std::function<void(std::size_t)>& write);
@@ -0,0 +1,137 @@
+#pragma once
+#include <cstddef>
+#include <istream>
+#include <ostream>
+#include <string>
+#include <vector>
+#include "image_processing.hpp"
+#include "mapped_file.hpp"
+
+// Header of a Netpbm file: magic number, dimensions and maximum sample value.
+// dataOffset points just past the maxVal token.
+struct PnmHeader {
+    std::string magic;
+    int width = 0;
+    int height = 0;
+    int maxVal = 0;
+    std::size_t dataOffset = 0;
+};
+
+// Plain (ASCII) or raw (binary) Netpbm encoding.
+enum class PnmEncoding {
+    Plain,
+    Raw
+};
+
+// A PPM file opened for conversion. Raw (P6) pixel data is exposed in place
+// from the file mapping; plain (P3) data is decoded into `decoded`.
+struct PpmInput {
+    MappedFile file;
+    RgbImage decoded;
+    RgbView pixels;
+};
+
+// Parses the header of an in-memory Netpbm file, skipping '#' comments.
+bool parsePnmHeader(const char* data, std::size_t size, PnmHeader& header);
+
+// Decodes an in-memory PPM file, either plain (P3) or raw (P6), selected by
+// its magic number. maxVal must be in [1, 255] and every sample must be
+// <= maxVal; samples are stored without rescaling.
+// With a pool, large rasters are decoded and validated in parallel pieces;
+// the result is the same as without one.
+bool parsePPM(const char* data, std::size_t size, RgbImage& image, ThreadPool* pool = nullptr);
+
+// As above, into a PpmInput: raw (P6) pixels are viewed in place in `data`,
+// which must outlive input.pixels; plain (P3) ones are decoded.
+bool parsePPM(const char* data, std::size_t size, PpmInput& input, ThreadPool* pool = nullptr);
+
+bool openPPM(const std::string& filename, PpmInput& input, ThreadPool* pool = nullptr);
+bool readPPM(const std::string& filename, RgbImage& image, ThreadPool* pool = nullptr);
+
+// Writes a plain (P2) or raw (P5) PGM file. Rows are formatted into a
+// reusable buffer and written in large chunks; on Linux the size of P5
+// files, known from the dimensions, is preallocated with fallocate.
+bool writePGM(const std::string& filename, const GrayImage& grayscaleImage,
+              PnmEncoding encoding = PnmEncoding::Plain);
+bool writePGM(const std::string& filename, const GrayView& grayscaleImage,
+              PnmEncoding encoding = PnmEncoding::Plain);
+
+// Formats the whole file writePGM would write into `file`, resized to its
+// size, for callers that do their own I/O.
+void formatPGM(const GrayView& image, PnmEncoding encoding, std::vector<char>& file);
+
+// Writes a plain (P3) or raw (P6) PPM file with the given maxVal; samples are
+// written as they are.
+bool writePPM(const std::string& filename, const RgbView& image, int maxVal = 255,
+              PnmEncoding encoding = PnmEncoding::Raw);
+
+
+// Incremental PPM reader (P3 or P6) that decodes a band of rows at a time
+// from a stream, holding at most one read chunk plus the caller's band.
+class PpmStreamReader {
+public:
+    explicit PpmStreamReader(std::istream& in, std::size_t chunkSize = 1 << 20);
+
+    // Reads and validates the header; must succeed before readRows.
+    bool readHeader();
+    const PnmHeader& header() const { return header_; }
+    int rowsRemaining() const { return header_.height - rowsRead_; }
+
+    // Decodes the next min(maxRows, rowsRemaining()) rows into band, which is
+    // resized to that many rows. Returns false on malformed or truncated data.
+    bool readRows(int maxRows, RgbImage& band);
+
+private:
+    bool fill();
+    bool nextSample(int& value);
+
+    std::istream& in_;
+    std::vector<char> buffer_;
+    std::size_t chunkSize_;
+    std::size_t pos_ = 0;
+    std::size_t end_ = 0;
+    bool eof_ = false;
+    bool inComment_ = false;
+    PnmHeader header_;
+    int rowsRead_ = 0;
+};
+
+// Incremental PGM writer: the header is written up front and rows are
+// appended band by band.
+class PgmStreamWriter {
+public:
+    PgmStreamWriter(std::ostream& out, int width, int height, PnmEncoding encoding);
+
+    bool writeRows(const GrayView& band);
+
+    // Returns true if every row was written and the stream is still good.
+    bool finish();
+
+private:
+    std::ostream& out_;
+    int width_;
+    int height_;
+    PnmEncoding encoding_;
+    int rowsWritten_ = 0;
+    std::vector<char> buffer_;
+};
+
+// Incremental PPM writer with maxVal 255, the RGB counterpart of
+// PgmStreamWriter, for images too large to hold in memory.
+class PpmStreamWriter {
+public:
+    PpmStreamWriter(std::ostream& out, int width, int height, PnmEncoding encoding);
+
+    bool writeRows(const RgbView& band);
+
+    // Returns true if every row was written and the stream is still good.
+    bool finish();
+
+private:
+    std::ostream& out_;
+    int width_;
+    int height_;
+    PnmEncoding encoding_;
+    int rowsWritten_ = 0;
+    std::vector<char> buffer_;
+};
@@ -0,0 +1,68 @@
+#pragma once
+#include <cstddef>
+#include <string>
+#include "image_processing.hpp"
+#include "ppm_io.hpp"
+
+class ThreadPool;
+
+// --serve line protocol. Requests are tab-separated lines:
+//
+//   convert <method> <input path> <output path> [P2|P5]
+//   inline  <method> <byte count> <output path> [P2|P5]
+//           followed by <byte count> bytes of a PPM file
+//   ping
+//   shutdown                  (socket server only: stop accepting connections)
+//
+// Requests of one connection are converted concurrently on the server's pool;
+// each gets one response line, in request order:
+//
+//   ok    <output path>       (or "pong" / "shutdown")
+//   error <message>
+//
+// The byte count of an inline request is checked first. When another field
+// is invalid, the error is answered and the image bytes are skipped. When the
+// count itself is missing, malformed or above maxInlineBytes, those bytes
+// cannot be told apart from the requests that follow, so the connection ends
+// after the error.
+//
+// Requests of all connections in flight (read, not yet answered) are limited
+// to maxInFlightRequests and maxInFlightBytes of inline images; reading
+// pauses until earlier requests are answered.
+struct ServerRequest {
+    enum class Kind { Convert, Inline, Ping, Shutdown };
+
+    Kind kind = Kind::Ping;
+    GrayscaleMethod method = GrayscaleMethod::Invalid;
+    std::string input;
+    std::size_t inlineBytes = 0;
+    std::string output;
+    PnmEncoding encoding = PnmEncoding::Plain;
+};
+
+// Largest inline image accepted, 1 GiB; larger images go by path.
+constexpr std::size_t maxInlineBytes = std::size_t(1) << 30;
+
+constexpr std::size_t maxInFlightRequests = 256;
+constexpr std::size_t maxInFlightBytes = std::size_t(1) << 30;
+
+// Parses one request line (without its newline). On failure `error` says why.
+bool parseServerRequest(const std::string& line, ServerRequest& request, std::string& error);
+
+// Serves the requests read from inFd until end of input or a shutdown request,
+// writing responses to outFd, and returns once every response is written.
+// Returns true if the connection asked for a shutdown.
+bool serveConnection(int inFd, int outFd, ThreadPool& pool);
+
+// Listens on a Unix domain socket (a stale socket file is replaced) and
+// serves every connection on its own thread until a shutdown request.
+// Returns false if the socket could not be set up.
+bool serveUnixSocket(const std::string& socketPath, ThreadPool& pool);
+
+// Client side: sends `requests` (request lines, and inline bytes) to the
+// server at socketPath, then copies every response to outFd. Returns false if
+// the server could not be reached or any response was an error.
+bool runClient(const std::string& socketPath, const std::string& requests, int outFd);
+
+// Same, streaming the requests from inFd instead.
+bool runClient(const std::string& socketPath, int inFd, int outFd);
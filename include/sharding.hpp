@@ -0,0 +1,37 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+// Splits files (size, name) over `shardCount` shards, balancing the total
+// size of each shard: largest files first, each to the shard with the least
+// data so far (LPT scheduling). Ties are broken by name and by shard index,
+// so every process computes the same assignment whatever order the
+// directory was listed in. Returns the shard of each file, in input order.
+std::vector<int> assignShards(const std::vector<std::pair<std::uint64_t, std::string>>& files, int shardCount);
+
+// Completion summary written by one shard of a run.
+struct ShardSummary {
+    int index = 0;
+    int count = 1;
+    std::size_t images = 0;   // inputs assigned to the shard
+    std::size_t failed = 0;
+    std::size_t skipped = 0;  // left alone by --incremental
+    std::uint64_t inputBytes = 0;
+    double wallSeconds = 0;
+};
+
+// "shard-<index>-of-<count>.summary"
+std::string shardSummaryName(int index, int count);
+
+// Plain "key value" lines.
+bool writeShardSummary(const std::string& filename, const ShardSummary& summary);
+bool readShardSummary(const std::string& filename, ShardSummary& summary);
+
+// Reads every shard summary in `folder` and adds them up into `total`
+// (wallSeconds is the slowest shard's). Shards that have not reported are
+// listed in `missing`. Returns false if there are no summaries or they
+// disagree on the shard count.
+bool mergeShardSummaries(const std::string& folder, ShardSummary& total, std::vector<int>& missing);
@@ -0,0 +1,78 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Time spent in each per-image phase, in seconds.
+struct PhaseTimes {
+    double read = 0;
+    double convert = 0;
+    double write = 0;
+};
+
+// Adds the time between its construction and destruction to `target`.
+// A disabled timer does not read the clock at all, so instrumentation that
+// is turned off costs one branch per phase.
+class PhaseTimer {
+public:
+    PhaseTimer(bool enabled, double& target) : target_(enabled ? &target : nullptr) {
+        if (target_) start_ = std::chrono::steady_clock::now();
+    }
+    ~PhaseTimer() {
+        if (target_) *target_ += std::chrono::duration<double>(std::chrono::steady_clock::now() - start_).count();
+    }
+
+    PhaseTimer(const PhaseTimer&) = delete;
+    PhaseTimer& operator=(const PhaseTimer&) = delete;
+
+private:
+    double* target_;
+    std::chrono::steady_clock::time_point start_;
+};
+
+// Measurements of one converted image.
+struct ImageStats {
+    std::string input;
+    bool ok = true;
+    bool skipped = false;  // left alone by --incremental
+    PhaseTimes times;
+    std::uint64_t inputBytes = 0;
+    std::uint64_t outputBytes = 0;
+    std::uint64_t pixels = 0;
+};
+
+// Collects per-image measurements from any thread, plus run-wide values set
+// by the caller, and writes them as a JSON or CSV report.
+class StatsCollector {
+public:
+    std::string mode;
+    unsigned threads = 0;
+    std::vector<std::string> methods;
+    double scanSeconds = 0;
+    double wallSeconds = 0;
+
+    void add(ImageStats image);
+
+    // JSON: run-wide totals plus an "images" array.
+    // CSV: one row per image followed by a "TOTAL" row with the totals, whose
+    // ok and skipped columns count the images.
+    // Images are listed by input path.
+    void writeJson(std::ostream& out) const;
+    void writeCsv(std::ostream& out) const;
+
+    // CSV when the file name ends in ".csv", JSON otherwise.
+    bool write(const std::string& filename) const;
+
+private:
+    std::vector<ImageStats> sortedImages() const;
+
+    mutable std::mutex mutex_;
+    std::vector<ImageStats> images_;
+};
+
+// Peak resident set size of the process so far, or 0 if unavailable.
+std::uint64_t peakRssBytes();
@@ -0,0 +1,16 @@
+#pragma once
+#include <istream>
+#include <ostream>
+#include <vector>
+#include "image_processing.hpp"
+#include "ppm_io.hpp"
+#include "stats.hpp"
+
+// Converts a PPM stream (P3 or P6) into one PGM stream per method, reading,
+// converting and appending `bandRows` rows at a time. Peak memory is
+// O(width * bandRows) no matter how tall the image is. Bands are converted on
+// the pool when one is given. With `stats`, the time spent reading, converting
+// and writing the bands is added to its phase times and the pixel count is set.
+bool convertPPMStream(std::istream& in, const std::vector<GrayscaleMethod>& methods,
+                      const std::vector<std::ostream*>& outputs, PnmEncoding encoding,
+                      int bandRows = 64, ThreadPool* pool = nullptr, ImageStats* stats = nullptr);
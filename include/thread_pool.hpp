@@ -0,0 +1,61 @@
+#pragma once
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Fixed-size work-stealing thread pool.
+// Every worker owns a task deque: it pops its own work from the back and,
+// when that runs dry, steals from the front of the other workers' deques, so
+// a few long tasks never leave the remaining workers idle.
+class ThreadPool {
+public:
+    // threads == 0 uses std::thread::hardware_concurrency()
+    explicit ThreadPool(unsigned threads = 0);
+    ~ThreadPool();
+
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    unsigned size() const { return static_cast<unsigned>(threads_.size()); }
+
+    // Queues a task. Tasks submitted from a worker go to that worker's deque,
+    // others are distributed round-robin.
+    void submit(std::function<void()> task);
+
+    // Blocks until every submitted task has finished; the calling thread
+    // runs queued tasks while it waits. Must not be called from a task.
+    void wait();
+
+    // Calls body(i) for every i in [0, count), spread over the workers and the
+    // calling thread, and returns once all calls have finished. Indices are
+    // handed out dynamically. Safe to call from inside a task: the caller keeps
+    // running queued tasks instead of blocking a worker.
+    void parallelFor(std::size_t count, const std::function<void(std::size_t)>& body);
+
+private:
+    struct WorkerQueue {
+        std::mutex mutex;
+        std::deque<std::function<void()>> tasks;
+    };
+
+    void workerLoop(unsigned index);
+    bool popTask(unsigned index, std::function<void()>& task);
+    void runTask(std::function<void()>& task);
+
+    std::vector<std::unique_ptr<WorkerQueue>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::mutex sleepMutex_;
+    std::condition_variable wakeWorkers_;
+    std::condition_variable allDone_;
+    std::atomic<std::size_t> queued_{0};
+    std::atomic<std::size_t> unfinished_{0};
+    std::atomic<unsigned> nextQueue_{0};
+    bool stopping_ = false;
+};
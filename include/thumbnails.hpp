@@ -0,0 +1,45 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "image_processing.hpp"
+
+// Coarsest mip level: thumbnails go down to 1/2^maxThumbnailShift.
+constexpr int maxThumbnailShift = 6;
+
+// One downscaled copy of an output, written "1/N" for N = 2, 4, ... 64 or
+// "wN" for a width of N pixels with the aspect ratio kept. Every pixel is the
+// area average of the pixels it covers.
+struct ThumbnailSpec {
+    // scale 1/2^shift; used when width is 0
+    int shift = 0;
+    int width = 0;
+
+    // "1-2", "w160": appended to the output names
+    std::string suffix() const;
+};
+
+// Parses a comma-separated list of specs; on failure `error` says why.
+bool parseThumbnailSpecs(const std::string& list, std::vector<ThumbnailSpec>& specs, std::string& error);
+
+// Size of mip level `level` of an image `size` pixels across. Each pixel
+// averages a 2^level square, clipped at the right and bottom edges.
+inline int mipExtent(int size, int level) { return (size + (1 << level) - 1) >> level; }
+
+// Size of the thumbnail of a width x height image.
+void thumbnailSize(const ThumbnailSpec& spec, int width, int height, int& thumbnailWidth, int& thumbnailHeight);
+
+// The mip level a thumbnail is made from: its own level for 1/N, otherwise the
+// coarsest level that is still at least as large as the thumbnail (0 being
+// the image itself).
+int thumbnailLevel(const ThumbnailSpec& spec, int width, int height);
+
+// Adds rows [first, first + rows) of `image` to its mip chain. `first` must be
+// a multiple of 2^levels, and so must `rows` unless the band ends at the
+// bottom of the image; bands are then independent and may be added
+// concurrently. targets[l - 1], if not null, receives level l, sized
+// mipExtent(width, l) x mipExtent(height, l). The levels are built from
+// exact sums, so every level is the rounded area average of the image.
+void addMipRows(const GrayImage& image, int first, int rows, int levels, GrayImage* const* targets);
+
+// Area-average resampling of `source` to the size `target` already has.
+void resampleArea(const GrayImage& source, GrayImage& target);
@@ -0,0 +1,61 @@
+#include <cstdlib>
+#include <new>
+#include "alloc_counter.hpp"
+
+
+namespace {
+
+thread_local std::uint64_t allocations = 0;
+
+} // namespace
+
+
+std::uint64_t threadAllocations() {
+    return allocations;
+}
+
+
+// malloc until it succeeds, calling the new_handler in between as the
+// standard operator new does, or bad_alloc when there is none
+void* operator new(std::size_t size) {
+    ++allocations;
+    if (size == 0) size = 1;
+    for (;;) {
+        if (void* p = std::malloc(size)) return p;
+        std::new_handler handler = std::get_new_handler();
+        if (!handler) throw std::bad_alloc();
+        handler();
+    }
+}
+
+void* operator new[](std::size_t size) {
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) noexcept {
+    try {
+        return operator new(size);
+    } catch (...) {
+        return nullptr;
+    }
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t& tag) noexcept {
+    return operator new(size, tag);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, std::size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,203 @@
+#include <algorithm>
+#include <cstring>
+#include "archive.hpp"
+
+
+namespace {
+
+const char archiveMagic[8] = {'G', 'R', 'A', 'Y', 'P', 'A', 'K', '1'};
+constexpr std::uint32_t archiveVersion = 1;
+constexpr std::size_t headerBytes = 64;
+constexpr std::size_t entryBytes = 128;
+constexpr std::size_t nameBytes = archiveMaxNameLength + 1;
+constexpr std::uint64_t payloadAlignment = 64;
+
+void put32(std::uint8_t* p, std::uint32_t v) {
+    for (int k = 0; k < 4; ++k) p[k] = static_cast<std::uint8_t>(v >> (8 * k));
+}
+
+void put64(std::uint8_t* p, std::uint64_t v) {
+    for (int k = 0; k < 8; ++k) p[k] = static_cast<std::uint8_t>(v >> (8 * k));
+}
+
+std::uint32_t get32(const std::uint8_t* p) {
+    std::uint32_t v = 0;
+    for (int k = 3; k >= 0; --k) v = (v << 8) | p[k];
+    return v;
+}
+
+std::uint64_t get64(const std::uint8_t* p) {
+    std::uint64_t v = 0;
+    for (int k = 7; k >= 0; --k) v = (v << 8) | p[k];
+    return v;
+}
+
+} // namespace
+
+
+bool isArchivePath(const std::string& filename) {
+    return filename.size() > 5 && filename.compare(filename.size() - 5, 5, ".gpak") == 0;
+}
+
+
+bool ArchiveReader::open(const std::string& filename) {
+    entries_.clear();
+    byName_.clear();
+    if (!file_.open(filename)) return false;
+
+    const auto* data = reinterpret_cast<const std::uint8_t*>(file_.data());
+    const std::uint64_t size = file_.size();
+    if (size < headerBytes || std::memcmp(data, archiveMagic, sizeof(archiveMagic)) != 0) return false;
+    if (get32(data + 8) != archiveVersion) return false;
+    const std::uint64_t count = get32(data + 12);
+    const std::uint64_t indexOffset = get64(data + 16);
+    if (indexOffset < headerBytes || indexOffset > size || count > (size - indexOffset) / entryBytes) return false;
+
+    for (std::uint64_t k = 0; k < count; ++k) {
+        const std::uint8_t* p = data + indexOffset + k * entryBytes;
+        const char* name = reinterpret_cast<const char*>(p);
+        std::size_t nameLength = std::find(name, name + nameBytes, '\0') - name;
+        if (nameLength == 0 || nameLength == nameBytes) return false;
+
+        ArchiveEntry entry;
+        entry.name.assign(name, nameLength);
+        entry.offset = get64(p + 96);
+        entry.size = get64(p + 104);
+        std::uint32_t width = get32(p + 112);
+        std::uint32_t height = get32(p + 116);
+        std::uint32_t channels = get32(p + 120);
+        std::uint32_t maxVal = get32(p + 124);
+        if (width > 0x7FFFFFFF || height > 0x7FFFFFFF || (channels != 1 && channels != 3)) return false;
+        if (maxVal < 1 || maxVal > 255) return false;
+        if (entry.offset > size || entry.size > size - entry.offset) return false;
+        // width * height * channels == size, without overflowing
+        if (width != 0 && height > entry.size / width / channels) return false;
+        if (static_cast<std::uint64_t>(width) * height * channels != entry.size) return false;
+
+        entry.width = static_cast<int>(width);
+        entry.height = static_cast<int>(height);
+        entry.channels = static_cast<int>(channels);
+        entry.maxVal = static_cast<int>(maxVal);
+        entries_.push_back(std::move(entry));
+    }
+
+    byName_.resize(entries_.size());
+    for (std::size_t k = 0; k < byName_.size(); ++k)
+        byName_[k] = k;
+    auto byName = [this](std::size_t a, std::size_t b) { return entries_[a].name < entries_[b].name; };
+    std::sort(byName_.begin(), byName_.end(), byName);
+    auto duplicate = [this](std::size_t a, std::size_t b) { return entries_[a].name == entries_[b].name; };
+    return std::adjacent_find(byName_.begin(), byName_.end(), duplicate) == byName_.end();
+}
+
+
+// Binary search over the sorted names; looking up a name does not allocate.
+const ArchiveEntry* ArchiveReader::find(std::string_view name) const {
+    auto it = std::lower_bound(byName_.begin(), byName_.end(), name,
+                               [this](std::size_t k, std::string_view key) { return entries_[k].name < key; });
+    if (it == byName_.end() || entries_[*it].name != name) return nullptr;
+    return &entries_[*it];
+}
+
+
+const std::uint8_t* ArchiveReader::payload(const ArchiveEntry& entry) const {
+    return reinterpret_cast<const std::uint8_t*>(file_.data()) + entry.offset;
+}
+
+
+RgbView ArchiveReader::rgb(const ArchiveEntry& entry) const {
+    return {payload(entry), entry.width, entry.height, static_cast<std::size_t>(entry.width) * 3};
+}
+
+
+GrayView ArchiveReader::gray(const ArchiveEntry& entry) const {
+    return {payload(entry), entry.width, entry.height, static_cast<std::size_t>(entry.width)};
+}
+
+
+bool ArchiveWriter::create(const std::string& filename, std::size_t capacity) {
+    out_.open(filename, std::ios::binary | std::ios::trunc);
+    if (!out_) return false;
+    index_.assign(capacity * entryBytes, 0);
+    filled_.assign(capacity, false);
+
+    // header and index are written by finish(); payloads start after them
+    std::uint64_t reserved = headerBytes + capacity * entryBytes;
+    end_ = (reserved + payloadAlignment - 1) / payloadAlignment * payloadAlignment;
+    out_.seekp(static_cast<std::streamoff>(end_));
+    return static_cast<bool>(out_);
+}
+
+
+bool ArchiveWriter::add(std::size_t slot, const std::string& name, const RgbView& image, int maxVal) {
+    return append(slot, name, image.data, image.stride, static_cast<std::size_t>(image.width) * 3, image.height,
+                  image.width, 3, maxVal);
+}
+
+
+bool ArchiveWriter::add(std::size_t slot, const std::string& name, const GrayView& image) {
+    return append(slot, name, image.data, image.stride, static_cast<std::size_t>(image.width), image.height,
+                  image.width, 1, 255);
+}
+
+
+bool ArchiveWriter::append(std::size_t slot, const std::string& name, const std::uint8_t* data, std::size_t stride,
+                           std::size_t rowBytes, int height, int width, int channels, int maxVal) {
+    if (name.empty() || name.size() > archiveMaxNameLength) return false;
+    if (maxVal < 1 || maxVal > 255) return false;
+
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (slot >= filled_.size() || filled_[slot] || !out_) return false;
+
+    std::uint64_t size = static_cast<std::uint64_t>(rowBytes) * height;
+    if (stride == rowBytes) {
+        out_.write(reinterpret_cast<const char*>(data), static_cast<std::streamsize>(size));
+    } else {
+        for (int i = 0; i < height; ++i)
+            out_.write(reinterpret_cast<const char*>(data + i * stride), static_cast<std::streamsize>(rowBytes));
+    }
+
+    std::uint64_t padding = (payloadAlignment - size % payloadAlignment) % payloadAlignment;
+    static const char zeros[payloadAlignment] = {};
+    out_.write(zeros, static_cast<std::streamsize>(padding));
+    if (!out_) return false;
+
+    std::uint8_t* record = index_.data() + slot * entryBytes;
+    std::memcpy(record, name.data(), name.size());
+    put64(record + 96, end_);
+    put64(record + 104, size);
+    put32(record + 112, static_cast<std::uint32_t>(width));
+    put32(record + 116, static_cast<std::uint32_t>(height));
+    put32(record + 120, static_cast<std::uint32_t>(channels));
+    put32(record + 124, static_cast<std::uint32_t>(maxVal));
+    filled_[slot] = true;
+    end_ += size + padding;
+    return true;
+}
+
+
+bool ArchiveWriter::finish() {
+    std::lock_guard<std::mutex> lock(mutex_);
+    if (!out_) return false;
+
+    // drop the unused slots
+    std::uint32_t count = 0;
+    for (std::size_t slot = 0; slot < filled_.size(); ++slot) {
+        if (!filled_[slot]) continue;
+        if (slot != count)
+            std::memcpy(&index_[count * entryBytes], &index_[slot * entryBytes], entryBytes);
+        ++count;
+    }
+
+    std::uint8_t header[headerBytes] = {};
+    std::memcpy(header, archiveMagic, sizeof(archiveMagic));
+    put32(header + 8, archiveVersion);
+    put32(header + 12, count);
+    put64(header + 16, headerBytes);
+
+    out_.seekp(0);
+    out_.write(reinterpret_cast<const char*>(header), headerBytes);
+    out_.write(reinterpret_cast<const char*>(index_.data()), static_cast<std::streamsize>(count * entryBytes));
+    out_.close();
+    return static_cast<bool>(out_);
+}
@@ -0,0 +1,154 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include "dataset.hpp"
+
+
+namespace {
+
+// SplitMix64: a fast generator whose every state gives a well-mixed output,
+// so seeds derived from (seed, index, row) start independent streams.
+std::uint64_t splitMix(std::uint64_t& state) {
+    std::uint64_t z = (state += 0x9e3779b97f4a7c15ULL);
+    z = (z ^ (z >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    z = (z ^ (z >> 27)) * 0x94d049bb133111ebULL;
+    return z ^ (z >> 31);
+}
+
+std::uint64_t streamState(std::uint64_t seed, std::uint64_t index, std::uint64_t row) {
+    std::uint64_t state = seed ^ (index * 0xd1b54a32d192ed03ULL) ^ (row * 0x8cb92ba72f3d8dd7ULL);
+    return splitMix(state);
+}
+
+// uniform in [0, 1)
+double unitInterval(std::uint64_t value) {
+    return static_cast<double>(value >> 11) * (1.0 / 9007199254740992.0);
+}
+
+int interpolate(int low, int high, double t, SizeDistribution distribution) {
+    if (distribution == SizeDistribution::LogUniform)
+        return static_cast<int>(std::lround(low * std::pow(static_cast<double>(high) / low, t)));
+    return low + static_cast<int>(std::lround((high - low) * t));
+}
+
+// "WxH" with both sides in [1, 1 << 20]
+bool parseSize(const std::string& text, int& width, int& height) {
+    std::size_t x = text.find('x');
+    if (x == std::string::npos || x == 0 || x + 1 == text.size() || text.size() > 15 ||
+        text.find_first_not_of("0123456789x") != std::string::npos || text.find('x', x + 1) != std::string::npos)
+        return false;
+    long w = std::strtol(text.substr(0, x).c_str(), nullptr, 10);
+    long h = std::strtol(text.substr(x + 1).c_str(), nullptr, 10);
+    if (w < 1 || h < 1 || w > 1 << 20 || h > 1 << 20) return false;
+    width = static_cast<int>(w);
+    height = static_cast<int>(h);
+    return true;
+}
+
+// Rows per band of writeDatasetImage: about 4 MiB of pixels.
+int bandRows(int width) {
+    return static_cast<int>(std::max<std::size_t>(1, (std::size_t(4) << 20) / (3 * static_cast<std::size_t>(width))));
+}
+
+} // namespace
+
+
+bool parseDatasetSizes(const std::string& text, DatasetSpec& spec) {
+    std::size_t dash = text.find('-');
+    int minWidth = 0;
+    int minHeight = 0;
+    int maxWidth = 0;
+    int maxHeight = 0;
+    if (!parseSize(text.substr(0, dash), minWidth, minHeight)) return false;
+    if (dash == std::string::npos) {
+        maxWidth = minWidth;
+        maxHeight = minHeight;
+    } else if (!parseSize(text.substr(dash + 1), maxWidth, maxHeight) || maxWidth < minWidth ||
+               maxHeight < minHeight) {
+        return false;
+    }
+    spec.minWidth = minWidth;
+    spec.minHeight = minHeight;
+    spec.maxWidth = maxWidth;
+    spec.maxHeight = maxHeight;
+    return true;
+}
+
+
+void datasetImageSize(const DatasetSpec& spec, std::size_t index, int& width, int& height) {
+    if (spec.distribution == SizeDistribution::Fixed) {
+        width = spec.minWidth;
+        height = spec.minHeight;
+        return;
+    }
+    // one draw for both sides keeps the aspect ratio between the two extremes
+    double t = unitInterval(streamState(spec.seed, index, ~std::uint64_t(0)));
+    width = interpolate(spec.minWidth, spec.maxWidth, t, spec.distribution);
+    height = interpolate(spec.minHeight, spec.maxHeight, t, spec.distribution);
+}
+
+
+std::string datasetImageName(std::size_t index) {
+    char name[32];
+    std::snprintf(name, sizeof(name), "image_%06zu.ppm", index + 1);
+    return name;
+}
+
+
+void generateDatasetRows(const DatasetSpec& spec, std::size_t index, int first, RgbImage& band) {
+    int imageWidth = 0;
+    int height = 0;
+    datasetImageSize(spec, index, imageWidth, height);
+    const std::size_t samples = static_cast<std::size_t>(band.width) * 3;
+    for (int i = 0; i < band.height; ++i) {
+        int y = first + i;
+        std::uint64_t state = streamState(spec.seed, index, static_cast<std::uint64_t>(y));
+        std::uint8_t* row = band.row(i);
+        if (spec.content == DatasetContent::Noise) {
+            std::size_t k = 0;
+            for (; k + 8 <= samples; k += 8) {
+                std::uint64_t bits = splitMix(state);
+                std::memcpy(row + k, &bits, 8);
+            }
+            std::uint64_t bits = splitMix(state);
+            for (; k < samples; ++k, bits >>= 8) row[k] = static_cast<std::uint8_t>(bits);
+            continue;
+        }
+
+        // ramps in x (red) and y (green), blue falling with both, plus
+        // noise in [-8, 7]
+        int green = y * 255 / std::max(height - 1, 1);
+        std::uint64_t bits = 0;
+        for (int x = 0; x < band.width; ++x) {
+            if (x % 5 == 0) bits = splitMix(state);
+            int red = x * 255 / std::max(imageWidth - 1, 1);
+            int values[3] = {red, green, 255 - (red + green) / 2};
+            for (int c = 0; c < 3; ++c, bits >>= 4) {
+                int value = values[c] + static_cast<int>(bits & 15) - 8;
+                row[3 * x + c] = static_cast<std::uint8_t>(std::clamp(value, 0, 255));
+            }
+        }
+    }
+}
+
+
+bool writeDatasetImage(const DatasetSpec& spec, std::size_t index, const std::string& path) {
+    int width = 0;
+    int height = 0;
+    datasetImageSize(spec, index, width, height);
+    std::ofstream out(path, std::ios::binary);
+    if (!out) return false;
+
+    PpmStreamWriter writer(out, width, height, spec.encoding);
+    RgbImage band;
+    int rows = bandRows(width);
+    for (int first = 0; first < height; first += rows) {
+        band.resize(width, std::min(rows, height - first));
+        generateDatasetRows(spec, index, first, band);
+        if (!writer.writeRows(band.view())) return false;
+    }
+    return writer.finish();
+}
@@ -0,0 +1,118 @@
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <thread>
+#include "dataset.hpp"
+#include "thread_pool.hpp"
+
+
+namespace fs = std::filesystem;
+
+
+void printUsage() {
+    std::cerr << "Usage: ./grayscale_gen <output_folder> [options]\n"
+              << "Writes a reproducible synthetic dataset of PPM images named image_000001.ppm, ...\n"
+              << "Options:\n"
+              << "  --count N                  number of images (default: 100)\n"
+              << "  --size WxH[-WxH]           image size, or the smallest and largest (default: 100x100)\n"
+              << "  --distribution D           fixed, uniform or log: how sizes spread over the range\n"
+              << "                             (default: fixed, or uniform when a range is given)\n"
+              << "  --format P3|P6             PPM encoding (default: P3)\n"
+              << "  --content noise|gradient   uniform noise, or smooth ramps with a little noise (default: noise)\n"
+              << "  --seed S                   the same seed gives the same dataset (default: 1)\n"
+              << "  --threads N                images generated in parallel (default: hardware concurrency)\n";
+}
+
+
+int main(int argc, char* argv[]) {
+    if (argc < 2 || std::string(argv[1]).rfind("--", 0) == 0) {
+        printUsage();
+        return 1;
+    }
+
+    std::string folder = argv[1];
+    DatasetSpec spec;
+    bool distributionGiven = false;
+    unsigned threads = std::thread::hardware_concurrency();
+    for (int i = 2; i < argc; ++i) {
+        std::string option = argv[i];
+        std::string value = i + 1 < argc ? argv[i + 1] : "";
+        char* end = nullptr;
+        unsigned long long number = std::strtoull(value.c_str(), &end, 10);
+        bool isNumber = !value.empty() && *end == '\0' && value[0] != '-';
+        bool ok = i + 1 < argc;
+        if (option == "--count") {
+            ok = ok && isNumber && number <= 100000000;
+            spec.count = static_cast<std::size_t>(number);
+        } else if (option == "--size") {
+            ok = ok && parseDatasetSizes(value, spec);
+        } else if (option == "--distribution") {
+            distributionGiven = true;
+            if (value == "fixed") spec.distribution = SizeDistribution::Fixed;
+            else if (value == "uniform") spec.distribution = SizeDistribution::Uniform;
+            else if (value == "log") spec.distribution = SizeDistribution::LogUniform;
+            else ok = false;
+        } else if (option == "--format") {
+            if (value == "P3") spec.encoding = PnmEncoding::Plain;
+            else if (value == "P6") spec.encoding = PnmEncoding::Raw;
+            else ok = false;
+        } else if (option == "--content") {
+            if (value == "noise") spec.content = DatasetContent::Noise;
+            else if (value == "gradient") spec.content = DatasetContent::Gradient;
+            else ok = false;
+        } else if (option == "--seed") {
+            ok = ok && isNumber;
+            spec.seed = number;
+        } else if (option == "--threads") {
+            ok = ok && isNumber && number >= 1 && number <= 1024;
+            threads = static_cast<unsigned>(number);
+        } else {
+            std::cerr << "Unknown option: " << option << "\n";
+            printUsage();
+            return 1;
+        }
+        if (!ok) {
+            std::cerr << "Invalid value for " << option << ": " << value << "\n";
+            return 1;
+        }
+        ++i;
+    }
+    bool range = spec.minWidth != spec.maxWidth || spec.minHeight != spec.maxHeight;
+    if (!distributionGiven && range) spec.distribution = SizeDistribution::Uniform;
+
+    std::error_code ec;
+    fs::create_directories(folder, ec);
+    if (ec) {
+        std::cerr << "Failed to create " << folder << "\n";
+        return 1;
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    std::atomic<int> failures{0};
+    {
+        ThreadPool pool(threads);
+        for (std::size_t k = 0; k < spec.count; ++k) {
+            pool.submit([&, k] {
+                std::string path = (fs::path(folder) / datasetImageName(k)).string();
+                if (writeDatasetImage(spec, k, path)) return;
+                failures.fetch_add(1);
+                std::cerr << "Failed to write " + path + "\n";
+            });
+        }
+        pool.wait();
+    }
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    double pixels = 0;
+    for (std::size_t k = 0; k < spec.count; ++k) {
+        int width = 0;
+        int height = 0;
+        datasetImageSize(spec, k, width, height);
+        pixels += static_cast<double>(width) * height;
+    }
+    std::cout << "Generated " << spec.count << " images, " << pixels / 1e6 << " Mpx, in " << seconds << " s\n";
+    return failures.load() == 0 ? 0 : 1;
+}
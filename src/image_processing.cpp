@@ -28,45 +28,310 @@
 #include <string>
 #include <filesystem>
 #include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <unistd.h>
 #include "image_processing.hpp"
+#include "grayscale_kernels.hpp"
+#include "thread_pool.hpp"
+
+
+int luminosityPixel(int R, int G, int B) {
+    return static_cast<int>(0.21 * R + 0.72 * G + 0.07 * B);
+}
+
+
+// floor(sqrt(s / 3.0)) for every possible s = R^2 + G^2 + B^2, computed with
+// the double formula itself so the table is exact by construction
+static const std::uint8_t* rootMeanSquareTable() {
+    static const std::vector<std::uint8_t> table = [] {
+        std::vector<std::uint8_t> values(3 * 255 * 255 + 1);
+        for (std::size_t s = 0; s < values.size(); ++s)
+            values[s] = static_cast<std::uint8_t>(std::sqrt(s / 3.0));
+        return values;
+    }();
+    return table.data();
+}
+
+
+// Gray value of one pixel, specialized at compile time so the row loops carry
+// no per-pixel method dispatch.
+template <GrayscaleMethod Method>
+static inline int grayValue(int R, int G, int B, const std::uint8_t* rmsTable) {
+    if constexpr (Method == GrayscaleMethod::Lightness) {
+        int mx = R > G ? (R > B ? R : B) : (G > B ? G : B);
+        int mn = R < G ? (R < B ? R : B) : (G < B ? G : B);
+        return (mx + mn) / 2;
+    } else if constexpr (Method == GrayscaleMethod::Average) {
+        return (R + G + B) / 3;
+    } else if constexpr (Method == GrayscaleMethod::Luminosity) {
+        // t / 100 in fixed point ((t * 5243) >> 19 is exact for t <= 25500).
+        // 0.21 R + 0.72 G + 0.07 B evaluated in doubles can only land below
+        // t / 100 when t is a multiple of 100; only those pixels (about 1%)
+        // need the double formula to decide.
+        int t = 21 * R + 72 * G + 7 * B;
+        int q = (t * 5243) >> 19;
+        return q * 100 != t ? q : luminosityPixel(R, G, B);
+    } else if constexpr (Method == GrayscaleMethod::RootMeanSquare) {
+        return rmsTable[R * R + G * G + B * B];
+    } else if constexpr (Method == GrayscaleMethod::RedChannel) {
+        return R;
+    } else if constexpr (Method == GrayscaleMethod::GreenChannel) {
+        return G;
+    } else {
+        return B;
+    }
+}
+
+
+// Reference row kernel for one method.
+template <GrayscaleMethod Method>
+static void scalarRow(const std::uint8_t* src, std::uint8_t* dst, int cols) {
+    const std::uint8_t* rmsTable = Method == GrayscaleMethod::RootMeanSquare ? rootMeanSquareTable() : nullptr;
+    for (int j = 0; j < cols; ++j)
+        dst[j] = static_cast<std::uint8_t>(grayValue<Method>(src[3 * j], src[3 * j + 1], src[3 * j + 2], rmsTable));
+}
+
+
+static void invalidMethodRow(const std::uint8_t*, std::uint8_t* dst, int cols) {
+    std::fill(dst, dst + cols, 0);
+}
+
+
+static GrayscaleRowKernel scalarRowKernel(GrayscaleMethod method) {
+    switch (method) {
+        case GrayscaleMethod::Lightness: return scalarRow<GrayscaleMethod::Lightness>;
+        case GrayscaleMethod::Average: return scalarRow<GrayscaleMethod::Average>;
+        case GrayscaleMethod::Luminosity: return scalarRow<GrayscaleMethod::Luminosity>;
+        case GrayscaleMethod::RootMeanSquare: return scalarRow<GrayscaleMethod::RootMeanSquare>;
+        case GrayscaleMethod::RedChannel: return scalarRow<GrayscaleMethod::RedChannel>;
+        case GrayscaleMethod::GreenChannel: return scalarRow<GrayscaleMethod::GreenChannel>;
+        case GrayscaleMethod::BlueChannel: return scalarRow<GrayscaleMethod::BlueChannel>;
+        default: return invalidMethodRow;
+    }
+}
+
+
+GrayscaleRowKernel rowKernel(GrayscaleMethod method, SimdLevel level) {
+    GrayscaleRowKernel kernel = nullptr;
+    switch (level) {
+        case SimdLevel::Scalar:
+            return scalarRowKernel(method);
+        case SimdLevel::Sse41:
+#ifdef GRAYSCALE_HAVE_SSE41
+            kernel = sse41RowKernel(method);
+#endif
+            break;
+        case SimdLevel::Avx2:
+#ifdef GRAYSCALE_HAVE_AVX2
+            kernel = avx2RowKernel(method);
+#endif
+            break;
+        case SimdLevel::Avx512:
+#ifdef GRAYSCALE_HAVE_AVX512
+            kernel = avx512RowKernel(method);
+#endif
+            break;
+    }
+    // levels without a kernel for this method (e.g. Invalid) use the reference one
+    return kernel ? kernel : scalarRowKernel(method);
+}
+
+
+SimdLevel detectSimdLevel() {
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+    __builtin_cpu_init();
+#ifdef GRAYSCALE_HAVE_AVX512
+    if (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) return SimdLevel::Avx512;
+#endif
+#ifdef GRAYSCALE_HAVE_AVX2
+    if (__builtin_cpu_supports("avx2")) return SimdLevel::Avx2;
+#endif
+#ifdef GRAYSCALE_HAVE_SSE41
+    if (__builtin_cpu_supports("sse4.1")) return SimdLevel::Sse41;
+#endif
+#endif
+    return SimdLevel::Scalar;
+}
+
+
+const char* simdLevelName(SimdLevel level) {
+    switch (level) {
+        case SimdLevel::Sse41: return "sse4.1";
+        case SimdLevel::Avx2: return "avx2";
+        case SimdLevel::Avx512: return "avx512";
+        default: return "scalar";
+    }
+}
+
+
+static SimdLevel initialSimdLevel() {
+    SimdLevel level = detectSimdLevel();
+    if (const char* requested = std::getenv("GRAYSCALE_SIMD")) {
+        for (SimdLevel candidate : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Avx512})
+            if (std::string(requested) == simdLevelName(candidate))
+                level = std::min(candidate, level);
+    }
+    return level;
+}
+
+
+static std::atomic<SimdLevel>& activeLevel() {
+    static std::atomic<SimdLevel> level{initialSimdLevel()};
+    return level;
+}
+
+
+SimdLevel activeSimdLevel() {
+    return activeLevel().load(std::memory_order_relaxed);
+}
+
+
+SimdLevel setSimdLevel(SimdLevel level) {
+    level = std::min(level, detectSimdLevel());
+    activeLevel().store(level, std::memory_order_relaxed);
+    return level;
+}
+
+
+GrayscaleMethod stringToGrayscaleMethod(const std::string& method) {
+    if (method == "Lightness") return GrayscaleMethod::Lightness;
+    if (method == "Average") return GrayscaleMethod::Average;
+    if (method == "Luminosity") return GrayscaleMethod::Luminosity;
+    if (method == "RootMeanSquare") return GrayscaleMethod::RootMeanSquare;
+    if (method == "RedChannel") return GrayscaleMethod::RedChannel;
+    if (method == "GreenChannel") return GrayscaleMethod::GreenChannel;
+    if (method == "BlueChannel") return GrayscaleMethod::BlueChannel;
+    return GrayscaleMethod::Invalid;
+}
+
+
+// Size of the per-core L2 cache, used to size the row bands of a parallel
+// conversion; 1 MiB when the C library cannot tell.
+static std::size_t l2CacheBytes() {
+    static const std::size_t bytes = [] {
+#ifdef _SC_LEVEL2_CACHE_SIZE
+        long size = sysconf(_SC_LEVEL2_CACHE_SIZE);
+        if (size > 0) return static_cast<std::size_t>(size);
+#endif
+        return static_cast<std::size_t>(1) << 20;
+    }();
+    return bytes;
+}
+
+
+// Runs every kernel over every row. The image is cut into row bands whose
+// input and output rows together take about half of L2. Without a pool (or
+// for images that fit a single band) the bands are converted in order on the
+// calling thread, otherwise they are spread over the pool. Each band writes
+// only its own rows, so the result does not depend on how the bands are
+// scheduled. onBand, if set, is called with each band right after it is
+// converted, while its rows are still in cache; its bands start at multiples
+// of bandAlignment rows.
+static void convertRows(const RgbView& rgbImage, const GrayscaleRowKernel* kernels,
+                        GrayImage* grayscaleImages, std::size_t count, ThreadPool* pool,
+                        const GrayscaleBandCallback* onBand = nullptr, int bandAlignment = 1) {
+    auto convertBand = [&](int first, int rows) {
+        for (int i = first; i < first + rows; ++i) {
+            const std::uint8_t* src = rgbImage.row(i);
+            for (std::size_t m = 0; m < count; ++m)
+                kernels[m](src, grayscaleImages[m].row(i), rgbImage.width);
+        }
+        if (onBand) (*onBand)(first, rows);
+    };
+
+    std::size_t rowBytes = static_cast<std::size_t>(rgbImage.width) * (3 + count);
+    int bandRows = static_cast<int>(std::clamp<std::size_t>(l2CacheBytes() / 2 / std::max<std::size_t>(rowBytes, 1),
+                                                            1, static_cast<std::size_t>(std::max(rgbImage.height, 1))));
+    bandRows = (bandRows + bandAlignment - 1) / bandAlignment * bandAlignment;
+    int bands = rgbImage.height > 0 ? (rgbImage.height + bandRows - 1) / bandRows : 0;
+    if (pool == nullptr || pool->size() < 2 || bands < 2) {
+        if (!onBand) {
+            convertBand(0, rgbImage.height);
+            return;
+        }
+        for (int first = 0; first < rgbImage.height; first += bandRows)
+            convertBand(first, std::min(bandRows, rgbImage.height - first));
+        return;
+    }
+
+    pool->parallelFor(static_cast<std::size_t>(bands), [&](std::size_t band) {
+        int first = static_cast<int>(band) * bandRows;
+        convertBand(first, std::min(bandRows, rgbImage.height - first));
+    });
+}
+
+
+void convertToGrayscale(const RgbView& rgbImage, GrayscaleMethod method, GrayImage& grayscaleImage,
+                        ThreadPool* pool) {
+    grayscaleImage.resize(rgbImage.width, rgbImage.height);
+    GrayscaleRowKernel kernel = rowKernel(method, activeSimdLevel());
+    convertRows(rgbImage, &kernel, &grayscaleImage, 1, pool);
+}
+
+
+void convertToGrayscale(const RgbImage& rgbImage, GrayscaleMethod method, GrayImage& grayscaleImage,
+                        ThreadPool* pool) {
+    convertToGrayscale(rgbImage.view(), method, grayscaleImage, pool);
+}
+
+
+void convertToGrayscale(const RgbView& rgbImage, const std::vector<GrayscaleMethod>& methods,
+                        std::vector<GrayImage>& grayscaleImages, ThreadPool* pool) {
+    convertToGrayscale(rgbImage, methods, grayscaleImages, pool, GrayscaleBandCallback());
+}
+
+
+void convertToGrayscale(const RgbView& rgbImage, const std::vector<GrayscaleMethod>& methods,
+                        std::vector<GrayImage>& grayscaleImages, ThreadPool* pool,
+                        const GrayscaleBandCallback& onBand) {
+    convertToGrayscale(rgbImage, methods, grayscaleImages, pool, onBand, 1);
+}
+
+
+void convertToGrayscale(const RgbView& rgbImage, const std::vector<GrayscaleMethod>& methods,
+                        std::vector<GrayImage>& grayscaleImages, ThreadPool* pool,
+                        const GrayscaleBandCallback& onBand, int bandAlignment) {
+    grayscaleImages.resize(methods.size());
+    for (GrayImage& gray : grayscaleImages)
+        gray.resize(rgbImage.width, rgbImage.height);
+
+    // kernels of up to every method live on the stack, so a conversion into
+    // already sized images does not touch the heap
+    std::array<GrayscaleRowKernel, 8> localKernels;
+    std::vector<GrayscaleRowKernel> heapKernels;
+    GrayscaleRowKernel* kernels = localKernels.data();
+    if (methods.size() > localKernels.size()) {
+        heapKernels.resize(methods.size());
+        kernels = heapKernels.data();
+    }
+    for (std::size_t m = 0; m < methods.size(); ++m)
+        kernels[m] = rowKernel(methods[m], activeSimdLevel());
+
+    convertRows(rgbImage, kernels, grayscaleImages.data(), methods.size(), pool, onBand ? &onBand : nullptr,
+                std::max(bandAlignment, 1));
+}
 
 
 void convertToGrayscale(const std::vector<std::vector<std::array<int, 3>>>& rgbImage,
                         int rows, int cols,
                         GrayscaleMethod method, std::vector<std::vector<int>>& grayscaleImage) {
-    grayscaleImage.resize(rows, std::vector<int>(cols, 0));
+    RgbImage rgb(cols, rows);
     for (int i = 0; i < rows; ++i) {
         for (int j = 0; j < cols; ++j) {
-            int R = rgbImage[i][j][0];
-            int G = rgbImage[i][j][1];
-            int B = rgbImage[i][j][2];
-            int gray = 0;
-            switch (method) {
-                case GrayscaleMethod::Lightness:
-                    gray = (std::max({R, G, B}) + std::min({R, G, B})) / 2;
-                    break;
-                case GrayscaleMethod::Average:
-                    gray = (R + G + B) / 3;
-                    break;
-                case GrayscaleMethod::Luminosity:
-                    gray = static_cast<int>(0.21 * R + 0.72 * G + 0.07 * B);
-                    break;
-                case GrayscaleMethod::RootMeanSquare:
-                    gray = static_cast<int>(std::sqrt((R * R + G * G + B * B) / 3.0));
-                    break;
-                case GrayscaleMethod::RedChannel:
-                    gray = R;
-                    break;
-                case GrayscaleMethod::GreenChannel:
-                    gray = G;
-                    break;
-                case GrayscaleMethod::BlueChannel:
-                    gray = B;
-                    break;
-            }
-            grayscaleImage[i][j] = gray;
+            std::uint8_t* px = rgb.pixel(i, j);
+            for (int c = 0; c < 3; ++c)
+                px[c] = static_cast<std::uint8_t>(std::clamp(rgbImage[i][j][c], 0, 255));
         }
     }
-}
 
+    GrayImage gray;
+    convertToGrayscale(rgb, method, gray);
 
+    grayscaleImage.assign(rows, std::vector<int>(cols, 0));
+    for (int i = 0; i < rows; ++i) {
+        const std::uint8_t* src = gray.row(i);
+        std::copy(src, src + cols, grayscaleImage[i].begin());
+    }
+}
@@ -0,0 +1,393 @@
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include "io_ring.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define IO_RING_HAS_POSIX_IO 1
+#endif
+
+#if defined(__linux__) && __has_include(<linux/io_uring.h>)
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#define IO_RING_HAS_IO_URING 1
+#endif
+
+
+namespace {
+
+// Largest transfer submitted at once; longer files take several.
+constexpr std::size_t maxTransferBytes = std::size_t(1) << 30;
+
+// Blocking fallback of readFiles for one file.
+bool readWhole(const char* path, std::vector<char>& data) {
+#ifdef IO_RING_HAS_POSIX_IO
+    int fd = ::open(path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0) return false;
+    struct stat st;
+    bool ok = fstat(fd, &st) == 0 && S_ISREG(st.st_mode);
+    std::size_t done = 0;
+    if (ok) data.resize(static_cast<std::size_t>(st.st_size));
+    while (ok && done < data.size()) {
+        ssize_t count = ::read(fd, data.data() + done, std::min(data.size() - done, maxTransferBytes));
+        if (count < 0 && errno == EINTR) continue;
+        if (count <= 0) {
+            // a file that shrank is read as it is now
+            ok = count == 0;
+            data.resize(done);
+            break;
+        }
+        done += static_cast<std::size_t>(count);
+    }
+    ::close(fd);
+    return ok;
+#else
+    std::ifstream in(path, std::ios::binary | std::ios::ate);
+    if (!in) return false;
+    data.resize(static_cast<std::size_t>(in.tellg()));
+    in.seekg(0);
+    in.read(data.data(), static_cast<std::streamsize>(data.size()));
+    return static_cast<bool>(in);
+#endif
+}
+
+// Blocking fallback of writeFiles for one file.
+bool writeWhole(const char* path, const char* data, std::size_t size) {
+#ifdef IO_RING_HAS_POSIX_IO
+    int fd = ::open(path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) return false;
+    bool ok = true;
+    while (ok && size > 0) {
+        ssize_t count = ::write(fd, data, std::min(size, maxTransferBytes));
+        if (count < 0 && errno == EINTR) continue;
+        ok = count > 0;
+        if (!ok) break;
+        data += count;
+        size -= static_cast<std::size_t>(count);
+    }
+    return ::close(fd) == 0 && ok;
+#else
+    std::ofstream out(path, std::ios::binary);
+    out.write(data, static_cast<std::streamsize>(size));
+    out.close();
+    return static_cast<bool>(out);
+#endif
+}
+
+} // namespace
+
+
+#ifdef IO_RING_HAS_IO_URING
+
+struct IoRing::Ring {
+    int fd = -1;
+    unsigned entries = 0;
+
+    void* sqMap = MAP_FAILED;
+    std::size_t sqMapBytes = 0;
+    void* cqMap = MAP_FAILED;
+    std::size_t cqMapBytes = 0;
+    io_uring_sqe* sqes = static_cast<io_uring_sqe*>(MAP_FAILED);
+    std::size_t sqesBytes = 0;
+
+    // shared with the kernel: we advance sqTail and cqHead, it advances
+    // sqHead and cqTail
+    unsigned* sqHead = nullptr;
+    unsigned* sqTail = nullptr;
+    unsigned sqMask = 0;
+    unsigned* sqArray = nullptr;
+    unsigned* cqHead = nullptr;
+    unsigned* cqTail = nullptr;
+    unsigned cqMask = 0;
+    io_uring_cqe* cqes = nullptr;
+
+    // items waiting for a submission slot, next one at the back
+    std::vector<std::size_t> queue;
+
+    ~Ring() {
+        if (sqes != MAP_FAILED) munmap(sqes, sqesBytes);
+        if (cqMap != MAP_FAILED && cqMap != sqMap) munmap(cqMap, cqMapBytes);
+        if (sqMap != MAP_FAILED) munmap(sqMap, sqMapBytes);
+        if (fd >= 0) ::close(fd);
+    }
+
+    // Runs one operation per item i < count for which prepare(i, sqe) fills
+    // in a submission, keeping up to `entries` of them in flight.
+    // complete(i, result) returns true to submit item i again, for the rest
+    // of a partial transfer or after a transient error.
+    template <typename Prepare, typename Complete>
+    void run(std::size_t count, Prepare prepare, Complete complete);
+};
+
+
+template <typename Prepare, typename Complete>
+void IoRing::Ring::run(std::size_t count, Prepare prepare, Complete complete) {
+    queue.clear();
+    for (std::size_t item = count; item-- > 0;) queue.push_back(item);
+
+    unsigned inFlight = 0;
+    bool failed = false;
+    while (!queue.empty() || inFlight > 0) {
+        unsigned tail = *sqTail;
+        while (!queue.empty() && inFlight < entries) {
+            std::size_t item = queue.back();
+            queue.pop_back();
+            unsigned index = tail & sqMask;
+            io_uring_sqe& sqe = sqes[index];
+            std::memset(&sqe, 0, sizeof(sqe));
+            if (!prepare(item, sqe)) continue;
+            sqe.user_data = item;
+            sqArray[index] = index;
+            ++tail;
+            ++inFlight;
+        }
+        __atomic_store_n(sqTail, tail, __ATOMIC_RELEASE);
+        if (inFlight == 0) break;
+
+        // submit whatever the kernel has not consumed yet and wait for at
+        // least one completion
+        unsigned pending = tail - __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+        long entered = syscall(__NR_io_uring_enter, fd, pending, 1, IORING_ENTER_GETEVENTS, nullptr, 0);
+        if (entered < 0 && errno != EINTR && errno != EAGAIN && errno != EBUSY) {
+            // the ring takes no more submissions: fail the queued items and
+            // those the kernel has not consumed, then collect the rest
+            int error = errno;
+            for (std::size_t item : queue) complete(item, -error);
+            queue.clear();
+            unsigned consumed = __atomic_load_n(sqHead, __ATOMIC_ACQUIRE);
+            for (unsigned k = consumed; k != tail; ++k)
+                complete(static_cast<std::size_t>(sqes[k & sqMask].user_data), -error);
+            inFlight -= tail - consumed;
+            __atomic_store_n(sqTail, consumed, __ATOMIC_RELEASE);
+            if (failed) break;
+            failed = true;
+        }
+
+        unsigned head = *cqHead;
+        unsigned ready = __atomic_load_n(cqTail, __ATOMIC_ACQUIRE);
+        for (; head != ready; ++head) {
+            const io_uring_cqe& cqe = cqes[head & cqMask];
+            auto item = static_cast<std::size_t>(cqe.user_data);
+            int result = cqe.res;
+            --inFlight;
+            if (complete(item, result) && !failed) queue.push_back(item);
+        }
+        __atomic_store_n(cqHead, head, __ATOMIC_RELEASE);
+    }
+}
+
+
+namespace {
+
+void prepareOpen(io_uring_sqe& sqe, const char* path, int flags, unsigned mode) {
+    sqe.opcode = IORING_OP_OPENAT;
+    sqe.fd = AT_FDCWD;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(path);
+    sqe.len = mode;
+    sqe.open_flags = static_cast<std::uint32_t>(flags);
+}
+
+void prepareTransfer(io_uring_sqe& sqe, std::uint8_t opcode, int fd, const char* data, std::size_t size,
+                     std::size_t offset) {
+    sqe.opcode = opcode;
+    sqe.fd = fd;
+    sqe.addr = reinterpret_cast<std::uintptr_t>(data);
+    sqe.len = static_cast<std::uint32_t>(std::min(size, maxTransferBytes));
+    sqe.off = offset;
+}
+
+bool isTransient(int result) {
+    return result == -EINTR || result == -EAGAIN;
+}
+
+} // namespace
+
+
+IoRing::IoRing() = default;
+IoRing::~IoRing() = default;
+
+
+bool IoRing::open(unsigned entries) {
+    ring_.reset();
+    io_uring_params params;
+    std::memset(&params, 0, sizeof(params));
+    auto ring = std::make_unique<Ring>();
+    ring->fd = static_cast<int>(syscall(__NR_io_uring_setup, std::max(entries, 1u), &params));
+    if (ring->fd < 0) return false;
+
+    // opens, reads and writes all arrived in 5.6, together with the probe
+    std::vector<char> probeBytes(sizeof(io_uring_probe) + 256 * sizeof(io_uring_probe_op));
+    auto* probe = reinterpret_cast<io_uring_probe*>(probeBytes.data());
+    if (syscall(__NR_io_uring_register, ring->fd, IORING_REGISTER_PROBE, probe, 256) < 0) return false;
+    for (int op : {IORING_OP_OPENAT, IORING_OP_READ, IORING_OP_WRITE})
+        if (op > probe->last_op || !(probe->ops[op].flags & IO_URING_OP_SUPPORTED)) return false;
+
+    ring->sqMapBytes = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+    ring->cqMapBytes = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+    if (params.features & IORING_FEAT_SINGLE_MMAP)
+        ring->sqMapBytes = ring->cqMapBytes = std::max(ring->sqMapBytes, ring->cqMapBytes);
+    ring->sqMap = mmap(nullptr, ring->sqMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, ring->fd,
+                       IORING_OFF_SQ_RING);
+    if (ring->sqMap == MAP_FAILED) return false;
+    if (params.features & IORING_FEAT_SINGLE_MMAP) {
+        ring->cqMap = ring->sqMap;
+    } else {
+        ring->cqMap = mmap(nullptr, ring->cqMapBytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE,
+                           ring->fd, IORING_OFF_CQ_RING);
+        if (ring->cqMap == MAP_FAILED) return false;
+    }
+    ring->sqesBytes = params.sq_entries * sizeof(io_uring_sqe);
+    ring->sqes = static_cast<io_uring_sqe*>(mmap(nullptr, ring->sqesBytes, PROT_READ | PROT_WRITE,
+                                                 MAP_SHARED | MAP_POPULATE, ring->fd, IORING_OFF_SQES));
+    if (ring->sqes == MAP_FAILED) return false;
+
+    auto* sq = static_cast<char*>(ring->sqMap);
+    auto* cq = static_cast<char*>(ring->cqMap);
+    ring->sqHead = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+    ring->sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+    ring->sqMask = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+    ring->sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+    ring->cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+    ring->cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+    ring->cqMask = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+    ring->cqes = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+    ring->entries = params.sq_entries;
+    ring_ = std::move(ring);
+    return true;
+}
+
+
+void IoRing::readFiles(FileRead* reads, std::size_t count) {
+    if (!ring_) {
+        for (std::size_t i = 0; i < count; ++i) reads[i].ok = readWhole(reads[i].path, *reads[i].data);
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        reads[i].ok = false;
+        reads[i].fd = -1;
+        reads[i].done = 0;
+    }
+    ring_->run(count,
+        [&](std::size_t i, io_uring_sqe& sqe) {
+            prepareOpen(sqe, reads[i].path, O_RDONLY | O_CLOEXEC, 0);
+            return true;
+        },
+        [&](std::size_t i, int result) {
+            if (isTransient(result)) return true;
+            reads[i].fd = result;
+            return false;
+        });
+
+    // the open brought the inode in, so fstat does not wait on the disk
+    for (std::size_t i = 0; i < count; ++i) {
+        struct stat st;
+        if (reads[i].fd < 0 || fstat(reads[i].fd, &st) != 0 || !S_ISREG(st.st_mode)) continue;
+        reads[i].data->resize(static_cast<std::size_t>(st.st_size));
+        reads[i].ok = true;
+    }
+
+    ring_->run(count,
+        [&](std::size_t i, io_uring_sqe& sqe) {
+            FileRead& read = reads[i];
+            if (!read.ok || read.done == read.data->size()) return false;
+            prepareTransfer(sqe, IORING_OP_READ, read.fd, read.data->data() + read.done,
+                            read.data->size() - read.done, read.done);
+            return true;
+        },
+        [&](std::size_t i, int result) {
+            FileRead& read = reads[i];
+            if (isTransient(result)) return true;
+            if (result <= 0) {
+                // a file that shrank is read as it is now
+                read.ok = result == 0;
+                read.data->resize(read.done);
+                return false;
+            }
+            read.done += static_cast<std::size_t>(result);
+            return read.done < read.data->size();
+        });
+
+    for (std::size_t i = 0; i < count; ++i)
+        if (reads[i].fd >= 0) ::close(reads[i].fd);
+}
+
+
+void IoRing::writeFiles(FileWrite* writes, std::size_t count) {
+    if (!ring_) {
+        for (std::size_t i = 0; i < count; ++i)
+            writes[i].ok = writeWhole(writes[i].path, writes[i].data, writes[i].size);
+        return;
+    }
+
+    for (std::size_t i = 0; i < count; ++i) {
+        writes[i].ok = false;
+        writes[i].fd = -1;
+        writes[i].done = 0;
+    }
+    ring_->run(count,
+        [&](std::size_t i, io_uring_sqe& sqe) {
+            prepareOpen(sqe, writes[i].path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+            return true;
+        },
+        [&](std::size_t i, int result) {
+            if (isTransient(result)) return true;
+            writes[i].fd = result;
+            writes[i].ok = result >= 0;
+            return false;
+        });
+
+    ring_->run(count,
+        [&](std::size_t i, io_uring_sqe& sqe) {
+            FileWrite& write = writes[i];
+            if (!write.ok || write.done == write.size) return false;
+            prepareTransfer(sqe, IORING_OP_WRITE, write.fd, write.data + write.done, write.size - write.done,
+                            write.done);
+            return true;
+        },
+        [&](std::size_t i, int result) {
+            FileWrite& write = writes[i];
+            if (isTransient(result)) return true;
+            // a write that makes no progress would never finish
+            if (result <= 0) {
+                write.ok = false;
+                return false;
+            }
+            write.done += static_cast<std::size_t>(result);
+            return write.done < write.size;
+        });
+
+    for (std::size_t i = 0; i < count; ++i)
+        if (writes[i].fd >= 0 && ::close(writes[i].fd) != 0) writes[i].ok = false;
+}
+
+#else
+
+struct IoRing::Ring {};
+
+IoRing::IoRing() = default;
+IoRing::~IoRing() = default;
+
+
+bool IoRing::open(unsigned) {
+    return false;
+}
+
+
+void IoRing::readFiles(FileRead* reads, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i) reads[i].ok = readWhole(reads[i].path, *reads[i].data);
+}
+
+
+void IoRing::writeFiles(FileWrite* writes, std::size_t count) {
+    for (std::size_t i = 0; i < count; ++i)
+        writes[i].ok = writeWhole(writes[i].path, writes[i].data, writes[i].size);
+}
+
+#endif
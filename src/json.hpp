@@ -0,0 +1,8 @@
+#pragma once
+#include <string>
+
+// Internal helpers shared by the JSON writers of the library (--stats,
+// --histogram) and the benchmarks.
+
+// JSON string literal; control characters are written as \u escapes
+std::string jsonQuoted(const std::string& text);
@@ -0,0 +1,83 @@
+// AVX2 row kernels: 32 pixels per iteration. Compiled with -mavx2 and only
+// called after detectSimdLevel() has confirmed CPU support.
+#include <immintrin.h>
+#include "kernels_simd.hpp"
+
+namespace {
+
+struct Avx2Ops {
+    using V = __m256i;
+    static constexpr int pixels = 32;
+
+    static V mask(int c, int k) {
+        return _mm256_broadcastsi128_si256(
+            _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleMasks.bytes[c][k])));
+    }
+
+    // chunk k of pixels 0-15 in the low lane, chunk k of pixels 16-31 in the high lane
+    static V loadChunk(const std::uint8_t* src, int k) {
+        return _mm256_loadu2_m128i(reinterpret_cast<const __m128i*>(src + 48 + 16 * k),
+                                   reinterpret_cast<const __m128i*>(src + 16 * k));
+    }
+
+    template <int C>
+    static V loadChannel(const std::uint8_t* src) {
+        return _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(loadChunk(src, 0), mask(C, 0)),
+                                               _mm256_shuffle_epi8(loadChunk(src, 1), mask(C, 1))),
+                               _mm256_shuffle_epi8(loadChunk(src, 2), mask(C, 2)));
+    }
+
+    static void loadRgb(const std::uint8_t* src, V& r, V& g, V& b) {
+        V a0 = loadChunk(src, 0), a1 = loadChunk(src, 1), a2 = loadChunk(src, 2);
+        r = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, mask(0, 0)), _mm256_shuffle_epi8(a1, mask(0, 1))),
+                            _mm256_shuffle_epi8(a2, mask(0, 2)));
+        g = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, mask(1, 0)), _mm256_shuffle_epi8(a1, mask(1, 1))),
+                            _mm256_shuffle_epi8(a2, mask(1, 2)));
+        b = _mm256_or_si256(_mm256_or_si256(_mm256_shuffle_epi8(a0, mask(2, 0)), _mm256_shuffle_epi8(a1, mask(2, 1))),
+                            _mm256_shuffle_epi8(a2, mask(2, 2)));
+    }
+
+    static void store(std::uint8_t* dst, V v) { _mm256_storeu_si256(reinterpret_cast<__m256i*>(dst), v); }
+
+    static V zero() { return _mm256_setzero_si256(); }
+    static V set8(int v) { return _mm256_set1_epi8(static_cast<char>(v)); }
+    static V set16(int v) { return _mm256_set1_epi16(static_cast<short>(v)); }
+    static V set32(int v) { return _mm256_set1_epi32(v); }
+
+    static V and_(V a, V b) { return _mm256_and_si256(a, b); }
+    static V xor_(V a, V b) { return _mm256_xor_si256(a, b); }
+    static V max8(V a, V b) { return _mm256_max_epu8(a, b); }
+    static V min8(V a, V b) { return _mm256_min_epu8(a, b); }
+    static V add8(V a, V b) { return _mm256_add_epi8(a, b); }
+    static V add16(V a, V b) { return _mm256_add_epi16(a, b); }
+    static V add32(V a, V b) { return _mm256_add_epi32(a, b); }
+    static V sub32(V a, V b) { return _mm256_sub_epi32(a, b); }
+    static V srli16(V a, int n) { return _mm256_srli_epi16(a, n); }
+    static V mullo16(V a, V b) { return _mm256_mullo_epi16(a, b); }
+    static V mulhi16(V a, V b) { return _mm256_mulhi_epu16(a, b); }
+    static V mullo32(V a, V b) { return _mm256_mullo_epi32(a, b); }
+    static V madd16(V a, V b) { return _mm256_madd_epi16(a, b); }
+    static V cmpeq16(V a, V b) { return _mm256_cmpeq_epi16(a, b); }
+    static V cmpgt32(V a, V b) { return _mm256_cmpgt_epi32(a, b); }
+
+    static V unpacklo8(V a, V b) { return _mm256_unpacklo_epi8(a, b); }
+    static V unpackhi8(V a, V b) { return _mm256_unpackhi_epi8(a, b); }
+    static V unpacklo16(V a, V b) { return _mm256_unpacklo_epi16(a, b); }
+    static V unpackhi16(V a, V b) { return _mm256_unpackhi_epi16(a, b); }
+    static V packus16(V a, V b) { return _mm256_packus_epi16(a, b); }
+    static V packs16(V a, V b) { return _mm256_packs_epi16(a, b); }
+    static V packus32(V a, V b) { return _mm256_packus_epi32(a, b); }
+    static std::uint64_t movemask8(V a) { return static_cast<std::uint32_t>(_mm256_movemask_epi8(a)); }
+
+    static V sqrtDiv3Trunc(V s) {
+        __m256 f = _mm256_mul_ps(_mm256_cvtepi32_ps(s), _mm256_set1_ps(1.0f / 3.0f));
+        return _mm256_cvttps_epi32(_mm256_sqrt_ps(f));
+    }
+};
+
+} // namespace
+
+
+GrayscaleRowKernel avx2RowKernel(GrayscaleMethod method) {
+    return simdRowKernel<Avx2Ops>(method);
+}
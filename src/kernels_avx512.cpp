@@ -0,0 +1,103 @@
+// AVX-512 (F + BW) row kernels: 64 pixels per iteration. Compiled with
+// -mavx512f -mavx512bw and only called after detectSimdLevel() has confirmed
+// CPU support.
+#include <immintrin.h>
+#include "kernels_simd.hpp"
+
+namespace {
+
+// shuffleMasks repeated in all four 128-bit lanes, loaded whole instead of
+// broadcast: GCC 12 warns about the unmasked broadcast under -Wall
+struct LaneMasks {
+    alignas(64) std::uint8_t bytes[3][3][64];
+};
+
+constexpr LaneMasks makeLaneMasks() {
+    LaneMasks masks{};
+    for (int c = 0; c < 3; ++c)
+        for (int k = 0; k < 3; ++k)
+            for (int p = 0; p < 64; ++p) masks.bytes[c][k][p] = shuffleMasks.bytes[c][k][p % 16];
+    return masks;
+}
+
+constexpr LaneMasks laneMasks = makeLaneMasks();
+
+struct Avx512Ops {
+    using V = __m512i;
+    static constexpr int pixels = 64;
+
+    static V mask(int c, int k) { return _mm512_load_si512(laneMasks.bytes[c][k]); }
+
+    // 128-bit lane j holds chunk k of pixels 16j to 16j+15
+    static V loadChunk(const std::uint8_t* src, int k) {
+        const std::uint8_t* p = src + 16 * k;
+        V v = _mm512_castsi128_si512(_mm_loadu_si128(reinterpret_cast<const __m128i*>(p)));
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 48)), 1);
+        v = _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 96)), 2);
+        return _mm512_inserti32x4(v, _mm_loadu_si128(reinterpret_cast<const __m128i*>(p + 144)), 3);
+    }
+
+    template <int C>
+    static V loadChannel(const std::uint8_t* src) {
+        return _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(loadChunk(src, 0), mask(C, 0)),
+                                               _mm512_shuffle_epi8(loadChunk(src, 1), mask(C, 1))),
+                               _mm512_shuffle_epi8(loadChunk(src, 2), mask(C, 2)));
+    }
+
+    static void loadRgb(const std::uint8_t* src, V& r, V& g, V& b) {
+        V a0 = loadChunk(src, 0), a1 = loadChunk(src, 1), a2 = loadChunk(src, 2);
+        r = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(a0, mask(0, 0)), _mm512_shuffle_epi8(a1, mask(0, 1))),
+                            _mm512_shuffle_epi8(a2, mask(0, 2)));
+        g = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(a0, mask(1, 0)), _mm512_shuffle_epi8(a1, mask(1, 1))),
+                            _mm512_shuffle_epi8(a2, mask(1, 2)));
+        b = _mm512_or_si512(_mm512_or_si512(_mm512_shuffle_epi8(a0, mask(2, 0)), _mm512_shuffle_epi8(a1, mask(2, 1))),
+                            _mm512_shuffle_epi8(a2, mask(2, 2)));
+    }
+
+    static void store(std::uint8_t* dst, V v) { _mm512_storeu_si512(dst, v); }
+
+    static V zero() { return _mm512_setzero_si512(); }
+    static V set8(int v) { return _mm512_set1_epi8(static_cast<char>(v)); }
+    static V set16(int v) { return _mm512_set1_epi16(static_cast<short>(v)); }
+    static V set32(int v) { return _mm512_set1_epi32(v); }
+
+    static V and_(V a, V b) { return _mm512_and_si512(a, b); }
+    static V xor_(V a, V b) { return _mm512_xor_si512(a, b); }
+    static V max8(V a, V b) { return _mm512_max_epu8(a, b); }
+    static V min8(V a, V b) { return _mm512_min_epu8(a, b); }
+    static V add8(V a, V b) { return _mm512_add_epi8(a, b); }
+    static V add16(V a, V b) { return _mm512_add_epi16(a, b); }
+    static V add32(V a, V b) { return _mm512_add_epi32(a, b); }
+    static V sub32(V a, V b) { return _mm512_sub_epi32(a, b); }
+    static V srli16(V a, int n) { return _mm512_srli_epi16(a, static_cast<unsigned>(n)); }
+    static V mullo16(V a, V b) { return _mm512_mullo_epi16(a, b); }
+    static V mulhi16(V a, V b) { return _mm512_mulhi_epu16(a, b); }
+    static V mullo32(V a, V b) { return _mm512_mullo_epi32(a, b); }
+    static V madd16(V a, V b) { return _mm512_madd_epi16(a, b); }
+    static V cmpeq16(V a, V b) { return _mm512_maskz_mov_epi16(_mm512_cmpeq_epi16_mask(a, b), _mm512_set1_epi16(-1)); }
+    static V cmpgt32(V a, V b) { return _mm512_maskz_mov_epi32(_mm512_cmpgt_epi32_mask(a, b), _mm512_set1_epi32(-1)); }
+
+    static V unpacklo8(V a, V b) { return _mm512_unpacklo_epi8(a, b); }
+    static V unpackhi8(V a, V b) { return _mm512_unpackhi_epi8(a, b); }
+    static V unpacklo16(V a, V b) { return _mm512_unpacklo_epi16(a, b); }
+    static V unpackhi16(V a, V b) { return _mm512_unpackhi_epi16(a, b); }
+    static V packus16(V a, V b) { return _mm512_packus_epi16(a, b); }
+    static V packs16(V a, V b) { return _mm512_packs_epi16(a, b); }
+    static V packus32(V a, V b) { return _mm512_packus_epi32(a, b); }
+    static std::uint64_t movemask8(V a) { return _mm512_movepi8_mask(a); }
+
+    // full-mask forms of cvtepi32_ps, sqrt_ps and cvttps_epi32, whose
+    // unmasked GCC 12 versions warn about their undefined pass-through
+    static V sqrtDiv3Trunc(V s) {
+        const __mmask16 all = 0xffff;
+        __m512 f = _mm512_mul_ps(_mm512_maskz_cvtepi32_ps(all, s), _mm512_set1_ps(1.0f / 3.0f));
+        return _mm512_maskz_cvttps_epi32(all, _mm512_maskz_sqrt_ps(all, f));
+    }
+};
+
+} // namespace
+
+
+GrayscaleRowKernel avx512RowKernel(GrayscaleMethod method) {
+    return simdRowKernel<Avx512Ops>(method);
+}
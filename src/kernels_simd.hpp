@@ -0,0 +1,184 @@
+#pragma once
+// Vector row kernels shared by kernels_sse41.cpp, kernels_avx2.cpp and
+// kernels_avx512.cpp. Each of those files defines an `Ops` type wrapping its
+// intrinsics and instantiates simdRowKernel<Ops>; everything here has internal
+// linkage so that code compiled for one instruction set can never be picked
+// by the linker for another.
+//
+// Ops provides a vector type V holding Ops::pixels bytes and the integer
+// operations used below. Lane-wise "unpack" and "pack" operations only have
+// to agree with each other (packing the results of unpacklo/unpackhi restores
+// the original order), which holds for the per-128-bit-lane x86 instructions.
+#include <cstdint>
+#include "grayscale_kernels.hpp"
+
+namespace {
+
+// pshufb masks gathering channel c of 16 pixels from the k-th 16-byte chunk
+// of their 48 bytes of packed RGB; 0x80 zeroes bytes from other chunks.
+struct ShuffleMasks {
+    std::uint8_t bytes[3][3][16];
+};
+
+constexpr ShuffleMasks makeShuffleMasks() {
+    ShuffleMasks masks{};
+    for (int c = 0; c < 3; ++c) {
+        for (int k = 0; k < 3; ++k) {
+            for (int p = 0; p < 16; ++p) {
+                int source = 3 * p + c - 16 * k;
+                masks.bytes[c][k][p] = (source >= 0 && source < 16) ? static_cast<std::uint8_t>(source) : 0x80;
+            }
+        }
+    }
+    return masks;
+}
+
+constexpr ShuffleMasks shuffleMasks = makeShuffleMasks();
+
+// Runs block on every full vector of pixels and the scalar reference kernel on
+// the remaining tail.
+template <typename Ops, typename Block>
+inline void forEachBlock(const std::uint8_t* rgb, std::uint8_t* gray, int width,
+                         GrayscaleMethod method, Block block) {
+    int x = 0;
+    for (; x + Ops::pixels <= width; x += Ops::pixels)
+        block(rgb + 3 * x, gray + x);
+    if (x < width)
+        rowKernel(method, SimdLevel::Scalar)(rgb + 3 * x, gray + x, width - x);
+}
+
+template <typename Ops>
+void lightnessRow(const std::uint8_t* rgb, std::uint8_t* gray, int width) {
+    using V = typename Ops::V;
+    forEachBlock<Ops>(rgb, gray, width, GrayscaleMethod::Lightness, [](const std::uint8_t* src, std::uint8_t* dst) {
+        V r, g, b;
+        Ops::loadRgb(src, r, g, b);
+        V mx = Ops::max8(Ops::max8(r, g), b);
+        V mn = Ops::min8(Ops::min8(r, g), b);
+        // (mx + mn) / 2 without leaving 8 bits: (mx & mn) + ((mx ^ mn) >> 1)
+        V half = Ops::and_(Ops::srli16(Ops::xor_(mx, mn), 1), Ops::set8(0x7F));
+        Ops::store(dst, Ops::add8(Ops::and_(mx, mn), half));
+    });
+}
+
+template <typename Ops>
+void averageRow(const std::uint8_t* rgb, std::uint8_t* gray, int width) {
+    using V = typename Ops::V;
+    forEachBlock<Ops>(rgb, gray, width, GrayscaleMethod::Average, [](const std::uint8_t* src, std::uint8_t* dst) {
+        V r, g, b;
+        Ops::loadRgb(src, r, g, b);
+        V zero = Ops::zero();
+        V sumLo = Ops::add16(Ops::add16(Ops::unpacklo8(r, zero), Ops::unpacklo8(g, zero)), Ops::unpacklo8(b, zero));
+        V sumHi = Ops::add16(Ops::add16(Ops::unpackhi8(r, zero), Ops::unpackhi8(g, zero)), Ops::unpackhi8(b, zero));
+        // x / 3 == (x * 0xAAAB) >> 17 for every 16-bit x
+        V third = Ops::set16(0xAAAB);
+        V lo = Ops::srli16(Ops::mulhi16(sumLo, third), 1);
+        V hi = Ops::srli16(Ops::mulhi16(sumHi, third), 1);
+        Ops::store(dst, Ops::packus16(lo, hi));
+    });
+}
+
+template <typename Ops>
+void luminosityRow(const std::uint8_t* rgb, std::uint8_t* gray, int width) {
+    using V = typename Ops::V;
+    forEachBlock<Ops>(rgb, gray, width, GrayscaleMethod::Luminosity, [](const std::uint8_t* src, std::uint8_t* dst) {
+        V r, g, b;
+        Ops::loadRgb(src, r, g, b);
+        V zero = Ops::zero();
+        V c21 = Ops::set16(21), c72 = Ops::set16(72), c7 = Ops::set16(7);
+        V c100 = Ops::set16(100), inv100 = Ops::set16(5243);
+
+        // t = 100 * (0.21 R + 0.72 G + 0.07 B) is exact in 16 bits
+        V tLo = Ops::add16(Ops::add16(Ops::mullo16(Ops::unpacklo8(r, zero), c21),
+                                      Ops::mullo16(Ops::unpacklo8(g, zero), c72)),
+                           Ops::mullo16(Ops::unpacklo8(b, zero), c7));
+        V tHi = Ops::add16(Ops::add16(Ops::mullo16(Ops::unpackhi8(r, zero), c21),
+                                      Ops::mullo16(Ops::unpackhi8(g, zero), c72)),
+                           Ops::mullo16(Ops::unpackhi8(b, zero), c7));
+        // t / 100 == (t * 5243) >> 19 for t <= 25500
+        V qLo = Ops::srli16(Ops::mulhi16(tLo, inv100), 3);
+        V qHi = Ops::srli16(Ops::mulhi16(tHi, inv100), 3);
+        Ops::store(dst, Ops::packus16(qLo, qHi));
+
+        // when t is a multiple of 100 the double formula may round just below
+        // the integer t / 100; those pixels take the reference value
+        V exactLo = Ops::cmpeq16(Ops::mullo16(qLo, c100), tLo);
+        V exactHi = Ops::cmpeq16(Ops::mullo16(qHi, c100), tHi);
+        std::uint64_t fixups = Ops::movemask8(Ops::packs16(exactLo, exactHi));
+        while (fixups != 0) {
+            int i = __builtin_ctzll(fixups);
+            dst[i] = static_cast<std::uint8_t>(luminosityPixel(src[3 * i], src[3 * i + 1], src[3 * i + 2]));
+            fixups &= fixups - 1;
+        }
+    });
+}
+
+// floor(sqrt(s / 3)) for 32-bit lanes s <= 3 * 255^2: a float estimate
+// corrected by at most one step with exact integer comparisons
+template <typename Ops>
+inline typename Ops::V rootMeanSquare32(typename Ops::V s) {
+    using V = typename Ops::V;
+    V k = Ops::sqrtDiv3Trunc(s);
+    V three = Ops::set32(3), one = Ops::set32(1);
+    // k too large: 3k^2 > s -> k - 1 (the compare yields -1)
+    k = Ops::add32(k, Ops::cmpgt32(Ops::mullo32(Ops::mullo32(k, k), three), s));
+    // k too small: 3(k+1)^2 <= s -> k + 1
+    V k1 = Ops::add32(k, one);
+    k = Ops::sub32(k, Ops::cmpgt32(Ops::add32(s, one), Ops::mullo32(Ops::mullo32(k1, k1), three)));
+    return k;
+}
+
+template <typename Ops>
+inline typename Ops::V sumOfSquares32(typename Ops::V r16, typename Ops::V g16, typename Ops::V b16, bool high) {
+    using V = typename Ops::V;
+    V zero = Ops::zero();
+    V rg = high ? Ops::unpackhi16(r16, g16) : Ops::unpacklo16(r16, g16);
+    V b0 = high ? Ops::unpackhi16(b16, zero) : Ops::unpacklo16(b16, zero);
+    return Ops::add32(Ops::madd16(rg, rg), Ops::madd16(b0, b0));
+}
+
+template <typename Ops>
+void rootMeanSquareRow(const std::uint8_t* rgb, std::uint8_t* gray, int width) {
+    using V = typename Ops::V;
+    forEachBlock<Ops>(rgb, gray, width, GrayscaleMethod::RootMeanSquare, [](const std::uint8_t* src, std::uint8_t* dst) {
+        V r, g, b;
+        Ops::loadRgb(src, r, g, b);
+        V zero = Ops::zero();
+        V halves[2];
+        for (int h = 0; h < 2; ++h) {
+            V r16 = h ? Ops::unpackhi8(r, zero) : Ops::unpacklo8(r, zero);
+            V g16 = h ? Ops::unpackhi8(g, zero) : Ops::unpacklo8(g, zero);
+            V b16 = h ? Ops::unpackhi8(b, zero) : Ops::unpacklo8(b, zero);
+            V lo = rootMeanSquare32<Ops>(sumOfSquares32<Ops>(r16, g16, b16, false));
+            V hi = rootMeanSquare32<Ops>(sumOfSquares32<Ops>(r16, g16, b16, true));
+            halves[h] = Ops::packus32(lo, hi);
+        }
+        Ops::store(dst, Ops::packus16(halves[0], halves[1]));
+    });
+}
+
+template <typename Ops, int Channel>
+void channelRow(const std::uint8_t* rgb, std::uint8_t* gray, int width) {
+    constexpr GrayscaleMethod method = Channel == 0 ? GrayscaleMethod::RedChannel
+                                     : Channel == 1 ? GrayscaleMethod::GreenChannel
+                                                    : GrayscaleMethod::BlueChannel;
+    forEachBlock<Ops>(rgb, gray, width, method, [](const std::uint8_t* src, std::uint8_t* dst) {
+        Ops::store(dst, Ops::template loadChannel<Channel>(src));
+    });
+}
+
+template <typename Ops>
+GrayscaleRowKernel simdRowKernel(GrayscaleMethod method) {
+    switch (method) {
+        case GrayscaleMethod::Lightness: return lightnessRow<Ops>;
+        case GrayscaleMethod::Average: return averageRow<Ops>;
+        case GrayscaleMethod::Luminosity: return luminosityRow<Ops>;
+        case GrayscaleMethod::RootMeanSquare: return rootMeanSquareRow<Ops>;
+        case GrayscaleMethod::RedChannel: return channelRow<Ops, 0>;
+        case GrayscaleMethod::GreenChannel: return channelRow<Ops, 1>;
+        case GrayscaleMethod::BlueChannel: return channelRow<Ops, 2>;
+        default: return nullptr;
+    }
+}
+
+} // namespace
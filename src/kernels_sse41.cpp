@@ -0,0 +1,74 @@
+// SSE4.1 row kernels: 16 pixels per iteration. Compiled with -msse4.1 and
+// only called after detectSimdLevel() has confirmed CPU support.
+#include <immintrin.h>
+#include "kernels_simd.hpp"
+
+namespace {
+
+struct Sse41Ops {
+    using V = __m128i;
+    static constexpr int pixels = 16;
+
+    static V mask(int c, int k) {
+        return _mm_loadu_si128(reinterpret_cast<const __m128i*>(shuffleMasks.bytes[c][k]));
+    }
+
+    template <int C>
+    static V loadChannel(const std::uint8_t* src) {
+        V a0 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src));
+        V a1 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 16));
+        V a2 = _mm_loadu_si128(reinterpret_cast<const __m128i*>(src + 32));
+        return _mm_or_si128(_mm_or_si128(_mm_shuffle_epi8(a0, mask(C, 0)), _mm_shuffle_epi8(a1, mask(C, 1))),
+                            _mm_shuffle_epi8(a2, mask(C, 2)));
+    }
+
+    static void loadRgb(const std::uint8_t* src, V& r, V& g, V& b) {
+        r = loadChannel<0>(src);
+        g = loadChannel<1>(src);
+        b = loadChannel<2>(src);
+    }
+
+    static void store(std::uint8_t* dst, V v) { _mm_storeu_si128(reinterpret_cast<__m128i*>(dst), v); }
+
+    static V zero() { return _mm_setzero_si128(); }
+    static V set8(int v) { return _mm_set1_epi8(static_cast<char>(v)); }
+    static V set16(int v) { return _mm_set1_epi16(static_cast<short>(v)); }
+    static V set32(int v) { return _mm_set1_epi32(v); }
+
+    static V and_(V a, V b) { return _mm_and_si128(a, b); }
+    static V xor_(V a, V b) { return _mm_xor_si128(a, b); }
+    static V max8(V a, V b) { return _mm_max_epu8(a, b); }
+    static V min8(V a, V b) { return _mm_min_epu8(a, b); }
+    static V add8(V a, V b) { return _mm_add_epi8(a, b); }
+    static V add16(V a, V b) { return _mm_add_epi16(a, b); }
+    static V add32(V a, V b) { return _mm_add_epi32(a, b); }
+    static V sub32(V a, V b) { return _mm_sub_epi32(a, b); }
+    static V srli16(V a, int n) { return _mm_srli_epi16(a, n); }
+    static V mullo16(V a, V b) { return _mm_mullo_epi16(a, b); }
+    static V mulhi16(V a, V b) { return _mm_mulhi_epu16(a, b); }
+    static V mullo32(V a, V b) { return _mm_mullo_epi32(a, b); }
+    static V madd16(V a, V b) { return _mm_madd_epi16(a, b); }
+    static V cmpeq16(V a, V b) { return _mm_cmpeq_epi16(a, b); }
+    static V cmpgt32(V a, V b) { return _mm_cmpgt_epi32(a, b); }
+
+    static V unpacklo8(V a, V b) { return _mm_unpacklo_epi8(a, b); }
+    static V unpackhi8(V a, V b) { return _mm_unpackhi_epi8(a, b); }
+    static V unpacklo16(V a, V b) { return _mm_unpacklo_epi16(a, b); }
+    static V unpackhi16(V a, V b) { return _mm_unpackhi_epi16(a, b); }
+    static V packus16(V a, V b) { return _mm_packus_epi16(a, b); }
+    static V packs16(V a, V b) { return _mm_packs_epi16(a, b); }
+    static V packus32(V a, V b) { return _mm_packus_epi32(a, b); }
+    static std::uint64_t movemask8(V a) { return static_cast<std::uint32_t>(_mm_movemask_epi8(a)); }
+
+    static V sqrtDiv3Trunc(V s) {
+        __m128 f = _mm_mul_ps(_mm_cvtepi32_ps(s), _mm_set1_ps(1.0f / 3.0f));
+        return _mm_cvttps_epi32(_mm_sqrt_ps(f));
+    }
+};
+
+} // namespace
+
+
+GrayscaleRowKernel sse41RowKernel(GrayscaleMethod method) {
+    return simdRowKernel<Sse41Ops>(method);
+}
@@ -1,108 +1,1191 @@
+#include <cctype>
 #include <cmath>
 #include <iostream>
 #include <fstream>
 #include <vector>
 #include <array>
 #include <string>
+#include <string_view>
 #include <filesystem>
 #include <algorithm>
-#include "image_processing.cpp"
+#include <memory>
+#include <cstdint>
+#include <cstdlib>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include "alloc_counter.hpp"
+#include "archive.hpp"
+#include "image_processing.hpp"
+#include "io_ring.hpp"
+#include "manifest.hpp"
+#include "operators.hpp"
+#include "pipeline.hpp"
+#include "ppm_io.hpp"
+#include "server.hpp"
+#include "sharding.hpp"
+#include "stats.hpp"
+#include "streaming.hpp"
+#include "thread_pool.hpp"
 
 
 namespace fs = std::filesystem;
 
+#ifndef GRAYSCALE_VERSION
+#define GRAYSCALE_VERSION "unknown"
+#endif
 
-GrayscaleMethod stringToGrayscaleMethod(const std::string& method) {
-    if (method == "Lightness") return GrayscaleMethod::Lightness;
-    if (method == "Average") return GrayscaleMethod::Average;
-    if (method == "Luminosity") return GrayscaleMethod::Luminosity;
-    if (method == "RootMeanSquare") return GrayscaleMethod::RootMeanSquare;
-    if (method == "RedChannel") return GrayscaleMethod::RedChannel;
-    if (method == "GreenChannel") return GrayscaleMethod::GreenChannel;
-    if (method == "BlueChannel") return GrayscaleMethod::BlueChannel;
-    return GrayscaleMethod::Invalid;
+// name of the --incremental manifest inside the output folder
+const char* const manifestName = ".convert_grayscale_manifest";
+
+
+// Parses "all" or a comma-separated list of methods, each optionally followed
+// by operator stages ("Luminosity|stretch|threshold:128").
+bool stringToOperatorChains(const std::string& list, std::vector<OperatorChain>& chains,
+                            std::vector<std::string>& names) {
+    static const char* const allMethods[] = {
+        "Lightness", "Average", "Luminosity", "RootMeanSquare", "RedChannel", "GreenChannel", "BlueChannel"
+    };
+
+    if (list == "all") {
+        for (const char* name : allMethods) {
+            OperatorChain chain;
+            chain.method = stringToGrayscaleMethod(name);
+            chains.push_back(chain);
+            names.push_back(name);
+        }
+        return true;
+    }
+
+    std::size_t start = 0;
+    while (start <= list.size()) {
+        std::size_t end = std::min(list.find(',', start), list.size());
+        std::string name = list.substr(start, end - start);
+        OperatorChain chain;
+        std::string error;
+        if (!parseOperatorChain(name, chain, error)) {
+            std::cerr << error << "\n";
+            return false;
+        }
+        if (std::find(names.begin(), names.end(), name) == names.end()) {
+            chains.push_back(chain);
+            names.push_back(name);
+        }
+        start = end + 1;
+    }
+    return true;
 }
 
 
-bool readPPM(const std::string& filename, std::vector<std::vector<std::array<int, 3>>>& image, int& rows, int& cols) {
-    std::ifstream in(filename);
-    if (!in) return false;
+// Output folder of a chain when there are several: "Luminosity|threshold:128"
+// goes to "luminosity_threshold-128".
+std::string chainFolderName(const std::string& name) {
+    std::string folder = name;
+    for (char& c : folder) {
+        c = static_cast<char>(std::tolower(static_cast<unsigned char>(c)));
+        if (c == '|') c = '_';
+        else if (c == ':') c = '-';
+    }
+    return folder;
+}
 
-    std::string magic;
-    in >> magic;
-    if (magic != "P3") return false;
 
-    int maxVal;
-    in >> cols >> rows >> maxVal;
-    image.resize(rows, std::vector<std::array<int, 3>>(cols));
+bool stringToPnmEncoding(const std::string& format, PnmEncoding& encoding) {
+    if (format == "P2") encoding = PnmEncoding::Plain;
+    else if (format == "P5") encoding = PnmEncoding::Raw;
+    else return false;
+    return true;
+}
+
+
+// Methods to apply and where each result goes.
+struct ConversionSettings {
+    std::vector<GrayscaleMethod> methods;
+    // the methods with their operator stages, one per output
+    const FusedConversion* conversion = nullptr;
+    std::vector<fs::path> folders;
+    PnmEncoding outputEncoding = PnmEncoding::Plain;
+    bool streaming = false;
+    int bandRows = 64;
+    // shared by the per-image tasks and the row bands of large images
+    ThreadPool* pool = nullptr;
+    // null unless --stats was given; every measurement is skipped then
+    StatsCollector* stats = nullptr;
+    // --incremental: record of earlier runs, and the parameters that the
+    // outputs depend on (methods and output format)
+    Manifest* manifest = nullptr;
+    std::string parameters;
+    // .gpak input and output: inputs are entries of inputArchive, listed as
+    // <inputArchivePath>/<entry name>; outputs are added to outputArchive as
+    // <prefix of the method><input stem>.pgm
+    const ArchiveReader* inputArchive = nullptr;
+    fs::path inputArchivePath;
+    ArchiveWriter* outputArchive = nullptr;
+    fs::path outputArchivePath;
+    std::vector<std::string> archivePrefixes;
+    // --count-allocations: report the heap allocations of every image
+    bool countAllocations = false;
+    // --histogram: histograms of every output, collected per image
+    HistogramReport* histograms = nullptr;
+    // --thumbnails: "_1-2", "_w160", ... appended to the output stems, one
+    // per ThumbnailSpec of the conversion
+    std::vector<std::string> thumbnailSuffixes;
+};
+
+// Console lines produced for one image. They are printed in one piece so that
+// lines of concurrent conversions never interleave.
+struct ImageReport {
+    std::string out;
+    std::string err;
+};
+
+std::mutex consoleMutex;
+
+void printReport(const ImageReport& report) {
+    std::lock_guard<std::mutex> lock(consoleMutex);
+    std::cout << report.out << std::flush;
+    std::cerr << report.err << std::flush;
+}
+
+
+// One input image on its way through reading, conversion and writing.
+// Jobs are recycled through a JobPool: the decoded input, the gray images and
+// the strings keep their capacity from one image to the next.
+struct ImageJob {
+    fs::path input;
+    PpmInput colorImage;
+    std::vector<GrayImage> grayscaleImages;
+    std::vector<GrayHistogram> histograms;
+    // method m's thumbnail s at m * thumbnailSuffixes.size() + s
+    std::vector<GrayImage> thumbnails;
+    // --io-uring: the input file as read by the batch, and every output
+    // formatted in memory with its path, see jobOutput
+    std::vector<char> fileData;
+    std::vector<std::vector<char>> outputFiles;
+    std::vector<std::string> outputPaths;
+    ImageReport report;
+    ImageStats stats;
+    ManifestEntry manifestEntry;
+    // scratch for output paths
+    std::string path;
+    // position among the inputs, for the index order of an output archive
+    std::size_t slot = 0;
+    // heap allocations made on the threads that handled this image
+    std::uint64_t allocations = 0;
+    bool skipped = false;
+    bool ok = true;
+};
+
+
+// Free list of jobs shared by all workers. Once every worker has had a job
+// of the largest image size, converting an image allocates nothing.
+class JobPool {
+public:
+    std::unique_ptr<ImageJob> acquire() {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (!free_.empty()) {
+                std::unique_ptr<ImageJob> job = std::move(free_.back());
+                free_.pop_back();
+                return job;
+            }
+        }
+        return std::make_unique<ImageJob>();
+    }
+
+    // Resets everything but the capacity of the job's buffers.
+    void release(std::unique_ptr<ImageJob> job) {
+        job->colorImage.file.close();
+        job->colorImage.pixels = RgbView();
+        job->report.out.clear();
+        job->report.err.clear();
+        job->stats = ImageStats();
+        job->manifestEntry = ManifestEntry();
+        job->slot = 0;
+        job->allocations = 0;
+        job->skipped = false;
+        job->ok = true;
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(std::move(job));
+    }
 
-    for (int i = 0; i < rows; ++i)
-        for (int j = 0; j < cols; ++j)
-            in >> image[i][j][0] >> image[i][j][1] >> image[i][j][2];
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<ImageJob>> free_;
+};
 
+
+// <folder>/<input stem><suffix>.pgm, built in place in `path`
+void outputPath(const fs::path& input, const std::string& folder, std::string& path,
+                const std::string& suffix = std::string()) {
+    const std::string& name = input.native();
+    std::size_t start = name.find_last_of('/');
+    start = start == std::string::npos ? 0 : start + 1;
+    std::size_t dot = name.find_last_of('.');
+    std::size_t end = dot != std::string::npos && dot > start ? dot : name.size();
+
+    path = folder;
+    if (!path.empty() && path.back() != '/') path += '/';
+    path.append(name, start, end - start);
+    path += suffix;
+    path += ".pgm";
+}
+
+std::string outputPath(const fs::path& input, const fs::path& folder, const std::string& suffix = std::string()) {
+    std::string path;
+    outputPath(input, folder.native(), path, suffix);
+    return path;
+}
+
+
+// --incremental: true if every output of this input exists and was produced
+// from the same content with the same parameters and tool version. Files
+// whose size and mtime match the manifest are not read at all; a changed
+// mtime alone costs one hash of the file. Otherwise job.manifestEntry is left
+// describing the input as it is now, hashed before it is converted, so that a
+// file modified during the run is not recorded with the new contents.
+bool isUpToDate(ImageJob& job, const ConversionSettings& settings) {
+    std::error_code ec;
+    ManifestEntry& current = job.manifestEntry;
+    current.parameters = settings.parameters;
+    current.version = GRAYSCALE_VERSION;
+    current.size = fs::file_size(job.input, ec);
+    if (ec) return false;
+    auto mtime = fs::last_write_time(job.input, ec);
+    if (ec) return false;
+    current.mtime = std::chrono::duration_cast<std::chrono::nanoseconds>(mtime.time_since_epoch()).count();
+
+    ManifestEntry previous;
+    bool known = settings.manifest->find(job.input.filename().string(), previous) &&
+                 previous.version == current.version && previous.parameters == current.parameters &&
+                 previous.size == current.size;
+    for (std::size_t m = 0; known && m < settings.folders.size(); ++m) {
+        known = fs::exists(outputPath(job.input, settings.folders[m]), ec);
+        for (std::size_t t = 0; known && t < settings.thumbnailSuffixes.size(); ++t)
+            known = fs::exists(outputPath(job.input, settings.folders[m], settings.thumbnailSuffixes[t]), ec);
+    }
+    if (known && previous.mtime == current.mtime) {
+        current.hash = previous.hash;
+        return true;
+    }
+
+    if (!hashFile(job.input.string(), current.hash)) return false;
+    if (!known || current.hash != previous.hash) return false;
+    // touched but not modified: remember the new mtime
+    settings.manifest->update(job.input.filename().string(), current);
+    return true;
+}
+
+
+// Skips the job when --incremental finds its outputs up to date.
+bool skipUnchanged(ImageJob& job, const ConversionSettings& settings) {
+    if (!settings.manifest || !isUpToDate(job, settings)) return false;
+    job.skipped = true;
+    job.report.out += "Unchanged: " + job.input.string() + "\n";
     return true;
 }
 
 
-bool writePGM(const std::string& filename, const std::vector<std::vector<int>>& grayscaleImage) {
-    std::ofstream out(filename);
-    if (!out) return false;
+// Sum of the sizes of the files that exist, for the stats report.
+std::uint64_t totalFileSize(const std::vector<std::string>& paths) {
+    std::uint64_t bytes = 0;
+    for (const std::string& path : paths) {
+        std::error_code ec;
+        std::uintmax_t size = fs::file_size(path, ec);
+        if (!ec) bytes += size;
+    }
+    return bytes;
+}
+
+
+// Streaming variant of convertImage: the image is converted band by band so
+// memory use does not depend on its height. Partial outputs are removed on failure.
+void convertImageStreaming(ImageJob& job, const ConversionSettings& settings) {
+    AllocationScope allocations(job.allocations);
+    if (skipUnchanged(job, settings)) return;
+    std::string inputPath = job.input.string();
+    std::ifstream in(inputPath, std::ios::binary);
+    if (!in) {
+        job.report.err += "Failed to read " + inputPath + "\n";
+        job.ok = false;
+        return;
+    }
+
+    std::vector<std::string> outputPaths;
+    std::vector<std::ofstream> files;
+    std::vector<std::ostream*> outputs;
+    files.reserve(settings.methods.size());
+    for (std::size_t m = 0; m < settings.methods.size(); ++m) {
+        std::string path = outputPath(job.input, settings.folders[m]);
+        files.emplace_back(path, std::ios::binary);
+        if (!files.back()) {
+            job.report.err += "Failed to write " + path + "\n";
+            job.ok = false;
+            return;
+        }
+        outputPaths.push_back(path);
+        outputs.push_back(&files.back());
+    }
+
+    bool ok = convertPPMStream(in, settings.methods, outputs, settings.outputEncoding, settings.bandRows,
+                               settings.pool, settings.stats ? &job.stats : nullptr);
+    for (std::size_t m = 0; m < files.size(); ++m) {
+        files[m].close();
+        if (ok && files[m]) {
+            job.report.out += "Converted: " + inputPath + " -> " + outputPaths[m] + "\n";
+        } else {
+            std::error_code ec;
+            fs::remove(outputPaths[m], ec);
+        }
+    }
+    if (!ok) job.report.err += "Failed to convert " + inputPath + "\n";
+    job.ok = ok;
+
+    if (settings.stats) {
+        std::error_code ec;
+        std::uintmax_t size = fs::file_size(job.input, ec);
+        job.stats.inputBytes = ec ? 0 : size;
+        job.stats.outputBytes = totalFileSize(outputPaths);
+    }
+}
+
+
+// Archive inputs are views into the mapped archive, nothing is copied.
+void readArchiveImage(ImageJob& job, const ConversionSettings& settings) {
+    // job.input is <archive path>/<entry name>, see scanArchive
+    std::string_view name = job.input.native();
+    name.remove_prefix(std::min(name.size(), settings.inputArchivePath.native().size() + 1));
+    const ArchiveEntry* entry = settings.inputArchive->find(name);
+    if (!entry || entry->channels != 3) {
+        job.report.err += "Failed to read " + job.input.string() + "\n";
+        job.ok = false;
+        return;
+    }
+    job.colorImage.pixels = settings.inputArchive->rgb(*entry);
+    job.stats.inputBytes = entry->size;
+}
+
+// prefetch faults a mapped input in completely instead of on first access
+void readImage(ImageJob& job, const ConversionSettings& settings, bool prefetch = false) {
+    PhaseTimer timer(settings.stats != nullptr, job.stats.times.read);
+    AllocationScope allocations(job.allocations);
+    if (settings.inputArchive) {
+        readArchiveImage(job, settings);
+        return;
+    }
+    if (skipUnchanged(job, settings)) return;
+    const std::string& inputPath = job.input.native();
+    if (!openPPM(inputPath, job.colorImage, settings.pool)) {
+        job.report.err.append("Failed to read ").append(inputPath) += '\n';
+        job.ok = false;
+        return;
+    }
+    if (prefetch) job.colorImage.file.prefetch();
+    if (settings.stats) {
+        std::error_code ec;
+        std::uintmax_t size = fs::file_size(job.input, ec);
+        job.stats.inputBytes = ec ? 0 : size;
+    }
+}
+
+void convertJob(ImageJob& job, const ConversionSettings& settings) {
+    if (!job.ok || job.skipped) return;
+    PhaseTimer timer(settings.stats != nullptr, job.stats.times.convert);
+    AllocationScope allocations(job.allocations);
+    // job.histograms doubles as the storage of histogram-dependent stages
+    bool histograms = settings.histograms || settings.conversion->needsHistograms();
+    settings.conversion->convert(job.colorImage.pixels, job.grayscaleImages,
+                                 histograms ? &job.histograms : nullptr, settings.pool,
+                                 settings.thumbnailSuffixes.empty() ? nullptr : &job.thumbnails);
+    job.stats.pixels = static_cast<std::uint64_t>(job.colorImage.pixels.width) * job.colorImage.pixels.height;
+    // the mapping is no longer needed; a decoded copy is kept for the next image
+    job.colorImage.file.close();
+}
+
+// Outputs of one input: the image of every method, each followed by its
+// thumbnails.
+std::size_t outputsPerInput(const ConversionSettings& settings) {
+    return settings.methods.size() * (settings.thumbnailSuffixes.size() + 1);
+}
+
+// Output k of a job; `method` and `suffix` tell where it goes.
+const GrayImage& jobOutput(const ImageJob& job, const ConversionSettings& settings, std::size_t k,
+                           std::size_t& method, const std::string*& suffix) {
+    static const std::string noSuffix;
+    std::size_t thumbnails = settings.thumbnailSuffixes.size();
+    method = k / (thumbnails + 1);
+    std::size_t t = k % (thumbnails + 1);
+    suffix = t == 0 ? &noSuffix : &settings.thumbnailSuffixes[t - 1];
+    return t == 0 ? job.grayscaleImages[method] : job.thumbnails[method * thumbnails + t - 1];
+}
+
+void writeImages(ImageJob& job, const ConversionSettings& settings) {
+    if (!job.ok || job.skipped) return;
+    PhaseTimer timer(settings.stats != nullptr, job.stats.times.write);
+    AllocationScope allocations(job.allocations);
+    const std::string& inputPath = job.input.native();
+    for (std::size_t k = 0; k < outputsPerInput(settings); ++k) {
+        std::size_t m = 0;
+        const std::string* suffix = nullptr;
+        const GrayImage& image = jobOutput(job, settings, k, m, suffix);
+        if (settings.outputArchive) {
+            std::string& name = job.path;
+            outputPath(job.input, settings.archivePrefixes[m], name, *suffix);
+            const std::string& archive = settings.outputArchivePath.native();
+            if (!settings.outputArchive->add(job.slot * outputsPerInput(settings) + k, name, image.view())) {
+                job.report.err.append("Failed to write ").append(archive).append("/").append(name) += '\n';
+                job.ok = false;
+            } else {
+                job.report.out.append("Converted: ").append(inputPath).append(" -> ").append(archive)
+                    .append("/").append(name) += '\n';
+                job.stats.outputBytes += image.data.size();
+            }
+            continue;
+        }
+        std::string& path = job.path;
+        outputPath(job.input, settings.folders[m].native(), path, *suffix);
+        if (!writePGM(path, image, settings.outputEncoding)) {
+            job.report.err.append("Failed to write ").append(path) += '\n';
+            job.ok = false;
+        } else {
+            job.report.out.append("Converted: ").append(inputPath).append(" -> ").append(path) += '\n';
+            if (settings.stats) job.stats.outputBytes += totalFileSize({path});
+        }
+    }
+}
+
+
+// --io-uring: the input was read into job.fileData by its batch
+void parseJob(ImageJob& job, const ConversionSettings& settings) {
+    if (!job.ok || job.skipped) return;
+    PhaseTimer timer(settings.stats != nullptr, job.stats.times.read);
+    AllocationScope allocations(job.allocations);
+    if (!parsePPM(job.fileData.data(), job.fileData.size(), job.colorImage, settings.pool)) {
+        job.report.err.append("Failed to read ").append(job.input.native()) += '\n';
+        job.ok = false;
+    }
+    job.stats.inputBytes = job.fileData.size();
+}
+
+// --io-uring: formats every output into job.outputFiles, for its batch to write
+void formatOutputs(ImageJob& job, const ConversionSettings& settings) {
+    if (!job.ok || job.skipped) return;
+    PhaseTimer timer(settings.stats != nullptr, job.stats.times.write);
+    AllocationScope allocations(job.allocations);
+    std::size_t count = outputsPerInput(settings);
+    job.outputFiles.resize(count);
+    job.outputPaths.resize(count);
+    for (std::size_t k = 0; k < count; ++k) {
+        std::size_t m = 0;
+        const std::string* suffix = nullptr;
+        const GrayImage& image = jobOutput(job, settings, k, m, suffix);
+        outputPath(job.input, settings.folders[m].native(), job.outputPaths[k], *suffix);
+        formatPGM(image.view(), settings.outputEncoding, job.outputFiles[k]);
+    }
+}
+
+
+// Converts one input image with every requested method; job.ok is cleared if
+// the image could not be read or any output could not be written.
+void convertImage(ImageJob& job, const ConversionSettings& settings) {
+    if (settings.streaming) {
+        convertImageStreaming(job, settings);
+        return;
+    }
+    readImage(job, settings);
+    convertJob(job, settings);
+    writeImages(job, settings);
+}
+
+
+// Outcome counts of a run, updated from any thread.
+struct RunCounters {
+    std::atomic<int> failures{0};
+    std::atomic<int> skipped{0};
+};
+
+// Prints the console lines of a finished job and records its outcome. A
+// failed input is dropped from the manifest since its outputs may be partial.
+void finishImage(ImageJob& job, const ConversionSettings& settings, RunCounters& counters) {
+    if (!job.ok) counters.failures.fetch_add(1);
+    if (job.skipped) counters.skipped.fetch_add(1);
+    if (settings.countAllocations)
+        job.report.out += "Allocations: " + job.input.string() + " " + std::to_string(job.allocations) + "\n";
+    printReport(job.report);
+    if (settings.stats) {
+        job.stats.input = job.input.string();
+        job.stats.ok = job.ok;
+        job.stats.skipped = job.skipped;
+        settings.stats->add(job.stats);
+    }
+    if (settings.histograms && job.ok && !job.skipped)
+        settings.histograms->add(job.input.string(), job.histograms);
+    if (settings.manifest && !job.skipped) {
+        std::string name = job.input.filename().string();
+        if (job.ok)
+            settings.manifest->update(name, job.manifestEntry);
+        else
+            settings.manifest->remove(name);
+    }
+}
+
+
+using InputList = std::vector<std::pair<std::uintmax_t, fs::path>>;
+
+std::set<std::string> fileNames(const InputList& inputs) {
+    std::set<std::string> names;
+    for (const auto& input : inputs)
+        names.insert(input.second.filename().string());
+    return names;
+}
+
+// --incremental: reports outputs, thumbnails included, whose input has been
+// removed since they were produced; such entries are kept while any of their
+// outputs is left. Entries
+// of inputs that now belong to another shard are dropped, that shard's
+// manifest takes over.
+void pruneManifest(Manifest& manifest, const InputList& allInputs, const InputList& shardInputs,
+                   const ConversionSettings& settings) {
+    std::set<std::string> present = fileNames(allInputs);
+    std::set<std::string> mine = fileNames(shardInputs);
+
+    for (const std::string& name : manifest.inputs()) {
+        if (mine.count(name)) continue;
+        if (present.count(name)) {
+            manifest.remove(name);
+            continue;
+        }
+        bool leftover = false;
+        for (const fs::path& folder : settings.folders) {
+            for (std::size_t t = 0; t <= settings.thumbnailSuffixes.size(); ++t) {
+                std::string path = outputPath(name, folder, t == 0 ? std::string() : settings.thumbnailSuffixes[t - 1]);
+                std::error_code ec;
+                if (fs::exists(path, ec)) {
+                    std::cout << "Stale output (input removed): " << path << "\n";
+                    leftover = true;
+                }
+            }
+        }
+        if (!leftover) manifest.remove(name);
+    }
+}
+
+
+// The .ppm files of a folder with their sizes, largest first so that the
+// biggest images do not end up as the last tasks.
+InputList scanInputs(const std::string& folder) {
+    InputList inputs;
+    for (const auto& entry : fs::directory_iterator(folder)) {
+        if (entry.path().extension() == ".ppm") {
+            std::error_code ec;
+            std::uintmax_t size = entry.file_size(ec);
+            inputs.emplace_back(ec ? 0 : size, entry.path());
+        }
+    }
+    std::stable_sort(inputs.begin(), inputs.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+    return inputs;
+}
+
+
+// The RGB entries of an archive, largest first like scanInputs.
+InputList scanArchive(const ArchiveReader& archive, const fs::path& archivePath) {
+    InputList inputs;
+    for (const ArchiveEntry& entry : archive.entries())
+        if (entry.channels == 3) inputs.emplace_back(entry.size, archivePath / entry.name);
+    std::stable_sort(inputs.begin(), inputs.end(),
+                     [](const auto& a, const auto& b) { return a.first > b.first; });
+    return inputs;
+}
+
+
+// The inputs of one shard, keeping the largest-first order.
+InputList shardInputs(const InputList& inputs, int shardIndex, int shardCount) {
+    std::vector<std::pair<std::uint64_t, std::string>> files;
+    for (const auto& input : inputs)
+        files.emplace_back(input.first, input.second.filename().string());
+    std::vector<int> shards = assignShards(files, shardCount);
+
+    InputList mine;
+    for (std::size_t k = 0; k < inputs.size(); ++k)
+        if (shards[k] == shardIndex) mine.push_back(inputs[k]);
+    return mine;
+}
 
-    int rows = grayscaleImage.size();
-    int cols = grayscaleImage[0].size();
 
-    out << "P2\n" << cols << " " << rows << "\n255\n";
-    for (const auto& row : grayscaleImage) {
-        for (int val : row)
-            out << val << " ";
-        out << "\n";
+// --io-uring batches: at most this many inputs, and once past the first one
+// at most this many input bytes.
+constexpr std::size_t ioBatchFiles = 64;
+constexpr std::uint64_t ioBatchBytes = std::uint64_t(64) << 20;
+
+// --io-uring: the inputs go through in batches whose files are read, and
+// whose outputs are written, with one ring submission each. While the pool
+// parses, converts and formats batch k, the calling thread writes the
+// outputs of batch k - 1 and reads batch k + 1. Per-image read and write
+// times include an even share of their batch's I/O.
+void convertInBatches(const InputList& inputs, const ConversionSettings& settings, IoRing& ring,
+                      JobPool& jobPool, RunCounters& counters) {
+    ThreadPool& pool = *settings.pool;
+    std::vector<std::unique_ptr<ImageJob>> current;
+    std::vector<std::unique_ptr<ImageJob>> upcoming;
+    std::vector<ImageJob*> pending;
+    std::vector<FileRead> reads;
+    std::vector<FileWrite> writes;
+    std::size_t next = 0;
+
+    auto readBatch = [&](std::vector<std::unique_ptr<ImageJob>>& batch) {
+        std::uint64_t bytes = 0;
+        while (next < inputs.size() && batch.size() < ioBatchFiles && (batch.empty() || bytes < ioBatchBytes)) {
+            batch.push_back(jobPool.acquire());
+            batch.back()->input = inputs[next].second;
+            batch.back()->slot = next;
+            bytes += inputs[next].first;
+            ++next;
+        }
+        pending.clear();
+        reads.clear();
+        for (auto& job : batch) {
+            if (skipUnchanged(*job, settings)) continue;
+            pending.push_back(job.get());
+            FileRead read;
+            read.path = job->input.c_str();
+            read.data = &job->fileData;
+            reads.push_back(read);
+        }
+        double seconds = 0;
+        {
+            PhaseTimer timer(settings.stats != nullptr, seconds);
+            ring.readFiles(reads.data(), reads.size());
+        }
+        for (std::size_t r = 0; r < reads.size(); ++r) {
+            ImageJob& job = *pending[r];
+            job.stats.times.read += seconds / static_cast<double>(reads.size());
+            if (reads[r].ok) continue;
+            job.report.err.append("Failed to read ").append(job.input.native()) += '\n';
+            job.ok = false;
+        }
+    };
+
+    auto convertBatch = [&](std::vector<std::unique_ptr<ImageJob>>& batch) {
+        for (auto& job : batch) {
+            pool.submit([&settings, job = job.get()] {
+                parseJob(*job, settings);
+                convertJob(*job, settings);
+                formatOutputs(*job, settings);
+            });
+        }
+    };
+
+    auto writeBatch = [&](std::vector<std::unique_ptr<ImageJob>>& batch) {
+        pending.clear();
+        writes.clear();
+        for (auto& job : batch) {
+            if (!job->ok || job->skipped) continue;
+            pending.push_back(job.get());
+            for (std::size_t k = 0; k < job->outputFiles.size(); ++k) {
+                FileWrite write;
+                write.path = job->outputPaths[k].c_str();
+                write.data = job->outputFiles[k].data();
+                write.size = job->outputFiles[k].size();
+                writes.push_back(write);
+            }
+        }
+        double seconds = 0;
+        {
+            PhaseTimer timer(settings.stats != nullptr, seconds);
+            ring.writeFiles(writes.data(), writes.size());
+        }
+        const FileWrite* write = writes.data();
+        for (ImageJob* job : pending) {
+            job->stats.times.write += seconds / static_cast<double>(pending.size());
+            for (std::size_t k = 0; k < job->outputFiles.size(); ++k, ++write) {
+                if (!write->ok) {
+                    job->report.err.append("Failed to write ").append(write->path) += '\n';
+                    job->ok = false;
+                } else {
+                    job->report.out.append("Converted: ").append(job->input.native()).append(" -> ")
+                        .append(write->path) += '\n';
+                    job->stats.outputBytes += write->size;
+                }
+            }
+        }
+        for (auto& job : batch) {
+            finishImage(*job, settings, counters);
+            jobPool.release(std::move(job));
+        }
+        batch.clear();
+    };
+
+    readBatch(current);
+    convertBatch(current);
+    while (!current.empty()) {
+        readBatch(upcoming);
+        pool.wait();
+        convertBatch(upcoming);
+        writeBatch(current);
+        current.swap(upcoming);
     }
+}
+
+
+// Default shard of a Slurm array task: SLURM_ARRAY_TASK_ID counted from
+// SLURM_ARRAY_TASK_MIN, out of SLURM_ARRAY_TASK_COUNT. Returns false outside
+// a job array.
+bool slurmArrayShard(int& index, int& count) {
+    const char* id = std::getenv("SLURM_ARRAY_TASK_ID");
+    const char* tasks = std::getenv("SLURM_ARRAY_TASK_COUNT");
+    if (!id || !tasks) return false;
+    const char* min = std::getenv("SLURM_ARRAY_TASK_MIN");
+    index = std::atoi(id) - (min ? std::atoi(min) : 0);
+    count = std::atoi(tasks);
     return true;
 }
 
 
+// --merge-summaries: adds up the shard summaries of an output folder.
+// Succeeds only if every shard has reported and none had failures.
+int mergeSummaries(const std::string& folder) {
+    ShardSummary total;
+    std::vector<int> missing;
+    if (!mergeShardSummaries(folder, total, missing)) {
+        std::cerr << "No consistent shard summaries in " << folder << "\n";
+        return 1;
+    }
+
+    std::cout << "shards " << total.count - missing.size() << "/" << total.count << "\n"
+              << "images " << total.images << "\n"
+              << "failed " << total.failed << "\n"
+              << "skipped " << total.skipped << "\n"
+              << "input_bytes " << total.inputBytes << "\n"
+              << "slowest_shard_seconds " << total.wallSeconds << "\n";
+    for (int index : missing)
+        std::cerr << "Missing summary of shard " << index << "\n";
+    return missing.empty() && total.failed == 0 ? 0 : 1;
+}
+
+
+void printUsage() {
+    std::cerr << "Usage: ./convert_grayscale <input_folder> <output_folder> <grayscale_methods> [options]\n"
+              << "       ./convert_grayscale --merge-summaries <output_folder>\n"
+              << "       ./convert_grayscale --serve <socket|-> [--threads N]\n"
+              << "       ./convert_grayscale --client <socket> [<method> <input.ppm> <output.pgm> [P2|P5]]\n"
+              << "  <grayscale_methods> is a method name, a comma-separated list of methods or 'all'.\n"
+              << "  A method may be followed by operators applied in the same pass over the pixels,\n"
+              << "  e.g. 'Luminosity|stretch|threshold:128' (quote it in the shell):\n"
+              << "    stretch[:P]    map the value range onto 0-255, clipping P percent at each end\n"
+              << "    threshold[:T]  255 for values >= T, 0 otherwise; Otsu's level without T\n"
+              << "    invert         255 - value\n"
+              << "  With more than one method, each output goes to <output_folder>/<method in lowercase>,\n"
+              << "  with '|' and ':' of operator chains replaced by '_' and '-'.\n"
+              << "  Either folder may be a .gpak archive (see grayscale_pack): inputs are then read from\n"
+              << "  the mapped archive and outputs added to one archive as raw gray images, under\n"
+              << "  <method in lowercase>/ with more than one method.\n"
+              << "Options:\n"
+              << "  --output-format P2|P5   PGM encoding of the output files (default: P2)\n"
+              << "  --threads N             worker threads for images and bands of large images (default: hardware concurrency)\n"
+              << "  --stream                convert band by band with memory bounded by the image width\n"
+              << "  --band-rows N           rows per band in --stream mode (default: 64)\n"
+              << "  --pipeline              overlap reading, converting and writing in separate stages\n"
+              << "  --io-threads N          reader and writer threads each in --pipeline mode (default: 1)\n"
+              << "  --queue-depth N         images queued between --pipeline stages (default: 4)\n"
+              << "  --io-uring              read inputs and write outputs in batches of up to 64 files through\n"
+              << "                          io_uring (Linux 5.6+), with blocking I/O where it is unavailable\n"
+              << "  --incremental           skip inputs whose outputs are up to date, tracked in\n"
+              << "                          <output_folder>/" << manifestName << "\n"
+              << "  --shard-index I         convert only shard I of the inputs (default: $SLURM_ARRAY_TASK_ID)\n"
+              << "  --shard-count N         number of shards, balanced by file size (default: $SLURM_ARRAY_TASK_COUNT)\n"
+              << "                          each shard writes <output_folder>/shard-I-of-N.summary\n"
+              << "  --stats FILE            write per-image and total timings, sizes and peak memory\n"
+              << "                          as JSON, or as CSV when FILE ends in .csv\n"
+              << "  --histogram FILE        write the 256-bin histogram of every output as JSON\n"
+              << "  --thumbnails LIST       also write downscaled copies of every output, built in the same\n"
+              << "                          pass: 1/2, 1/4, ... 1/64 or w<width>, e.g. 1/4,w160; written\n"
+              << "                          next to the output as <stem>_1-4.pgm, <stem>_w160.pgm\n"
+              << "  --count-allocations     print the heap allocations made for each image (debugging);\n"
+              << "                          buffers are reused, so this drops to 0 once warmed up; needs a\n"
+              << "                          build configured with -DGRAYSCALE_COUNT_ALLOCATIONS=ON\n"
+              << "--serve keeps one process and its thread pool alive across conversions. Requests are\n"
+              << "tab-separated lines, answered in order with \"ok<TAB>output\" or \"error<TAB>message\":\n"
+              << "  convert<TAB>method<TAB>input.ppm<TAB>output.pgm[<TAB>P2|P5]\n"
+              << "  inline<TAB>method<TAB>byte count<TAB>output.pgm[<TAB>P2|P5], then the PPM bytes (at most 1 GiB)\n"
+              << "  ping, shutdown\n"
+              << "--client without a request forwards the requests read from stdin.\n";
+}
+
+
+// --serve <socket|->: converts requests (see server.hpp) with a pool kept
+// warm across them, from a Unix domain socket or from stdin to stdout.
+int runServer(int argc, char* argv[]) {
+    unsigned threads = std::thread::hardware_concurrency();
+    for (int i = 3; i < argc; ++i) {
+        std::string option = argv[i];
+        char* end = nullptr;
+        long value = i + 1 < argc ? std::strtol(argv[i + 1], &end, 10) : 0;
+        if (option != "--threads" || i + 1 >= argc || *end != '\0' || value < 1) {
+            std::cerr << "Invalid --serve option: " << option << "\n";
+            return 1;
+        }
+        threads = static_cast<unsigned>(value);
+        ++i;
+    }
+
+    ThreadPool pool(threads);
+    std::string socketPath = argv[2];
+    if (socketPath == "-") {
+        serveConnection(0, 1, pool);
+        return 0;
+    }
+    if (!serveUnixSocket(socketPath, pool)) {
+        std::cerr << "Failed to listen on " << socketPath << "\n";
+        return 1;
+    }
+    return 0;
+}
+
+
+// --client <socket> [<method> <input> <output> [P2|P5]]: submits one convert
+// request, or the requests read from stdin, and prints the responses.
+int runClientCommand(int argc, char* argv[]) {
+    std::string socketPath = argv[2];
+    bool ok;
+    if (argc == 3) {
+        ok = runClient(socketPath, 0, 1);
+    } else if (argc == 6 || argc == 7) {
+        std::string request = std::string("convert\t") + argv[3] + "\t" + argv[4] + "\t" + argv[5];
+        if (argc == 7) request += std::string("\t") + argv[6];
+        ok = runClient(socketPath, request + "\n", 1);
+    } else {
+        printUsage();
+        return 1;
+    }
+    if (!ok) std::cerr << "Request to " << socketPath << " failed\n";
+    return ok ? 0 : 1;
+}
+
+
 int main(int argc, char* argv[]) {
+    if (argc == 3 && std::string(argv[1]) == "--merge-summaries")
+        return mergeSummaries(argv[2]);
+    if (argc >= 3 && std::string(argv[1]) == "--serve")
+        return runServer(argc, argv);
+    if (argc >= 3 && std::string(argv[1]) == "--client")
+        return runClientCommand(argc, argv);
     if (argc < 4) {
-        std::cerr << "Usage: ./convert_grayscale <input_folder> <output_folder> <grayscale_method>\n";
+        printUsage();
         return 1;
     }
 
     std::string inputFolder = argv[1];
     std::string outputFolder = argv[2];
     std::string methodString = argv[3];
+    ConversionSettings settings;
+    unsigned threads = std::thread::hardware_concurrency();
+    bool pipelined = false;
+    bool ioUring = false;
+    PipelineOptions pipelineOptions;
+    std::string statsFile;
+    std::string histogramFile;
+    std::vector<ThumbnailSpec> thumbnails;
+    bool incremental = false;
+    int shardIndex = 0;
+    int shardCount = 1;
+    bool sharded = slurmArrayShard(shardIndex, shardCount);
 
-    GrayscaleMethod method = stringToGrayscaleMethod(methodString);
-    if (method == GrayscaleMethod::Invalid) {
-        std::cerr << "Invalid grayscale method: " << methodString << "\n";
-        std::cerr << "Valid methods are: Lightness, Average, Luminosity, Desaturation, RedChannel, GreenChannel, BlueChannel\n";
+    for (int i = 4; i < argc; ++i) {
+        std::string option = argv[i];
+        if (option == "--output-format" && i + 1 < argc) {
+            if (!stringToPnmEncoding(argv[++i], settings.outputEncoding)) {
+                std::cerr << "Invalid output format: " << argv[i] << " (expected P2 or P5)\n";
+                return 1;
+            }
+        } else if (option == "--threads" && i + 1 < argc) {
+            char* end = nullptr;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 1) {
+                std::cerr << "Invalid thread count: " << argv[i] << "\n";
+                return 1;
+            }
+            threads = static_cast<unsigned>(value);
+        } else if (option == "--stream") {
+            settings.streaming = true;
+        } else if (option == "--band-rows" && i + 1 < argc) {
+            char* end = nullptr;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 1 || value > 1 << 20) {
+                std::cerr << "Invalid band size: " << argv[i] << "\n";
+                return 1;
+            }
+            settings.bandRows = static_cast<int>(value);
+        } else if ((option == "--shard-index" || option == "--shard-count") && i + 1 < argc) {
+            char* end = nullptr;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 0 || value > 1 << 20) {
+                std::cerr << "Invalid value for " << option << ": " << argv[i] << "\n";
+                return 1;
+            }
+            (option == "--shard-index" ? shardIndex : shardCount) = static_cast<int>(value);
+            sharded = true;
+        } else if (option == "--incremental") {
+            incremental = true;
+        } else if (option == "--count-allocations") {
+#ifndef GRAYSCALE_COUNT_ALLOCATIONS
+            std::cerr << "--count-allocations needs a build configured with -DGRAYSCALE_COUNT_ALLOCATIONS=ON\n";
+            return 1;
+#endif
+            settings.countAllocations = true;
+        } else if (option == "--stats" && i + 1 < argc) {
+            statsFile = argv[++i];
+        } else if (option == "--histogram" && i + 1 < argc) {
+            histogramFile = argv[++i];
+        } else if (option == "--thumbnails" && i + 1 < argc) {
+            std::string error;
+            if (!parseThumbnailSpecs(argv[++i], thumbnails, error)) {
+                std::cerr << error << "\n";
+                return 1;
+            }
+        } else if (option == "--pipeline") {
+            pipelined = true;
+        } else if (option == "--io-uring") {
+            ioUring = true;
+        } else if ((option == "--io-threads" || option == "--queue-depth") && i + 1 < argc) {
+            char* end = nullptr;
+            long value = std::strtol(argv[++i], &end, 10);
+            if (*end != '\0' || value < 1 || value > 1024) {
+                std::cerr << "Invalid value for " << option << ": " << argv[i] << "\n";
+                return 1;
+            }
+            if (option == "--io-threads")
+                pipelineOptions.readers = pipelineOptions.writers = static_cast<unsigned>(value);
+            else
+                pipelineOptions.queueDepth = static_cast<std::size_t>(value);
+        } else {
+            std::cerr << "Unknown option: " << option << "\n";
+            printUsage();
+            return 1;
+        }
+    }
+
+    if (shardCount < 1 || shardIndex < 0 || shardIndex >= shardCount) {
+        std::cerr << "Invalid shard " << shardIndex << " of " << shardCount << "\n";
         return 1;
     }
 
-    fs::create_directories(outputFolder);
+    if (pipelined && settings.streaming) {
+        std::cerr << "--pipeline cannot be combined with --stream\n";
+        return 1;
+    }
 
-    for (const auto& entry : fs::directory_iterator(inputFolder)) {
-        if (entry.path().extension() == ".ppm") {
-            std::vector<std::vector<std::array<int, 3>>> colorImage;
-            std::vector<std::vector<int>> grayscaleImage;
-            int rows = 0, cols = 0;
-
-            std::string inputPath = entry.path().string();
-            if (!readPPM(inputPath, colorImage, rows, cols)) {
-                std::cerr << "Failed to read " << inputPath << "\n";
-                continue;
-            }
+    bool archiveInput = isArchivePath(inputFolder);
+    bool archiveOutput = isArchivePath(outputFolder);
+    if (ioUring && (pipelined || settings.streaming || archiveInput || archiveOutput)) {
+        std::cerr << "--io-uring cannot be combined with --pipeline, --stream or .gpak archives\n";
+        return 1;
+    }
+    // without io_uring the default pool mode does the same work with blocking I/O
+    IoRing ring;
+    if (ioUring && !ring.open(128)) {
+        std::cerr << "io_uring is unavailable, using blocking I/O\n";
+        ioUring = false;
+    }
+    if ((archiveInput || archiveOutput) && (settings.streaming || incremental)) {
+        std::cerr << "--stream and --incremental cannot be used with .gpak archives\n";
+        return 1;
+    }
+
+    std::vector<OperatorChain> chains;
+    std::vector<std::string> methodNames;
+    if (!stringToOperatorChains(methodString, chains, methodNames)) {
+        std::cerr << "Valid methods are: Lightness, Average, Luminosity, RootMeanSquare, RedChannel, GreenChannel, BlueChannel (or 'all')\n"
+                  << "Valid operators are: stretch[:percent], threshold[:level], invert\n";
+        return 1;
+    }
+    FusedConversion conversion(chains, thumbnails);
+    settings.conversion = &conversion;
+    settings.methods = conversion.methods();
+    for (const ThumbnailSpec& spec : thumbnails)
+        settings.thumbnailSuffixes.push_back("_" + spec.suffix());
+    if (settings.streaming && (!conversion.trivial() || !histogramFile.empty() || !thumbnails.empty())) {
+        std::cerr << "--stream cannot be combined with operator stages, --histogram or --thumbnails\n";
+        return 1;
+    }
 
-            convertToGrayscale(colorImage, rows, cols, method, grayscaleImage);
+    // sharded runs write one archive per shard, and their summaries next to it
+    fs::path summaryFolder = outputFolder;
+    if (archiveOutput) {
+        settings.outputArchivePath = outputFolder;
+        if (shardCount > 1)
+            settings.outputArchivePath.replace_filename(settings.outputArchivePath.stem().string() + "-shard-" +
+                                                        std::to_string(shardIndex) + "-of-" +
+                                                        std::to_string(shardCount) + ".gpak");
+        summaryFolder = settings.outputArchivePath.parent_path();
+        if (!summaryFolder.empty()) fs::create_directories(summaryFolder);
+        else summaryFolder = ".";
+    }
 
-            std::string outputPath = fs::path(outputFolder) / entry.path().stem();
-            outputPath += ".pgm";
-            if (!writePGM(outputPath, grayscaleImage)) {
-                std::cerr << "Failed to write " << outputPath << "\n";
-            } else {
-                std::cout << "Converted: " << inputPath << " -> " << outputPath << "\n";
-            }
+    for (const std::string& name : methodNames) {
+        fs::path folder = outputFolder;
+        std::string prefix;
+        if (settings.methods.size() > 1) {
+            std::string lower = chainFolderName(name);
+            folder /= lower;
+            prefix = lower + "/";
+        }
+        if (!archiveOutput) fs::create_directories(folder);
+        settings.folders.push_back(folder);
+        settings.archivePrefixes.push_back(prefix);
+    }
+
+    ArchiveReader inputArchive;
+    if (archiveInput) {
+        if (!inputArchive.open(inputFolder)) {
+            std::cerr << "Failed to read " << inputFolder << "\n";
+            return 1;
+        }
+        settings.inputArchive = &inputArchive;
+        settings.inputArchivePath = inputFolder;
+    }
+
+    HistogramReport histograms;
+    if (!histogramFile.empty()) {
+        settings.histograms = &histograms;
+        histograms.methods = methodNames;
+    }
+
+    StatsCollector stats;
+    if (!statsFile.empty()) {
+        settings.stats = &stats;
+        stats.mode = settings.streaming ? "stream" : pipelined ? "pipeline" : ioUring ? "io_uring" : "pool";
+        stats.threads = threads;
+        stats.methods = methodNames;
+    }
+    auto start = std::chrono::steady_clock::now();
+
+    InputList allInputs;
+    InputList inputs;
+    {
+        PhaseTimer scanTimer(settings.stats != nullptr, stats.scanSeconds);
+        allInputs = archiveInput ? scanArchive(inputArchive, inputFolder) : scanInputs(inputFolder);
+        inputs = shardCount > 1 ? shardInputs(allInputs, shardIndex, shardCount) : allInputs;
+    }
+
+    Manifest manifest;
+    // shards keep separate manifests so that concurrent tasks never share one
+    std::string manifestPath = (fs::path(outputFolder) / manifestName).string();
+    if (shardCount > 1) manifestPath += "-shard-" + std::to_string(shardIndex) + "-of-" + std::to_string(shardCount);
+    if (incremental) {
+        if (!manifest.load(manifestPath)) {
+            std::cerr << "Failed to read " << manifestPath << "\n";
+            return 1;
+        }
+        settings.manifest = &manifest;
+        for (const std::string& name : methodNames)
+            settings.parameters += (settings.parameters.empty() ? "" : ",") + name;
+        settings.parameters += settings.outputEncoding == PnmEncoding::Raw ? ";P5" : ";P2";
+        for (const ThumbnailSpec& spec : thumbnails)
+            settings.parameters += ";" + spec.suffix();
+        pruneManifest(manifest, allInputs, inputs, settings);
+    }
+
+    ArchiveWriter outputArchive;
+    if (archiveOutput) {
+        std::size_t outputs = inputs.size() * settings.methods.size() * (thumbnails.size() + 1);
+        if (!outputArchive.create(settings.outputArchivePath.string(), outputs)) {
+            std::cerr << "Failed to write " << settings.outputArchivePath.string() << "\n";
+            return 1;
+        }
+        settings.outputArchive = &outputArchive;
+    }
+
+    RunCounters counters;
+    JobPool jobPool;
+    if (pipelined) {
+        // one converter per thread; readers fault the whole file in so that
+        // the converters never wait on the disk
+        pipelineOptions.converters = threads;
+        // jobs are taken from the pool by the readers and returned by the writers
+        std::vector<std::unique_ptr<ImageJob>> jobs(inputs.size());
+
+        runPipeline(jobs.size(), pipelineOptions,
+            [&](std::size_t k) {
+                jobs[k] = jobPool.acquire();
+                jobs[k]->input = inputs[k].second;
+                jobs[k]->slot = k;
+                readImage(*jobs[k], settings, true);
+            },
+            [&](std::size_t k) { convertJob(*jobs[k], settings); },
+            [&](std::size_t k) {
+                writeImages(*jobs[k], settings);
+                finishImage(*jobs[k], settings, counters);
+                jobPool.release(std::move(jobs[k]));
+            });
+    } else if (ioUring) {
+        ThreadPool pool(threads);
+        settings.pool = &pool;
+        convertInBatches(inputs, settings, ring, jobPool, counters);
+    } else {
+        // even a single input uses every thread: large images are split into row bands
+        ThreadPool pool(threads);
+        settings.pool = &pool;
+        for (std::size_t k = 0; k < inputs.size(); ++k) {
+            const fs::path& path = inputs[k].second;
+            pool.submit([&settings, &counters, &jobPool, &path, k] {
+                std::unique_ptr<ImageJob> job = jobPool.acquire();
+                job->input = path;
+                job->slot = k;
+                convertImage(*job, settings);
+                finishImage(*job, settings, counters);
+                jobPool.release(std::move(job));
+            });
+        }
+        pool.wait();
+    }
+
+    if (archiveOutput && !outputArchive.finish()) {
+        std::cerr << "Failed to write " << settings.outputArchivePath.string() << "\n";
+        return 1;
+    }
+
+    if (incremental && !manifest.save(manifestPath)) {
+        std::cerr << "Failed to write " << manifestPath << "\n";
+        return 1;
+    }
+
+    double wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    if (sharded) {
+        ShardSummary summary;
+        summary.index = shardIndex;
+        summary.count = shardCount;
+        summary.images = inputs.size();
+        summary.failed = static_cast<std::size_t>(counters.failures.load());
+        summary.skipped = static_cast<std::size_t>(counters.skipped.load());
+        for (const auto& input : inputs)
+            summary.inputBytes += input.first;
+        summary.wallSeconds = wallSeconds;
+        std::string summaryPath = (summaryFolder / shardSummaryName(shardIndex, shardCount)).string();
+        if (!writeShardSummary(summaryPath, summary)) {
+            std::cerr << "Failed to write " << summaryPath << "\n";
+            return 1;
+        }
+    }
+
+    if (settings.histograms && !histograms.write(histogramFile)) {
+        std::cerr << "Failed to write " << histogramFile << "\n";
+        return 1;
+    }
+
+    if (settings.stats) {
+        stats.wallSeconds = wallSeconds;
+        if (!stats.write(statsFile)) {
+            std::cerr << "Failed to write " << statsFile << "\n";
+            return 1;
         }
     }
 
+    if (counters.failures.load() != 0) {
+        std::cerr << counters.failures.load() << " image(s) failed to convert\n";
+        return 1;
+    }
     return 0;
 }
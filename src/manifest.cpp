@@ -0,0 +1,180 @@
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include "manifest.hpp"
+#include "mapped_file.hpp"
+
+
+namespace {
+
+const char* const manifestHeader = "# convert_grayscale manifest v1";
+
+constexpr std::uint64_t prime1 = 0x9E3779B185EBCA87ULL;
+constexpr std::uint64_t prime2 = 0xC2B2AE3D27D4EB4FULL;
+constexpr std::uint64_t prime3 = 0x165667B19E3779F9ULL;
+constexpr std::uint64_t prime4 = 0x85EBCA77C2B2AE63ULL;
+constexpr std::uint64_t prime5 = 0x27D4EB2F165667C5ULL;
+
+inline std::uint64_t rotl(std::uint64_t x, int r) {
+    return (x << r) | (x >> (64 - r));
+}
+
+// little-endian loads, so the hash does not depend on the host byte order
+inline std::uint64_t load64(const char* p) {
+    std::uint64_t v = 0;
+    for (int k = 7; k >= 0; --k)
+        v = (v << 8) | static_cast<unsigned char>(p[k]);
+    return v;
+}
+
+inline std::uint32_t load32(const char* p) {
+    std::uint32_t v = 0;
+    for (int k = 3; k >= 0; --k)
+        v = (v << 8) | static_cast<unsigned char>(p[k]);
+    return v;
+}
+
+inline std::uint64_t round(std::uint64_t acc, std::uint64_t input) {
+    return rotl(acc + input * prime2, 31) * prime1;
+}
+
+inline std::uint64_t mergeRound(std::uint64_t acc, std::uint64_t lane) {
+    return (acc ^ round(0, lane)) * prime1 + prime4;
+}
+
+} // namespace
+
+
+std::uint64_t contentHash(const char* data, std::size_t size) {
+    const char* p = data;
+    const char* end = data + size;
+    std::uint64_t h;
+
+    if (size >= 32) {
+        // four independent lanes over 32-byte stripes
+        std::uint64_t v1 = prime1 + prime2, v2 = prime2, v3 = 0, v4 = 0 - prime1;
+        for (; end - p >= 32; p += 32) {
+            v1 = round(v1, load64(p));
+            v2 = round(v2, load64(p + 8));
+            v3 = round(v3, load64(p + 16));
+            v4 = round(v4, load64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = mergeRound(h, v1);
+        h = mergeRound(h, v2);
+        h = mergeRound(h, v3);
+        h = mergeRound(h, v4);
+    } else {
+        h = prime5;
+    }
+    h += size;
+
+    for (; end - p >= 8; p += 8)
+        h = rotl(h ^ round(0, load64(p)), 27) * prime1 + prime4;
+    if (end - p >= 4) {
+        h = rotl(h ^ (load32(p) * prime1), 23) * prime2 + prime3;
+        p += 4;
+    }
+    for (; p < end; ++p)
+        h = rotl(h ^ (static_cast<unsigned char>(*p) * prime5), 11) * prime1;
+
+    h ^= h >> 33;
+    h *= prime2;
+    h ^= h >> 29;
+    h *= prime3;
+    h ^= h >> 32;
+    return h;
+}
+
+
+bool hashFile(const std::string& filename, std::uint64_t& hash) {
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    hash = contentHash(file.data(), file.size());
+    return true;
+}
+
+
+bool Manifest::load(const std::string& filename) {
+    std::ifstream in(filename);
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.clear();
+    if (!in) return true;
+
+    std::string line;
+    if (!std::getline(in, line) || line != manifestHeader) return false;
+    // version \t parameters \t size \t mtime \t hash \t input (the rest of the line)
+    while (std::getline(in, line)) {
+        if (line.empty()) continue;
+        std::string fields[6];
+        std::size_t start = 0;
+        for (int f = 0; f < 5; ++f) {
+            std::size_t tab = line.find('\t', start);
+            if (tab == std::string::npos) return false;
+            fields[f] = line.substr(start, tab - start);
+            start = tab + 1;
+        }
+        fields[5] = line.substr(start);
+
+        ManifestEntry entry;
+        entry.version = fields[0];
+        entry.parameters = fields[1];
+        std::istringstream numbers(fields[2] + " " + fields[3] + " " + fields[4]);
+        numbers >> entry.size >> entry.mtime >> std::hex >> entry.hash;
+        if (!numbers || fields[5].empty()) return false;
+        entries_[fields[5]] = entry;
+    }
+    return true;
+}
+
+
+bool Manifest::save(const std::string& filename) const {
+    std::string temporary = filename + ".tmp";
+    {
+        std::ofstream out(temporary);
+        if (!out) return false;
+        out << manifestHeader << "\n";
+        std::lock_guard<std::mutex> lock(mutex_);
+        for (const auto& item : entries_) {
+            const ManifestEntry& entry = item.second;
+            char hash[17];
+            std::snprintf(hash, sizeof(hash), "%016llx", static_cast<unsigned long long>(entry.hash));
+            out << entry.version << "\t" << entry.parameters << "\t" << entry.size << "\t" << entry.mtime
+                << "\t" << hash << "\t" << item.first << "\n";
+        }
+        out.close();
+        if (!out) return false;
+    }
+    return std::rename(temporary.c_str(), filename.c_str()) == 0;
+}
+
+
+bool Manifest::find(const std::string& input, ManifestEntry& entry) const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    auto it = entries_.find(input);
+    if (it == entries_.end()) return false;
+    entry = it->second;
+    return true;
+}
+
+
+void Manifest::update(const std::string& input, const ManifestEntry& entry) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_[input] = entry;
+}
+
+
+void Manifest::remove(const std::string& input) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    entries_.erase(input);
+}
+
+
+std::vector<std::string> Manifest::inputs() const {
+    std::lock_guard<std::mutex> lock(mutex_);
+    std::vector<std::string> names;
+    for (const auto& item : entries_)
+        names.push_back(item.first);
+    return names;
+}
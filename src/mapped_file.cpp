@@ -0,0 +1,84 @@
+#include <fstream>
+#include "mapped_file.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#define MAPPED_FILE_HAS_MMAP 1
+#endif
+
+
+MappedFile::~MappedFile() {
+    close();
+}
+
+
+bool MappedFile::open(const std::string& filename, bool allowMap) {
+    close();
+
+#ifdef MAPPED_FILE_HAS_MMAP
+    if (allowMap) {
+        int fd = ::open(filename.c_str(), O_RDONLY);
+        if (fd < 0) return false;
+
+        struct stat st;
+        if (fstat(fd, &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0) {
+            void* addr = mmap(nullptr, static_cast<std::size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+            if (addr != MAP_FAILED) {
+                ::close(fd);
+                madvise(addr, static_cast<std::size_t>(st.st_size), MADV_SEQUENTIAL);
+                data_ = static_cast<const char*>(addr);
+                size_ = static_cast<std::size_t>(st.st_size);
+                mapped_ = true;
+                return true;
+            }
+        }
+        ::close(fd);
+    }
+#endif
+
+    std::ifstream in(filename, std::ios::binary);
+    if (!in) return false;
+    const std::size_t chunk = 1 << 20;
+    std::size_t used = 0;
+    while (in) {
+        buffer_.resize(used + chunk);
+        in.read(buffer_.data() + used, static_cast<std::streamsize>(chunk));
+        used += static_cast<std::size_t>(in.gcount());
+    }
+    if (in.bad()) {
+        buffer_.clear();
+        return false;
+    }
+    buffer_.resize(used);
+    data_ = buffer_.data();
+    size_ = buffer_.size();
+    return true;
+}
+
+
+void MappedFile::prefetch() const {
+#ifdef MAPPED_FILE_HAS_MMAP
+    if (!mapped_) return;
+    madvise(const_cast<char*>(data_), size_, MADV_WILLNEED);
+    const std::size_t page = static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+    volatile char sink = 0;
+    for (std::size_t offset = 0; offset < size_; offset += page)
+        sink = sink + data_[offset];
+#endif
+}
+
+
+void MappedFile::close() {
+#ifdef MAPPED_FILE_HAS_MMAP
+    if (mapped_)
+        munmap(const_cast<char*>(data_), size_);
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    mapped_ = false;
+    buffer_.clear();
+    buffer_.shrink_to_fit();
+}
@@ -0,0 +1,379 @@
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <mutex>
+#include "operators.hpp"
+#include "json.hpp"
+#include "thread_pool.hpp"
+
+
+namespace {
+
+// Otsu's method: the level that maximizes the between-class variance of the
+// values below and at or above it.
+int otsuLevel(const GrayHistogram& histogram) {
+    double total = 0;
+    double sum = 0;
+    for (int v = 0; v < 256; ++v) {
+        total += static_cast<double>(histogram[v]);
+        sum += static_cast<double>(v) * static_cast<double>(histogram[v]);
+    }
+
+    double below = 0;
+    double belowSum = 0;
+    double best = -1;
+    int level = 128;
+    for (int v = 0; v < 255; ++v) {
+        below += static_cast<double>(histogram[v]);
+        belowSum += static_cast<double>(v) * static_cast<double>(histogram[v]);
+        double above = total - below;
+        if (below == 0 || above == 0) continue;
+        double difference = belowSum / below - (sum - belowSum) / above;
+        double between = below * above * difference * difference;
+        if (between > best) {
+            best = between;
+            level = v + 1;
+        }
+    }
+    return level;
+}
+
+// Linear map of [lo, hi] onto [0, 255], where lo and hi leave out clipPercent
+// percent of the pixels at each end. Constant images are left unchanged.
+GrayLut stretchLut(const GrayHistogram& histogram, double clipPercent) {
+    std::uint64_t total = 0;
+    for (std::uint64_t count : histogram) total += count;
+    auto clip = static_cast<std::uint64_t>(static_cast<double>(total) * clipPercent / 100);
+
+    int lo = 0;
+    for (std::uint64_t seen = 0; lo < 255 && (seen += histogram[lo]) <= clip; ++lo) {}
+    int hi = 255;
+    for (std::uint64_t seen = 0; hi > 0 && (seen += histogram[hi]) <= clip; --hi) {}
+
+    GrayLut lut;
+    for (int v = 0; v < 256; ++v) {
+        if (hi <= lo) lut[v] = static_cast<std::uint8_t>(v);
+        else if (v <= lo) lut[v] = 0;
+        else if (v >= hi) lut[v] = 255;
+        else lut[v] = static_cast<std::uint8_t>(((v - lo) * 255 + (hi - lo) / 2) / (hi - lo));
+    }
+    return lut;
+}
+
+GrayLut stageLut(const GrayOperator& stage, const GrayHistogram& histogram) {
+    GrayLut lut;
+    switch (stage.kind) {
+    case GrayOperator::Kind::Stretch:
+        return stretchLut(histogram, stage.clipPercent);
+    case GrayOperator::Kind::Threshold: {
+        int level = stage.level >= 0 ? stage.level : otsuLevel(histogram);
+        for (int v = 0; v < 256; ++v) lut[v] = v >= level ? 255 : 0;
+        return lut;
+    }
+    case GrayOperator::Kind::Invert:
+        break;
+    }
+    for (int v = 0; v < 256; ++v) lut[v] = static_cast<std::uint8_t>(255 - v);
+    return lut;
+}
+
+// Parses a whole non-negative decimal number, at most `limit`.
+bool parseNumber(const std::string& text, double limit, double& value) {
+    if (text.empty() || text.find_first_not_of("0123456789.") != std::string::npos) return false;
+    char* end = nullptr;
+    value = std::strtod(text.c_str(), &end);
+    return *end == '\0' && value <= limit;
+}
+
+void addRows(const GrayImage& image, int first, int rows, GrayHistogram& histogram) {
+    // four partial histograms, so that runs of equal values do not serialize
+    // on one counter
+    std::uint64_t partial[4][256] = {};
+    for (int i = first; i < first + rows; ++i) {
+        const std::uint8_t* row = image.row(i);
+        int j = 0;
+        for (; j + 4 <= image.width; j += 4) {
+            ++partial[0][row[j]];
+            ++partial[1][row[j + 1]];
+            ++partial[2][row[j + 2]];
+            ++partial[3][row[j + 3]];
+        }
+        for (; j < image.width; ++j) ++partial[0][row[j]];
+    }
+    for (int v = 0; v < 256; ++v)
+        histogram[v] += partial[0][v] + partial[1][v] + partial[2][v] + partial[3][v];
+}
+
+void applyRows(const GrayLut& lut, GrayImage& image, int first, int rows) {
+    for (int i = first; i < first + rows; ++i) {
+        std::uint8_t* row = image.row(i);
+        for (int j = 0; j < image.width; ++j) row[j] = lut[row[j]];
+    }
+}
+
+// Rows per band of the second pass: about 1 MiB of gray values.
+int passRows(int width) {
+    return static_cast<int>(std::max<std::size_t>(1, (std::size_t(1) << 20) / std::max(width, 1)));
+}
+
+} // namespace
+
+
+bool GrayOperator::needsHistogram() const {
+    return kind == Kind::Stretch || (kind == Kind::Threshold && level < 0);
+}
+
+
+bool OperatorChain::needsHistogram() const {
+    return std::any_of(stages.begin(), stages.end(), [](const GrayOperator& stage) { return stage.needsHistogram(); });
+}
+
+
+bool parseOperatorChain(const std::string& spec, OperatorChain& chain, std::string& error) {
+    chain = OperatorChain();
+    std::size_t start = 0;
+    for (bool first = true;; first = false) {
+        std::size_t end = std::min(spec.find('|', start), spec.size());
+        std::string token = spec.substr(start, end - start);
+        if (first) {
+            chain.method = stringToGrayscaleMethod(token);
+            if (chain.method == GrayscaleMethod::Invalid) {
+                error = "Invalid grayscale method: " + token;
+                return false;
+            }
+        } else {
+            std::size_t colon = token.find(':');
+            std::string name = token.substr(0, colon);
+            std::string argument = colon == std::string::npos ? "" : token.substr(colon + 1);
+            bool hasArgument = colon != std::string::npos;
+            GrayOperator stage;
+            double value = 0;
+            if (name == "stretch") {
+                stage.kind = GrayOperator::Kind::Stretch;
+                if (hasArgument && (!parseNumber(argument, 49.9, value))) {
+                    error = "Invalid stretch percentage: " + argument + " (expected 0 to 49.9)";
+                    return false;
+                }
+                stage.clipPercent = value;
+            } else if (name == "threshold") {
+                stage.kind = GrayOperator::Kind::Threshold;
+                if (hasArgument && (!parseNumber(argument, 256, value) || value != static_cast<int>(value))) {
+                    error = "Invalid threshold: " + argument + " (expected 0 to 256)";
+                    return false;
+                }
+                stage.level = hasArgument ? static_cast<int>(value) : -1;
+            } else if (name == "invert" && !hasArgument) {
+                stage.kind = GrayOperator::Kind::Invert;
+            } else {
+                error = "Unknown operator: " + token;
+                return false;
+            }
+            chain.stages.push_back(stage);
+        }
+        if (end == spec.size()) return true;
+        start = end + 1;
+    }
+}
+
+
+GrayLut composeOperators(const std::vector<GrayOperator>& stages, const GrayHistogram& histogram) {
+    GrayLut lut;
+    for (int v = 0; v < 256; ++v) lut[v] = static_cast<std::uint8_t>(v);
+    for (const GrayOperator& stage : stages) {
+        GrayLut next = stageLut(stage, stage.needsHistogram() ? remapHistogram(histogram, lut) : histogram);
+        for (std::uint8_t& value : lut) value = next[value];
+    }
+    return lut;
+}
+
+
+GrayHistogram remapHistogram(const GrayHistogram& histogram, const GrayLut& lut) {
+    GrayHistogram remapped{};
+    for (int v = 0; v < 256; ++v) remapped[lut[v]] += histogram[v];
+    return remapped;
+}
+
+
+FusedConversion::FusedConversion(std::vector<OperatorChain> chains, std::vector<ThumbnailSpec> thumbnails)
+    : chains_(std::move(chains)), thumbnails_(std::move(thumbnails)) {
+    GrayHistogram none{};
+    for (const OperatorChain& chain : chains_) {
+        methods_.push_back(chain.method);
+        luts_.push_back(composeOperators(chain.needsHistogram() ? std::vector<GrayOperator>() : chain.stages, none));
+        if (!chain.stages.empty()) trivial_ = false;
+        if (chain.needsHistogram()) needsHistograms_ = true;
+    }
+}
+
+
+int FusedConversion::mipTargets(std::size_t c, int width, int height, std::vector<GrayImage>& thumbnails,
+                                GrayImage** targets) const {
+    std::fill(targets, targets + maxThumbnailShift, nullptr);
+    std::size_t count = thumbnails_.size();
+    int levels = 0;
+    for (std::size_t s = 0; s < count; ++s) {
+        int level = thumbnailLevel(thumbnails_[s], width, height);
+        levels = std::max(levels, level);
+        if (level == 0) continue;
+        // a 1/N thumbnail is its level; other widths keep the level they are
+        // resampled from in their scratch image
+        if (thumbnails_[s].width == 0)
+            targets[level - 1] = &thumbnails[c * count + s];
+        else if (!targets[level - 1])
+            targets[level - 1] = &thumbnails[(chains_.size() + c) * count + s];
+    }
+    return levels;
+}
+
+
+void FusedConversion::convert(const RgbView& rgbImage, std::vector<GrayImage>& outputs,
+                              std::vector<GrayHistogram>* histograms, ThreadPool* pool,
+                              std::vector<GrayImage>* thumbnails) const {
+    bool withThumbnails = thumbnails && !thumbnails_.empty();
+    if (trivial_ && !histograms && !withThumbnails) {
+        convertToGrayscale(rgbImage, methods_, outputs, pool);
+        return;
+    }
+
+    // mip levels are sized up front; bands then only fill their own rows
+    int width = rgbImage.width;
+    int height = rgbImage.height;
+    int levels = 0;
+    if (withThumbnails) {
+        thumbnails->resize(2 * chains_.size() * thumbnails_.size());
+        for (std::size_t c = 0; c < chains_.size(); ++c) {
+            GrayImage* targets[maxThumbnailShift];
+            levels = std::max(levels, mipTargets(c, width, height, *thumbnails, targets));
+            for (int l = 1; l <= maxThumbnailShift; ++l)
+                if (targets[l - 1]) targets[l - 1]->resize(mipExtent(width, l), mipExtent(height, l));
+            for (std::size_t s = 0; s < thumbnails_.size(); ++s) {
+                if (thumbnails_[s].width == 0) continue;
+                int thumbnailWidth = 0;
+                int thumbnailHeight = 0;
+                thumbnailSize(thumbnails_[s], width, height, thumbnailWidth, thumbnailHeight);
+                (*thumbnails)[c * thumbnails_.size() + s].resize(thumbnailWidth, thumbnailHeight);
+            }
+        }
+    }
+
+    // feeds rows of chain c's final output to its mip chain
+    auto addMips = [&](std::size_t c, int first, int rows) {
+        GrayImage* targets[maxThumbnailShift];
+        mipTargets(c, width, height, *thumbnails, targets);
+        addMipRows(outputs[c], first, rows, levels, targets);
+    };
+
+    // counted per band: the final histogram of chains applied in the sweep,
+    // the method's output for the others
+    bool twoPass = needsHistograms_;
+    bool needed = twoPass || histograms != nullptr;
+    std::vector<GrayHistogram> local;
+    std::vector<GrayHistogram>& counted = histograms ? *histograms : local;
+    if (needed) counted.assign(chains_.size(), GrayHistogram{});
+
+    struct Sweep {
+        const FusedConversion& conversion;
+        std::vector<GrayImage>& outputs;
+        std::vector<GrayHistogram>& counted;
+        bool needed;
+        bool mips;
+        decltype(addMips)& addMipsOf;
+        std::mutex mutex;
+    } sweep{*this, outputs, counted, needed, levels > 0, addMips, {}};
+
+    // a single pointer capture keeps the callback within std::function's
+    // small-object buffer, so no allocation per image
+    GrayscaleBandCallback onBand = [s = &sweep](int first, int rows) {
+        for (std::size_t c = 0; c < s->conversion.chains_.size(); ++c) {
+            const OperatorChain& chain = s->conversion.chains_[c];
+            GrayImage& output = s->outputs[c];
+            if (!chain.needsHistogram() && !chain.stages.empty())
+                applyRows(s->conversion.luts_[c], output, first, rows);
+            if (s->mips && !chain.needsHistogram()) s->addMipsOf(c, first, rows);
+            if (!s->needed) continue;
+            GrayHistogram histogram{};
+            addRows(output, first, rows, histogram);
+            std::lock_guard<std::mutex> lock(s->mutex);
+            for (int v = 0; v < 256; ++v) s->counted[c][v] += histogram[v];
+        }
+    };
+    convertToGrayscale(rgbImage, methods_, outputs, pool, onBand, 1 << levels);
+
+    // second pass over the gray outputs of histogram-dependent chains only
+    for (std::size_t c = 0; twoPass && c < chains_.size(); ++c) {
+        if (!chains_[c].needsHistogram()) continue;
+        GrayLut lut = composeOperators(chains_[c].stages, counted[c]);
+        GrayImage& output = outputs[c];
+        int alignment = 1 << levels;
+        int rows = (passRows(output.width) + alignment - 1) / alignment * alignment;
+        int bands = (output.height + rows - 1) / rows;
+        auto applyBand = [&](std::size_t band) {
+            int first = static_cast<int>(band) * rows;
+            int count = std::min(rows, output.height - first);
+            applyRows(lut, output, first, count);
+            if (levels > 0) addMips(c, first, count);
+        };
+        if (pool && pool->size() > 1 && bands > 1) {
+            pool->parallelFor(static_cast<std::size_t>(bands), applyBand);
+        } else {
+            for (int band = 0; band < bands; ++band) applyBand(static_cast<std::size_t>(band));
+        }
+        counted[c] = remapHistogram(counted[c], lut);
+    }
+
+    // other widths, from the finished mip levels
+    if (!withThumbnails) return;
+    for (std::size_t c = 0; c < chains_.size(); ++c) {
+        GrayImage* targets[maxThumbnailShift];
+        mipTargets(c, width, height, *thumbnails, targets);
+        for (std::size_t s = 0; s < thumbnails_.size(); ++s) {
+            if (thumbnails_[s].width == 0) continue;
+            int level = thumbnailLevel(thumbnails_[s], width, height);
+            const GrayImage& source = level == 0 ? outputs[c] : *targets[level - 1];
+            resampleArea(source, (*thumbnails)[c * thumbnails_.size() + s]);
+        }
+    }
+}
+
+
+void HistogramReport::add(const std::string& input, const std::vector<GrayHistogram>& histograms) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    images_.emplace_back(input, histograms);
+}
+
+
+void HistogramReport::writeJson(std::ostream& out) const {
+    std::vector<std::pair<std::string, std::vector<GrayHistogram>>> images;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        images = images_;
+    }
+    std::sort(images.begin(), images.end(),
+              [](const auto& a, const auto& b) { return a.first < b.first; });
+
+    out << "{\n  \"methods\": [";
+    for (std::size_t m = 0; m < methods.size(); ++m)
+        out << (m ? ", " : "") << jsonQuoted(methods[m]);
+    out << "],\n  \"inputs\": [";
+    for (std::size_t k = 0; k < images.size(); ++k) {
+        out << (k ? "," : "") << "\n    {\"input\": " << jsonQuoted(images[k].first) << ", \"histograms\": [";
+        const std::vector<GrayHistogram>& histograms = images[k].second;
+        for (std::size_t m = 0; m < histograms.size(); ++m) {
+            out << (m ? ", " : "") << "[";
+            for (int v = 0; v < 256; ++v)
+                out << (v ? "," : "") << histograms[m][v];
+            out << "]";
+        }
+        out << "]}";
+    }
+    out << (images.empty() ? "" : "\n  ") << "]\n}\n";
+}
+
+
+bool HistogramReport::write(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) return false;
+    writeJson(out);
+    out.close();
+    return static_cast<bool>(out);
+}
@@ -0,0 +1,118 @@
+#include <algorithm>
+#include <filesystem>
+#include <iostream>
+#include <string>
+#include <vector>
+#include "archive.hpp"
+#include "ppm_io.hpp"
+
+
+namespace fs = std::filesystem;
+
+
+// pack: every .ppm of a folder, in name order, as RGB entries named after the file.
+int pack(const std::string& inputFolder, const std::string& archivePath) {
+    std::vector<fs::path> inputs;
+    for (const auto& entry : fs::directory_iterator(inputFolder))
+        if (entry.path().extension() == ".ppm") inputs.push_back(entry.path());
+    std::sort(inputs.begin(), inputs.end());
+
+    ArchiveWriter archive;
+    if (!archive.create(archivePath, inputs.size())) {
+        std::cerr << "Failed to write " << archivePath << "\n";
+        return 1;
+    }
+
+    int failures = 0;
+    for (std::size_t k = 0; k < inputs.size(); ++k) {
+        std::string path = inputs[k].string();
+        MappedFile file;
+        PnmHeader header;
+        RgbImage image;
+        if (!file.open(path) || !parsePnmHeader(file.data(), file.size(), header) ||
+            !parsePPM(file.data(), file.size(), image)) {
+            std::cerr << "Failed to read " << path << "\n";
+            ++failures;
+            continue;
+        }
+        if (!archive.add(k, inputs[k].filename().string(), image.view(), header.maxVal)) {
+            std::cerr << "Failed to add " << path << " to " << archivePath << "\n";
+            ++failures;
+            continue;
+        }
+        std::cout << "Packed: " << path << "\n";
+    }
+
+    if (!archive.finish()) {
+        std::cerr << "Failed to write " << archivePath << "\n";
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+
+// unpack: each entry back to a PPM (RGB) or PGM (gray) file; names containing
+// directories recreate them below the output folder.
+int unpack(const std::string& archivePath, const std::string& outputFolder, PnmEncoding encoding) {
+    ArchiveReader archive;
+    if (!archive.open(archivePath)) {
+        std::cerr << "Failed to read " << archivePath << "\n";
+        return 1;
+    }
+
+    int failures = 0;
+    for (const ArchiveEntry& entry : archive.entries()) {
+        fs::path name = fs::path(entry.name).lexically_normal();
+        if (name.is_absolute() || name.empty() || *name.begin() == "..") {
+            std::cerr << "Refusing to unpack " << entry.name << " outside " << outputFolder << "\n";
+            ++failures;
+            continue;
+        }
+
+        fs::path path = fs::path(outputFolder) / name;
+        std::error_code ec;
+        fs::create_directories(path.parent_path(), ec);
+        bool ok = entry.channels == 3 ? writePPM(path.string(), archive.rgb(entry), entry.maxVal, encoding)
+                                      : writePGM(path.string(), archive.gray(entry), encoding);
+        if (!ok) {
+            std::cerr << "Failed to write " << path.string() << "\n";
+            ++failures;
+            continue;
+        }
+        std::cout << "Unpacked: " << path.string() << "\n";
+    }
+    return failures == 0 ? 0 : 1;
+}
+
+
+int list(const std::string& archivePath) {
+    ArchiveReader archive;
+    if (!archive.open(archivePath)) {
+        std::cerr << "Failed to read " << archivePath << "\n";
+        return 1;
+    }
+    for (const ArchiveEntry& entry : archive.entries())
+        std::cout << entry.name << " " << entry.width << "x" << entry.height << " "
+                  << (entry.channels == 3 ? "rgb" : "gray") << " " << entry.size << " bytes\n";
+    return 0;
+}
+
+
+void printUsage() {
+    std::cerr << "Usage: ./grayscale_pack pack <input_folder> <archive.gpak>\n"
+              << "       ./grayscale_pack unpack <archive.gpak> <output_folder> [--plain]\n"
+              << "       ./grayscale_pack list <archive.gpak>\n"
+              << "  pack stores every .ppm of the folder; unpack writes RGB entries as PPM and\n"
+              << "  gray entries as PGM, raw (P6/P5) unless --plain (P3/P2) is given.\n";
+}
+
+
+int main(int argc, char* argv[]) {
+    std::string command = argc > 1 ? argv[1] : "";
+    if (command == "pack" && argc == 4) return pack(argv[2], argv[3]);
+    if (command == "list" && argc == 3) return list(argv[2]);
+    if (command == "unpack" && (argc == 4 || (argc == 5 && std::string(argv[4]) == "--plain")))
+        return unpack(argv[2], argv[3], argc == 5 ? PnmEncoding::Plain : PnmEncoding::Raw);
+    printUsage();
+    return 1;
+}
@@ -0,0 +1,91 @@
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "bounded_queue.hpp"
+#include "pipeline.hpp"
+
+
+namespace {
+
+// Waiting on a queue: a few yields for the common short stall, then short
+// sleeps, since an item is a whole image and stalls can last milliseconds.
+class Backoff {
+public:
+    void pause() {
+        if (++rounds_ < 64)
+            std::this_thread::yield();
+        else
+            std::this_thread::sleep_for(std::chrono::microseconds(100));
+    }
+
+private:
+    unsigned rounds_ = 0;
+};
+
+void pushWait(BoundedQueue<std::size_t>& queue, std::size_t item) {
+    Backoff backoff;
+    while (!queue.tryPush(item)) backoff.pause();
+}
+
+// Pops the next item; returns false once the queue is empty and every
+// producer has finished.
+bool popWait(BoundedQueue<std::size_t>& queue, const std::atomic<unsigned>& producersLeft, std::size_t& item) {
+    Backoff backoff;
+    for (;;) {
+        if (queue.tryPop(item)) return true;
+        // a producer pushes before it leaves, so one more try settles it
+        if (producersLeft.load() == 0) return queue.tryPop(item);
+        backoff.pause();
+    }
+}
+
+} // namespace
+
+
+void runPipeline(std::size_t count, const PipelineOptions& options,
+                 const std::function<void(std::size_t)>& read,
+                 const std::function<void(std::size_t)>& convert,
+                 const std::function<void(std::size_t)>& write) {
+    const unsigned readers = std::max(options.readers, 1u);
+    const unsigned converters = std::max(options.converters, 1u);
+    const unsigned writers = std::max(options.writers, 1u);
+    BoundedQueue<std::size_t> toConvert(options.queueDepth);
+    BoundedQueue<std::size_t> toWrite(options.queueDepth);
+
+    std::atomic<std::size_t> nextItem{0};
+    std::atomic<unsigned> readersLeft{readers};
+    std::atomic<unsigned> convertersLeft{converters};
+
+    std::vector<std::thread> threads;
+    for (unsigned t = 0; t < readers; ++t) {
+        threads.emplace_back([&] {
+            for (std::size_t item = nextItem++; item < count; item = nextItem++) {
+                read(item);
+                pushWait(toConvert, item);
+            }
+            --readersLeft;
+        });
+    }
+    for (unsigned t = 0; t < converters; ++t) {
+        threads.emplace_back([&] {
+            std::size_t item;
+            while (popWait(toConvert, readersLeft, item)) {
+                convert(item);
+                pushWait(toWrite, item);
+            }
+            --convertersLeft;
+        });
+    }
+    for (unsigned t = 0; t < writers; ++t) {
+        threads.emplace_back([&] {
+            std::size_t item;
+            while (popWait(toWrite, convertersLeft, item))
+                write(item);
+        });
+    }
+
+    for (std::thread& thread : threads)
+        thread.join();
+}
@@ -0,0 +1,651 @@
+#include <climits>
+#include <cstdint>
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <cstring>
+#include <cstdio>
+#include <fstream>
+#include "ppm_io.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <fcntl.h>
+#include <unistd.h>
+#define PPM_IO_HAS_POSIX_IO 1
+#endif
+
+
+namespace {
+
+inline bool isSpace(char c) {
+    return c == ' ' || c == '\n' || c == '\r' || c == '\t' || c == '\v' || c == '\f';
+}
+
+inline bool isDigit(char c) {
+    return static_cast<unsigned>(c - '0') <= 9;
+}
+
+// Skips whitespace and '#' comments, returning the start of the next token.
+inline const char* skipSeparators(const char* p, const char* end) {
+    while (p < end) {
+        if (isSpace(*p)) {
+            ++p;
+        } else if (*p == '#') {
+            while (p < end && *p != '\n') ++p;
+        } else {
+            break;
+        }
+    }
+    return p;
+}
+
+// Scans an unsigned decimal token no larger than limit.
+// Returns the position after the token, or nullptr if it is malformed.
+inline const char* parseUnsigned(const char* p, const char* end, long long limit, int& value) {
+    if (p == end || !isDigit(*p)) return nullptr;
+    long long v = 0;
+    do {
+        v = v * 10 + (*p - '0');
+        if (v > limit) return nullptr;
+        ++p;
+    } while (p < end && isDigit(*p));
+
+    // tokens must be terminated by whitespace, a comment or the end of the data
+    if (p < end && !isSpace(*p) && *p != '#') return nullptr;
+    value = static_cast<int>(v);
+    return p;
+}
+
+} // namespace
+
+
+bool parsePnmHeader(const char* data, std::size_t size, PnmHeader& header) {
+    const char* p = data;
+    const char* end = data + size;
+
+    if (size < 2 || p[0] != 'P' || !isDigit(p[1])) return false;
+    header.magic.assign(p, 2);
+    p += 2;
+    if (p < end && !isSpace(*p) && *p != '#') return false;
+
+    int* fields[] = {&header.width, &header.height, &header.maxVal};
+    for (int* field : fields) {
+        p = parseUnsigned(skipSeparators(p, end), end, INT_MAX, *field);
+        if (!p) return false;
+    }
+
+    header.dataOffset = static_cast<std::size_t>(p - data);
+    return true;
+}
+
+
+namespace {
+
+// Rasters are split into pieces of about this many bytes for parallel
+// decoding, so a piece is large enough to amortize the task overhead.
+constexpr std::size_t parallelChunkBytes = 256 << 10;
+
+// Calls fn(first, count) over consecutive spans covering [0, total), on the
+// pool when one is given and the data is large enough to be worth splitting.
+template <typename Fn>
+void forEachSpan(std::size_t total, ThreadPool* pool, Fn fn) {
+    std::size_t spans = total / parallelChunkBytes;
+    if (pool == nullptr || pool->size() < 2 || spans < 2) {
+        fn(std::size_t{0}, total);
+        return;
+    }
+    pool->parallelFor(spans, [&](std::size_t k) {
+        std::size_t first = total * k / spans;
+        fn(first, total * (k + 1) / spans - first);
+    });
+}
+
+// Counts the tokens of a piece of P3 raster that starts outside any token or
+// comment. Returns false on a byte that cannot appear in a plain raster.
+bool countTokens(const char* p, const char* end, std::size_t& count) {
+    count = 0;
+    for (p = skipSeparators(p, end); p < end; p = skipSeparators(p, end)) {
+        if (!isDigit(*p)) return false;
+        while (p < end && isDigit(*p)) ++p;
+        ++count;
+    }
+    return true;
+}
+
+// Decodes the P3 raster that follows the header into image.
+bool decodePlainPixelsSerial(const char* data, std::size_t size, const PnmHeader& header, RgbImage& image) {
+    image.resize(header.width, header.height);
+
+    const char* p = data + header.dataOffset;
+    const char* end = data + size;
+    const std::size_t samplesPerRow = static_cast<std::size_t>(header.width) * 3;
+    for (int i = 0; i < header.height; ++i) {
+        std::uint8_t* dst = image.row(i);
+        for (std::size_t j = 0; j < samplesPerRow; ++j) {
+            int value;
+            p = parseUnsigned(skipSeparators(p, end), end, header.maxVal, value);
+            if (!p) return false;
+            dst[j] = static_cast<std::uint8_t>(value);
+        }
+    }
+    return true;
+}
+
+// Parallel P3 decoding in two passes over newline-aligned pieces of the
+// raster: the first counts the tokens of every piece, a prefix sum turns the
+// counts into the index of each piece's first sample, and the second pass
+// parses every piece straight into its place in the image. Pieces start just
+// after a '\n', so none begins inside a token or a comment.
+// Returns false whenever the serial decoder has to take over, including on
+// any malformed input, so that errors are judged in one place.
+bool decodePlainPixelsParallel(const char* data, std::size_t size, const PnmHeader& header,
+                               RgbImage& image, ThreadPool& pool) {
+    const char* begin = data + header.dataOffset;
+    const char* end = data + size;
+    std::size_t bytes = static_cast<std::size_t>(end - begin);
+    std::size_t pieces = std::min<std::size_t>(4 * pool.size(), bytes / parallelChunkBytes);
+    if (pool.size() < 2 || pieces < 2) return false;
+
+    std::vector<const char*> bounds{begin};
+    for (std::size_t k = 1; k < pieces; ++k) {
+        const char* newline = std::find(std::max(begin + bytes * k / pieces, bounds.back()), end, '\n');
+        if (newline == end) break;
+        bounds.push_back(newline + 1);
+    }
+    bounds.push_back(end);
+    pieces = bounds.size() - 1;
+    if (pieces < 2) return false;
+
+    std::atomic<bool> ok{true};
+    std::vector<std::size_t> firstSample(pieces + 1, 0);
+    pool.parallelFor(pieces, [&](std::size_t k) {
+        if (!countTokens(bounds[k], bounds[k + 1], firstSample[k + 1])) ok = false;
+    });
+    if (!ok) return false;
+    for (std::size_t k = 0; k < pieces; ++k)
+        firstSample[k + 1] += firstSample[k];
+
+    image.resize(header.width, header.height);
+    const std::size_t samples = image.data.size();
+    if (firstSample[pieces] < samples) return false;
+
+    std::uint8_t* dst = image.data.data();
+    pool.parallelFor(pieces, [&](std::size_t k) {
+        const char* p = bounds[k];
+        std::size_t last = std::min(firstSample[k + 1], samples);
+        for (std::size_t n = firstSample[k]; n < last; ++n) {
+            int value;
+            p = parseUnsigned(skipSeparators(p, bounds[k + 1]), bounds[k + 1], header.maxVal, value);
+            if (!p) {
+                ok = false;
+                return;
+            }
+            dst[n] = static_cast<std::uint8_t>(value);
+        }
+    });
+    return ok;
+}
+
+bool decodePlainPixels(const char* data, std::size_t size, const PnmHeader& header,
+                       RgbImage& image, ThreadPool* pool) {
+    // every sample takes at least a digit and a separator (the last one may
+    // end the file), so a header promising more cannot be honoured and must
+    // not size the image
+    std::size_t samples = static_cast<std::size_t>(header.width) * static_cast<std::size_t>(header.height) * 3;
+    if (header.dataOffset > size || samples > (size - header.dataOffset + 1) / 2) return false;
+    if (pool != nullptr && decodePlainPixelsParallel(data, size, header, image, *pool)) return true;
+    return decodePlainPixelsSerial(data, size, header, image);
+}
+
+// Locates the P6 raster that follows the header without copying it.
+bool rawPixels(const char* data, std::size_t size, const PnmHeader& header, RgbView& view,
+               ThreadPool* pool) {
+    // a single whitespace byte separates maxVal from the raster
+    std::size_t offset = header.dataOffset + 1;
+    std::size_t rowBytes = static_cast<std::size_t>(header.width) * 3;
+    if (header.dataOffset >= size || !isSpace(data[header.dataOffset])) return false;
+    if (header.height != 0 && rowBytes > (size - offset) / header.height) return false;
+
+    const auto* pixels = reinterpret_cast<const std::uint8_t*>(data + offset);
+    if (header.maxVal < 255) {
+        std::uint8_t maxVal = static_cast<std::uint8_t>(header.maxVal);
+        std::atomic<bool> ok{true};
+        forEachSpan(rowBytes * header.height, pool, [&](std::size_t first, std::size_t count) {
+            if (std::any_of(pixels + first, pixels + first + count, [maxVal](std::uint8_t v) { return v > maxVal; }))
+                ok = false;
+        });
+        if (!ok) return false;
+    }
+
+    view = {pixels, header.width, header.height, rowBytes};
+    return true;
+}
+
+bool parseSupportedHeader(const char* data, std::size_t size, PnmHeader& header) {
+    if (!parsePnmHeader(data, size, header)) return false;
+    if (header.magic != "P3" && header.magic != "P6") return false;
+    return header.maxVal >= 1 && header.maxVal <= 255;
+}
+
+} // namespace
+
+
+bool parsePPM(const char* data, std::size_t size, RgbImage& image, ThreadPool* pool) {
+    PnmHeader header;
+    if (!parseSupportedHeader(data, size, header)) return false;
+    if (header.magic == "P3") return decodePlainPixels(data, size, header, image, pool);
+
+    RgbView view;
+    if (!rawPixels(data, size, header, view, pool)) return false;
+    image.resize(view.width, view.height);
+    forEachSpan(image.data.size(), pool, [&](std::size_t first, std::size_t count) {
+        std::copy(view.data + first, view.data + first + count, image.data.begin() + first);
+    });
+    return true;
+}
+
+
+bool parsePPM(const char* data, std::size_t size, PpmInput& input, ThreadPool* pool) {
+    PnmHeader header;
+    if (!parseSupportedHeader(data, size, header)) return false;
+
+    if (header.magic == "P6") return rawPixels(data, size, header, input.pixels, pool);
+
+    if (!decodePlainPixels(data, size, header, input.decoded, pool)) return false;
+    input.pixels = input.decoded.view();
+    return true;
+}
+
+
+bool openPPM(const std::string& filename, PpmInput& input, ThreadPool* pool) {
+    if (!input.file.open(filename)) return false;
+    if (!parsePPM(input.file.data(), input.file.size(), input, pool)) return false;
+    // plain files are decoded, the mapping is no longer needed
+    if (input.pixels.data == input.decoded.data.data()) input.file.close();
+    return true;
+}
+
+
+bool readPPM(const std::string& filename, RgbImage& image, ThreadPool* pool) {
+    MappedFile file;
+    if (!file.open(filename)) return false;
+    return parsePPM(file.data(), file.size(), image, pool);
+}
+
+
+namespace {
+
+// "0 " to "255 ": the digits of every gray value followed by the separator,
+// padded to four bytes so that each one is copied with a fixed-size memcpy
+struct DecimalTable {
+    char text[256][4];
+    std::uint8_t length[256];
+};
+
+constexpr DecimalTable makeDecimalTable() {
+    DecimalTable table{};
+    for (int v = 0; v < 256; ++v) {
+        int n = 0;
+        if (v >= 100) table.text[v][n++] = static_cast<char>('0' + v / 100);
+        if (v >= 10) table.text[v][n++] = static_cast<char>('0' + v / 10 % 10);
+        table.text[v][n++] = static_cast<char>('0' + v % 10);
+        table.text[v][n++] = ' ';
+        table.length[v] = static_cast<std::uint8_t>(n);
+    }
+    return table;
+}
+
+constexpr DecimalTable decimalTable = makeDecimalTable();
+
+// Output is staged in buffers of this size and handed over in single writes.
+constexpr std::size_t writeChunkBytes = 1 << 20;
+
+// upper bound of a formatted plain row, plus the slack of the last 4-byte copy
+std::size_t maxPlainRowBytes(int width) {
+    return 4 * static_cast<std::size_t>(width) + 4;
+}
+
+// Formats one row as plain PGM text ("v v ... v \n") and returns the end.
+char* formatPlainRow(const std::uint8_t* row, int width, char* dst) {
+    for (int j = 0; j < width; ++j) {
+        std::memcpy(dst, decimalTable.text[row[j]], 4);
+        dst += decimalTable.length[row[j]];
+    }
+    *dst++ = '\n';
+    return dst;
+}
+
+// room for "P2\n<width> <height>\n255\n" with the largest int dimensions
+constexpr std::size_t maxPgmHeaderBytes = 32;
+
+// Formats the header into dst (maxPgmHeaderBytes) and returns its length.
+std::size_t formatPgmHeader(int width, int height, PnmEncoding encoding, char* dst) {
+    int length = std::snprintf(dst, maxPgmHeaderBytes, "%s\n%d %d\n255\n",
+                               encoding == PnmEncoding::Raw ? "P5" : "P2", width, height);
+    return static_cast<std::size_t>(length);
+}
+
+std::string pgmHeader(int width, int height, PnmEncoding encoding) {
+    char header[maxPgmHeaderBytes];
+    return std::string(header, formatPgmHeader(width, height, encoding, header));
+}
+
+#ifdef PPM_IO_HAS_POSIX_IO
+// write() until everything is out, retrying interrupted and partial writes
+bool writeAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+// Writes the file straight to a descriptor: rows are formatted into a
+// per-thread buffer, kept across calls, that is flushed in large writes. A P5
+// file's size follows from its dimensions and is reserved with fallocate so
+// the file system can allocate it in one piece; a P2 file's size depends on
+// every pixel and is not worth a second pass to find out.
+bool writePGMFile(const std::string& filename, const GrayView& image, PnmEncoding encoding) {
+    int fd = ::open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0666);
+    if (fd < 0) return false;
+
+    thread_local std::vector<char> buffer;
+    buffer.resize(std::max(writeChunkBytes, maxPgmHeaderBytes + maxPlainRowBytes(image.width)));
+    std::size_t headerBytes = formatPgmHeader(image.width, image.height, encoding, buffer.data());
+    const std::size_t rowBytes = static_cast<std::size_t>(image.width);
+
+#ifdef __linux__
+    // best effort: file systems without fallocate support simply skip it
+    std::size_t size = headerBytes + rowBytes * static_cast<std::size_t>(image.height);
+    if (encoding == PnmEncoding::Raw && size > headerBytes) (void)::fallocate(fd, 0, 0, static_cast<off_t>(size));
+#endif
+    char* end = buffer.data() + headerBytes;
+
+    bool ok = true;
+    auto reserve = [&](std::size_t bytes) {
+        if (static_cast<std::size_t>(buffer.data() + buffer.size() - end) >= bytes) return;
+        ok = ok && writeAll(fd, buffer.data(), static_cast<std::size_t>(end - buffer.data()));
+        end = buffer.data();
+    };
+
+    if (encoding == PnmEncoding::Raw && image.stride == rowBytes) {
+        // contiguous raster: header, then the whole image in one write
+        ok = writeAll(fd, buffer.data(), headerBytes) &&
+             writeAll(fd, reinterpret_cast<const char*>(image.data), rowBytes * image.height);
+        end = buffer.data();
+    } else {
+        for (int i = 0; ok && i < image.height; ++i) {
+            if (encoding == PnmEncoding::Raw) {
+                reserve(rowBytes);
+                std::memcpy(end, image.row(i), rowBytes);
+                end += rowBytes;
+            } else {
+                reserve(maxPlainRowBytes(image.width));
+                end = formatPlainRow(image.row(i), image.width, end);
+            }
+        }
+    }
+    ok = ok && writeAll(fd, buffer.data(), static_cast<std::size_t>(end - buffer.data()));
+
+    return ::close(fd) == 0 && ok;
+}
+#endif
+
+} // namespace
+
+
+void formatPGM(const GrayView& image, PnmEncoding encoding, std::vector<char>& file) {
+    // sized for the longest possible rows (plus the slack of the fixed-size
+    // copies of formatPlainRow) and trimmed afterwards, rather than measuring
+    // the plain rows in a pass of their own
+    const std::size_t rowBytes = encoding == PnmEncoding::Raw ? static_cast<std::size_t>(image.width)
+                                                              : 4 * static_cast<std::size_t>(image.width) + 1;
+    file.resize(maxPgmHeaderBytes + rowBytes * static_cast<std::size_t>(image.height) + 4);
+    char* end = file.data() + formatPgmHeader(image.width, image.height, encoding, file.data());
+    for (int i = 0; i < image.height; ++i) {
+        if (encoding == PnmEncoding::Raw) {
+            std::memcpy(end, image.row(i), static_cast<std::size_t>(image.width));
+            end += image.width;
+        } else {
+            end = formatPlainRow(image.row(i), image.width, end);
+        }
+    }
+    file.resize(static_cast<std::size_t>(end - file.data()));
+}
+
+
+bool writePGM(const std::string& filename, const GrayView& grayscaleImage, PnmEncoding encoding) {
+#ifdef PPM_IO_HAS_POSIX_IO
+    return writePGMFile(filename, grayscaleImage, encoding);
+#else
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) return false;
+
+    PgmStreamWriter writer(out, grayscaleImage.width, grayscaleImage.height, encoding);
+    writer.writeRows(grayscaleImage);
+    return writer.finish();
+#endif
+}
+
+
+bool writePGM(const std::string& filename, const GrayImage& grayscaleImage, PnmEncoding encoding) {
+    return writePGM(filename, grayscaleImage.view(), encoding);
+}
+
+
+bool writePPM(const std::string& filename, const RgbView& image, int maxVal, PnmEncoding encoding) {
+    std::ofstream out(filename, std::ios::binary);
+    if (!out) return false;
+    out << (encoding == PnmEncoding::Raw ? "P6\n" : "P3\n") << image.width << " " << image.height << "\n"
+        << maxVal << "\n";
+
+    const std::size_t rowBytes = static_cast<std::size_t>(image.width) * 3;
+    std::vector<char> buffer(encoding == PnmEncoding::Raw ? rowBytes : maxPlainRowBytes(image.width * 3));
+    for (int i = 0; i < image.height && out; ++i) {
+        if (encoding == PnmEncoding::Raw) {
+            out.write(reinterpret_cast<const char*>(image.row(i)), static_cast<std::streamsize>(rowBytes));
+        } else {
+            char* end = formatPlainRow(image.row(i), image.width * 3, buffer.data());
+            out.write(buffer.data(), end - buffer.data());
+        }
+    }
+    out.close();
+    return static_cast<bool>(out);
+}
+
+
+PpmStreamReader::PpmStreamReader(std::istream& in, std::size_t chunkSize)
+    : in_(in), chunkSize_(chunkSize) {}
+
+
+// Moves the unconsumed bytes to the front of the buffer and appends up to one
+// chunk from the stream. Returns false when nothing more could be read.
+bool PpmStreamReader::fill() {
+    if (eof_) return false;
+    std::size_t pending = end_ - pos_;
+    if (pos_ != 0) std::copy(buffer_.begin() + pos_, buffer_.begin() + end_, buffer_.begin());
+    buffer_.resize(pending + chunkSize_);
+    in_.read(buffer_.data() + pending, static_cast<std::streamsize>(chunkSize_));
+    std::size_t got = static_cast<std::size_t>(in_.gcount());
+    pos_ = 0;
+    end_ = pending + got;
+    if (!in_) eof_ = true;
+    return got != 0;
+}
+
+
+bool PpmStreamReader::readHeader() {
+    // the header must fit in the first 64 KiB (or the whole stream)
+    while (end_ - pos_ < (64u << 10) && fill()) {}
+    if (!parseSupportedHeader(buffer_.data() + pos_, end_ - pos_, header_)) return false;
+    pos_ += header_.dataOffset;
+
+    if (header_.magic == "P6") {
+        // a single whitespace byte separates maxVal from the raster
+        if (pos_ >= end_ || !isSpace(buffer_[pos_])) return false;
+        ++pos_;
+    }
+
+    // When the size of the rest of the input is known (all of it buffered,
+    // or a seekable stream), reject rasters it cannot hold before a band is
+    // sized for them: a P6 sample is one byte, a P3 one at least a digit and
+    // a separator.
+    std::size_t remaining = end_ - pos_;
+    if (!eof_) {
+        std::istream::pos_type here = in_.tellg();
+        if (here == std::istream::pos_type(-1) || !in_.seekg(0, std::ios::end)) {
+            in_.clear();
+            return true;
+        }
+        std::istream::pos_type last = in_.tellg();
+        in_.seekg(here);
+        if (last == std::istream::pos_type(-1) || !in_) {
+            in_.clear();
+            return true;
+        }
+        remaining += static_cast<std::size_t>(last - here);
+    }
+    std::size_t samples = static_cast<std::size_t>(header_.width) * static_cast<std::size_t>(header_.height) * 3;
+    return samples <= (header_.magic == "P6" ? remaining : (remaining + 1) / 2);
+}
+
+
+bool PpmStreamReader::nextSample(int& value) {
+    // skip whitespace and comments, which may span refills
+    for (;;) {
+        while (pos_ < end_) {
+            char c = buffer_[pos_];
+            if (inComment_) {
+                inComment_ = c != '\n';
+            } else if (c == '#') {
+                inComment_ = true;
+            } else if (!isSpace(c)) {
+                break;
+            }
+            ++pos_;
+        }
+        if (pos_ < end_) break;
+        if (!fill()) return false;
+    }
+
+    // make sure the whole token is buffered before scanning it
+    std::size_t length = 0;
+    for (;;) {
+        while (pos_ + length < end_ && isDigit(buffer_[pos_ + length]) && length <= 10) ++length;
+        if (pos_ + length < end_ || !fill()) break;
+    }
+
+    const char* token = buffer_.data() + pos_;
+    const char* next = parseUnsigned(token, buffer_.data() + end_, header_.maxVal, value);
+    if (!next) return false;
+    pos_ += static_cast<std::size_t>(next - token);
+    return true;
+}
+
+
+bool PpmStreamReader::readRows(int maxRows, RgbImage& band) {
+    int rows = std::min(maxRows, rowsRemaining());
+    band.resize(header_.width, rows);
+    std::size_t rowBytes = static_cast<std::size_t>(header_.width) * 3;
+
+    for (int i = 0; i < rows; ++i) {
+        std::uint8_t* dst = band.row(i);
+        if (header_.magic == "P3") {
+            for (std::size_t j = 0; j < rowBytes; ++j) {
+                int sample;
+                if (!nextSample(sample)) return false;
+                dst[j] = static_cast<std::uint8_t>(sample);
+            }
+        } else {
+            // buffered bytes first, then straight from the stream into the band
+            std::size_t buffered = std::min(rowBytes, end_ - pos_);
+            std::copy(buffer_.begin() + pos_, buffer_.begin() + pos_ + buffered, dst);
+            pos_ += buffered;
+            if (buffered < rowBytes) {
+                in_.read(reinterpret_cast<char*>(dst + buffered), static_cast<std::streamsize>(rowBytes - buffered));
+                if (static_cast<std::size_t>(in_.gcount()) != rowBytes - buffered) return false;
+            }
+            if (header_.maxVal < 255)
+                for (std::size_t j = 0; j < rowBytes; ++j)
+                    if (dst[j] > header_.maxVal) return false;
+        }
+        ++rowsRead_;
+    }
+    return true;
+}
+
+
+PgmStreamWriter::PgmStreamWriter(std::ostream& out, int width, int height, PnmEncoding encoding)
+    : out_(out), width_(width), height_(height), encoding_(encoding) {
+    std::string header = pgmHeader(width_, height_, encoding_);
+    out_.write(header.data(), static_cast<std::streamsize>(header.size()));
+}
+
+
+namespace {
+
+// Writes the rows of `band`, raw or as plain text formatted into `buffer`
+// and written in large pieces.
+template <int Channels>
+void writeBandRows(std::ostream& out, std::vector<char>& buffer, const ImageView<Channels>& band,
+                   PnmEncoding encoding) {
+    const int samples = band.width * Channels;
+    if (encoding == PnmEncoding::Plain && buffer.empty())
+        buffer.resize(std::max(writeChunkBytes, maxPlainRowBytes(samples)));
+    char* end = buffer.data();
+    for (int i = 0; i < band.height; ++i) {
+        const std::uint8_t* row = band.row(i);
+        if (encoding == PnmEncoding::Raw) {
+            out.write(reinterpret_cast<const char*>(row), samples);
+            continue;
+        }
+        if (static_cast<std::size_t>(buffer.data() + buffer.size() - end) < maxPlainRowBytes(samples)) {
+            out.write(buffer.data(), end - buffer.data());
+            end = buffer.data();
+        }
+        end = formatPlainRow(row, samples, end);
+    }
+    if (end != buffer.data()) out.write(buffer.data(), end - buffer.data());
+}
+
+} // namespace
+
+
+bool PgmStreamWriter::writeRows(const GrayView& band) {
+    if (band.width != width_ || rowsWritten_ + band.height > height_) return false;
+    writeBandRows(out_, buffer_, band, encoding_);
+    rowsWritten_ += band.height;
+    return static_cast<bool>(out_);
+}
+
+
+bool PgmStreamWriter::finish() {
+    out_.flush();
+    return rowsWritten_ == height_ && static_cast<bool>(out_);
+}
+
+
+PpmStreamWriter::PpmStreamWriter(std::ostream& out, int width, int height, PnmEncoding encoding)
+    : out_(out), width_(width), height_(height), encoding_(encoding) {
+    out_ << (encoding_ == PnmEncoding::Raw ? "P6\n" : "P3\n") << width_ << " " << height_ << "\n255\n";
+}
+
+
+bool PpmStreamWriter::writeRows(const RgbView& band) {
+    if (band.width != width_ || rowsWritten_ + band.height > height_) return false;
+    writeBandRows(out_, buffer_, band, encoding_);
+    rowsWritten_ += band.height;
+    return static_cast<bool>(out_);
+}
+
+
+bool PpmStreamWriter::finish() {
+    out_.flush();
+    return rowsWritten_ == height_ && static_cast<bool>(out_);
+}
@@ -0,0 +1,551 @@
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <csignal>
+#include <cstring>
+#include <exception>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "server.hpp"
+#include "thread_pool.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <cerrno>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+#define SERVER_HAS_SOCKETS 1
+#endif
+
+
+namespace {
+
+std::vector<std::string> splitFields(const std::string& line) {
+    std::vector<std::string> fields;
+    std::size_t start = 0;
+    for (;;) {
+        std::size_t end = line.find('\t', start);
+        fields.push_back(line.substr(start, end - start));
+        if (end == std::string::npos) return fields;
+        start = end + 1;
+    }
+}
+
+} // namespace
+
+
+bool parseServerRequest(const std::string& line, ServerRequest& request, std::string& error) {
+    std::vector<std::string> fields = splitFields(line);
+    const std::string& command = fields[0];
+    request = ServerRequest();
+
+    if (command == "ping" || command == "shutdown") {
+        if (fields.size() != 1) {
+            error = "Malformed request: " + command + " takes no arguments";
+            return false;
+        }
+        request.kind = command == "ping" ? ServerRequest::Kind::Ping : ServerRequest::Kind::Shutdown;
+        return true;
+    }
+
+    if (command != "convert" && command != "inline") {
+        error = "Unknown request: " + command;
+        return false;
+    }
+    if (command == "inline") {
+        // the byte count comes first: once it is known, the image bytes of a
+        // request rejected for another field can still be skipped
+        std::string count = fields.size() > 2 ? fields[2] : std::string();
+        if (count.empty() || count.size() > 12 || !std::all_of(count.begin(), count.end(), [](char c) { return c >= '0' && c <= '9'; })) {
+            error = "Invalid byte count: " + count;
+            return false;
+        }
+        std::size_t bytes = static_cast<std::size_t>(std::stoull(count));
+        if (bytes > maxInlineBytes) {
+            error = "Inline image too large: " + count + " bytes (at most " + std::to_string(maxInlineBytes) + ")";
+            return false;
+        }
+        request.kind = ServerRequest::Kind::Inline;
+        request.inlineBytes = bytes;
+    }
+    if (fields.size() != 4 && fields.size() != 5) {
+        error = "Malformed request: expected " + command + "<TAB>method<TAB>" +
+                (command == "convert" ? "input" : "bytes") + "<TAB>output[<TAB>P2|P5]";
+        return false;
+    }
+
+    request.method = stringToGrayscaleMethod(fields[1]);
+    if (request.method == GrayscaleMethod::Invalid) {
+        error = "Invalid grayscale method: " + fields[1];
+        return false;
+    }
+
+    if (command == "convert") {
+        request.kind = ServerRequest::Kind::Convert;
+        request.input = fields[2];
+    }
+
+    request.output = fields[3];
+    if (request.input.empty() && request.kind == ServerRequest::Kind::Convert) {
+        error = "Malformed request: empty input path";
+        return false;
+    }
+    if (request.output.empty()) {
+        error = "Malformed request: empty output path";
+        return false;
+    }
+
+    if (fields.size() == 5) {
+        if (fields[4] == "P2") request.encoding = PnmEncoding::Plain;
+        else if (fields[4] == "P5") request.encoding = PnmEncoding::Raw;
+        else {
+            error = "Invalid output format: " + fields[4];
+            return false;
+        }
+    }
+    return true;
+}
+
+
+#ifdef SERVER_HAS_SOCKETS
+
+namespace {
+
+// write() until everything is out; false once the peer is gone
+bool writeAll(int fd, const char* data, std::size_t size) {
+    while (size > 0) {
+        ssize_t written = ::write(fd, data, size);
+        if (written < 0) {
+            if (errno == EINTR) continue;
+            return false;
+        }
+        data += written;
+        size -= static_cast<std::size_t>(written);
+    }
+    return true;
+}
+
+
+// Buffered reads of lines and byte blocks from a descriptor.
+class FdReader {
+public:
+    explicit FdReader(int fd) : fd_(fd), buffer_(64 << 10) {}
+
+    // Reads up to the next newline, which is dropped. A last line without a
+    // newline is returned too; false at end of input.
+    bool readLine(std::string& line) {
+        line.clear();
+        for (;;) {
+            char* begin = buffer_.data() + pos_;
+            char* end = buffer_.data() + end_;
+            char* newline = std::find(begin, end, '\n');
+            line.append(begin, newline);
+            pos_ = static_cast<std::size_t>(newline - buffer_.data());
+            if (newline != end) {
+                ++pos_;
+                return true;
+            }
+            if (!fill()) return !line.empty();
+        }
+    }
+
+    bool readBytes(std::size_t count, std::vector<char>& bytes) {
+        bytes.clear();
+        // grown as the bytes arrive, not sized by a count that may never be met
+        bytes.reserve(std::min<std::size_t>(count, 16 << 20));
+        while (bytes.size() < count) {
+            if (pos_ == end_ && !fill()) return false;
+            std::size_t take = std::min(count - bytes.size(), end_ - pos_);
+            bytes.insert(bytes.end(), buffer_.data() + pos_, buffer_.data() + pos_ + take);
+            pos_ += take;
+        }
+        return true;
+    }
+
+    // Consumes `count` bytes without keeping them; false at end of input.
+    bool skipBytes(std::size_t count) {
+        while (count > 0) {
+            if (pos_ == end_ && !fill()) return false;
+            std::size_t take = std::min(count, end_ - pos_);
+            pos_ += take;
+            count -= take;
+        }
+        return true;
+    }
+
+private:
+    bool fill() {
+        for (;;) {
+            ssize_t got = ::read(fd_, buffer_.data(), buffer_.size());
+            if (got < 0 && errno == EINTR) continue;
+            pos_ = 0;
+            end_ = got > 0 ? static_cast<std::size_t>(got) : 0;
+            return got > 0;
+        }
+    }
+
+    int fd_;
+    std::vector<char> buffer_;
+    std::size_t pos_ = 0;
+    std::size_t end_ = 0;
+};
+
+
+// Responses of one connection, written in request order as they complete.
+class ResponseQueue {
+public:
+    explicit ResponseQueue(int fd) : fd_(fd) {}
+
+    std::size_t reserve() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return issued_++;
+    }
+
+    void complete(std::size_t ticket, std::string response) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        ready_.emplace(ticket, std::move(response));
+        while (!ready_.empty() && ready_.begin()->first == written_) {
+            std::string& line = ready_.begin()->second;
+            line += '\n';
+            // a client that went away is not an error of the server
+            if (!peerGone_) peerGone_ = !writeAll(fd_, line.data(), line.size());
+            ready_.erase(ready_.begin());
+            ++written_;
+        }
+        if (written_ == issued_) allWritten_.notify_all();
+    }
+
+    void drain() {
+        std::unique_lock<std::mutex> lock(mutex_);
+        allWritten_.wait(lock, [this] { return written_ == issued_; });
+    }
+
+private:
+    int fd_;
+    std::mutex mutex_;
+    std::condition_variable allWritten_;
+    std::size_t issued_ = 0;
+    std::size_t written_ = 0;
+    std::map<std::size_t, std::string> ready_;
+    bool peerGone_ = false;
+};
+
+
+// Conversion buffers shared by all connections and kept warm between
+// requests. A free list rather than thread_local storage: a request may run
+// nested inside another one's parallelFor on the same thread.
+struct Scratch {
+    PpmInput input;
+    RgbImage decoded;
+    GrayImage gray;
+};
+
+class ScratchPool {
+public:
+    std::unique_ptr<Scratch> acquire() {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (free_.empty()) return std::make_unique<Scratch>();
+        std::unique_ptr<Scratch> scratch = std::move(free_.back());
+        free_.pop_back();
+        return scratch;
+    }
+
+    void release(std::unique_ptr<Scratch> scratch) {
+        scratch->input.file.close();
+        std::lock_guard<std::mutex> lock(mutex_);
+        free_.push_back(std::move(scratch));
+    }
+
+private:
+    std::mutex mutex_;
+    std::vector<std::unique_ptr<Scratch>> free_;
+};
+
+ScratchPool scratchPool;
+
+
+// Requests read but not yet answered, across all connections. Reading waits
+// while either limit is reached, so a client pipelining inline images faster
+// than they are converted holds at most maxInFlightBytes of them.
+class InFlightLimit {
+public:
+    void acquire(std::size_t bytes) {
+        std::unique_lock<std::mutex> lock(mutex_);
+        released_.wait(lock, [&] {
+            return requests_ < maxInFlightRequests && bytes_ + bytes <= maxInFlightBytes;
+        });
+        ++requests_;
+        bytes_ += bytes;
+    }
+
+    void release(std::size_t bytes) {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            --requests_;
+            bytes_ -= bytes;
+        }
+        released_.notify_all();
+    }
+
+private:
+    std::mutex mutex_;
+    std::condition_variable released_;
+    std::size_t requests_ = 0;
+    std::size_t bytes_ = 0;
+};
+
+InFlightLimit inFlight;
+
+
+std::string convertRequest(const ServerRequest& request, const std::vector<char>& bytes, ThreadPool& pool) {
+    std::unique_ptr<Scratch> scratch = scratchPool.acquire();
+    std::string response;
+    RgbView pixels;
+    if (request.kind == ServerRequest::Kind::Convert) {
+        if (openPPM(request.input, scratch->input, &pool)) pixels = scratch->input.pixels;
+        else response = "error\tFailed to read " + request.input;
+    } else {
+        if (parsePPM(bytes.data(), bytes.size(), scratch->decoded, &pool)) pixels = scratch->decoded.view();
+        else response = "error\tFailed to read inline image";
+    }
+
+    if (response.empty()) {
+        convertToGrayscale(pixels, request.method, scratch->gray, &pool);
+        response = writePGM(request.output, scratch->gray, request.encoding) ? "ok\t" + request.output
+                                                                              : "error\tFailed to write " + request.output;
+    }
+    scratchPool.release(std::move(scratch));
+    return response;
+}
+
+
+int connectTo(const std::string& socketPath) {
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) return -1;
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (fd < 0) return -1;
+    if (::connect(fd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0) {
+        ::close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+
+// Copies the responses to outFd; false if any of them is an error.
+bool copyResponses(int fd, int outFd) {
+    bool ok = true;
+    bool lineStart = true;
+    std::string prefix;
+    char buffer[64 << 10];
+    for (;;) {
+        ssize_t got = ::read(fd, buffer, sizeof(buffer));
+        if (got < 0 && errno == EINTR) continue;
+        if (got <= 0) break;
+        for (ssize_t k = 0; k < got; ++k) {
+            // classify each line by its first field
+            if (lineStart) prefix.clear();
+            lineStart = buffer[k] == '\n';
+            if (prefix.size() < 6 && !lineStart) {
+                prefix += buffer[k];
+                if (prefix == "error\t") ok = false;
+            }
+        }
+        if (!writeAll(outFd, buffer, static_cast<std::size_t>(got))) ok = false;
+    }
+    return ok;
+}
+
+} // namespace
+
+
+bool serveConnection(int inFd, int outFd, ThreadPool& pool) {
+    FdReader reader(inFd);
+    ResponseQueue responses(outFd);
+    bool shutdown = false;
+    std::string line;
+    while (!shutdown && reader.readLine(line)) {
+        if (line.empty() || line == "\r") continue;
+        std::size_t ticket = responses.reserve();
+        std::size_t held = 0;
+        bool holding = false;
+        // a request that cannot be served, down to running out of memory,
+        // gets an error instead of taking the server down; the rest of the
+        // connection is dropped, as its input may be out of step
+        try {
+            ServerRequest request;
+            std::string error;
+            if (!parseServerRequest(line, request, error)) {
+                responses.complete(ticket, "error\t" + error);
+                // the image bytes of a rejected inline request are skipped;
+                // without a valid count they cannot be told apart from the
+                // requests that follow, and the connection ends
+                if (request.kind == ServerRequest::Kind::Inline) {
+                    if (!reader.skipBytes(request.inlineBytes)) break;
+                } else if (splitFields(line)[0] == "inline") {
+                    break;
+                }
+                continue;
+            }
+
+            std::vector<char> bytes;
+            switch (request.kind) {
+            case ServerRequest::Kind::Ping:
+                responses.complete(ticket, "ok\tpong");
+                continue;
+            case ServerRequest::Kind::Shutdown:
+                responses.complete(ticket, "ok\tshutdown");
+                shutdown = true;
+                continue;
+            case ServerRequest::Kind::Inline:
+            case ServerRequest::Kind::Convert:
+                break;
+            }
+
+            // waits for earlier requests, of any connection, to be answered
+            held = request.inlineBytes;
+            inFlight.acquire(held);
+            holding = true;
+            if (request.kind == ServerRequest::Kind::Inline && !reader.readBytes(request.inlineBytes, bytes)) {
+                inFlight.release(held);
+                responses.complete(ticket, "error\tTruncated inline image");
+                continue;
+            }
+
+            pool.submit([&responses, &pool, ticket, held, request, bytes = std::move(bytes)] {
+                std::string response;
+                try {
+                    response = convertRequest(request, bytes, pool);
+                } catch (const std::exception& e) {
+                    response = std::string("error\tRequest failed: ") + e.what();
+                }
+                responses.complete(ticket, std::move(response));
+                inFlight.release(held);
+            });
+        } catch (const std::exception& e) {
+            if (holding) inFlight.release(held);
+            responses.complete(ticket, std::string("error\tRequest failed: ") + e.what());
+            break;
+        }
+    }
+    responses.drain();
+    return shutdown;
+}
+
+
+bool serveUnixSocket(const std::string& socketPath, ThreadPool& pool) {
+    sockaddr_un address{};
+    if (socketPath.size() >= sizeof(address.sun_path)) return false;
+    address.sun_family = AF_UNIX;
+    std::memcpy(address.sun_path, socketPath.c_str(), socketPath.size() + 1);
+
+    // clients that disconnect early must not kill the server
+    std::signal(SIGPIPE, SIG_IGN);
+    int listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listenFd < 0) return false;
+    ::unlink(socketPath.c_str());
+    if (::bind(listenFd, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) != 0 ||
+        ::listen(listenFd, 64) != 0) {
+        ::close(listenFd);
+        return false;
+    }
+
+    std::atomic<bool> stopping{false};
+    std::mutex mutex;
+    std::condition_variable finished;
+    std::size_t active = 0;
+
+    while (!stopping.load()) {
+        int client = ::accept(listenFd, nullptr, nullptr);
+        if (client < 0) {
+            if (errno == EINTR || errno == ECONNABORTED) continue;
+            break;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            ++active;
+        }
+        std::thread([&, client] {
+            if (serveConnection(client, client, pool)) {
+                stopping.store(true);
+                // wakes the accept() above
+                ::shutdown(listenFd, SHUT_RDWR);
+            }
+            ::close(client);
+            std::lock_guard<std::mutex> lock(mutex);
+            if (--active == 0) finished.notify_all();
+        }).detach();
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    finished.wait(lock, [&] { return active == 0; });
+    ::close(listenFd);
+    ::unlink(socketPath.c_str());
+    return true;
+}
+
+
+bool runClient(const std::string& socketPath, const std::string& requests, int outFd) {
+    std::signal(SIGPIPE, SIG_IGN);
+    int fd = connectTo(socketPath);
+    if (fd < 0) return false;
+    bool sent = writeAll(fd, requests.data(), requests.size());
+    ::shutdown(fd, SHUT_WR);
+    bool ok = copyResponses(fd, outFd);
+    ::close(fd);
+    return sent && ok;
+}
+
+
+bool runClient(const std::string& socketPath, int inFd, int outFd) {
+    std::signal(SIGPIPE, SIG_IGN);
+    int fd = connectTo(socketPath);
+    if (fd < 0) return false;
+
+    // requests stream in while the responses come back
+    bool sent = true;
+    std::thread sender([&] {
+        char buffer[64 << 10];
+        for (;;) {
+            ssize_t got = ::read(inFd, buffer, sizeof(buffer));
+            if (got < 0 && errno == EINTR) continue;
+            if (got < 0) sent = false;
+            if (got <= 0) break;
+            if (!writeAll(fd, buffer, static_cast<std::size_t>(got))) {
+                sent = false;
+                break;
+            }
+        }
+        ::shutdown(fd, SHUT_WR);
+    });
+    bool ok = copyResponses(fd, outFd);
+    sender.join();
+    ::close(fd);
+    return sent && ok;
+}
+
+#else
+
+bool serveConnection(int, int, ThreadPool&) {
+    return false;
+}
+
+bool serveUnixSocket(const std::string&, ThreadPool&) {
+    return false;
+}
+
+bool runClient(const std::string&, const std::string&, int) {
+    return false;
+}
+
+bool runClient(const std::string&, int, int) {
+    return false;
+}
+
+#endif
@@ -0,0 +1,107 @@
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <numeric>
+#include "sharding.hpp"
+
+namespace fs = std::filesystem;
+
+
+std::vector<int> assignShards(const std::vector<std::pair<std::uint64_t, std::string>>& files, int shardCount) {
+    std::vector<int> shards(files.size(), 0);
+    if (shardCount <= 1) return shards;
+
+    std::vector<std::size_t> order(files.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::sort(order.begin(), order.end(), [&](std::size_t a, std::size_t b) {
+        if (files[a].first != files[b].first) return files[a].first > files[b].first;
+        return files[a].second < files[b].second;
+    });
+
+    std::vector<std::uint64_t> load(static_cast<std::size_t>(shardCount), 0);
+    for (std::size_t k : order) {
+        // least loaded shard; min_element keeps the lowest index on ties
+        auto lightest = std::min_element(load.begin(), load.end());
+        *lightest += files[k].first;
+        shards[k] = static_cast<int>(lightest - load.begin());
+    }
+    return shards;
+}
+
+
+std::string shardSummaryName(int index, int count) {
+    return "shard-" + std::to_string(index) + "-of-" + std::to_string(count) + ".summary";
+}
+
+
+bool writeShardSummary(const std::string& filename, const ShardSummary& summary) {
+    std::ofstream out(filename);
+    if (!out) return false;
+    out << "shard_index " << summary.index << "\n"
+        << "shard_count " << summary.count << "\n"
+        << "images " << summary.images << "\n"
+        << "failed " << summary.failed << "\n"
+        << "skipped " << summary.skipped << "\n"
+        << "input_bytes " << summary.inputBytes << "\n"
+        << "wall_seconds " << summary.wallSeconds << "\n";
+    out.close();
+    return static_cast<bool>(out);
+}
+
+
+bool readShardSummary(const std::string& filename, ShardSummary& summary) {
+    std::ifstream in(filename);
+    if (!in) return false;
+
+    summary = ShardSummary();
+    int fields = 0;
+    std::string key;
+    while (in >> key) {
+        if (key == "shard_index") in >> summary.index;
+        else if (key == "shard_count") in >> summary.count;
+        else if (key == "images") in >> summary.images;
+        else if (key == "failed") in >> summary.failed;
+        else if (key == "skipped") in >> summary.skipped;
+        else if (key == "input_bytes") in >> summary.inputBytes;
+        else if (key == "wall_seconds") in >> summary.wallSeconds;
+        else return false;
+        if (!in) return false;
+        ++fields;
+    }
+    return fields == 7 && summary.count >= 1 && summary.index >= 0 && summary.index < summary.count;
+}
+
+
+bool mergeShardSummaries(const std::string& folder, ShardSummary& total, std::vector<int>& missing) {
+    total = ShardSummary();
+    missing.clear();
+
+    std::vector<bool> seen;
+    std::error_code ec;
+    for (const auto& entry : fs::directory_iterator(folder, ec)) {
+        std::string name = entry.path().filename().string();
+        if (name.rfind("shard-", 0) != 0 || entry.path().extension() != ".summary") continue;
+
+        ShardSummary summary;
+        if (!readShardSummary(entry.path().string(), summary)) return false;
+        if (name != shardSummaryName(summary.index, summary.count)) return false;
+        if (seen.empty()) {
+            seen.assign(static_cast<std::size_t>(summary.count), false);
+            total.count = summary.count;
+        } else if (summary.count != total.count) {
+            return false;  // left over from a run with another shard count
+        }
+
+        seen[static_cast<std::size_t>(summary.index)] = true;
+        total.images += summary.images;
+        total.failed += summary.failed;
+        total.skipped += summary.skipped;
+        total.inputBytes += summary.inputBytes;
+        total.wallSeconds = std::max(total.wallSeconds, summary.wallSeconds);
+    }
+    if (ec || seen.empty()) return false;
+
+    for (std::size_t i = 0; i < seen.size(); ++i)
+        if (!seen[i]) missing.push_back(static_cast<int>(i));
+    return true;
+}
@@ -0,0 +1,156 @@
+#include <algorithm>
+#include <fstream>
+#include "stats.hpp"
+#include "json.hpp"
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/resource.h>
+#define STATS_HAS_RUSAGE 1
+#endif
+
+
+namespace {
+
+struct Totals {
+    PhaseTimes times;
+    std::uint64_t inputBytes = 0;
+    std::uint64_t outputBytes = 0;
+    std::uint64_t pixels = 0;
+    std::size_t failed = 0;
+    std::size_t skipped = 0;
+};
+
+Totals sum(const std::vector<ImageStats>& images) {
+    Totals totals;
+    for (const ImageStats& image : images) {
+        totals.times.read += image.times.read;
+        totals.times.convert += image.times.convert;
+        totals.times.write += image.times.write;
+        totals.inputBytes += image.inputBytes;
+        totals.outputBytes += image.outputBytes;
+        totals.pixels += image.pixels;
+        if (!image.ok) ++totals.failed;
+        if (image.skipped) ++totals.skipped;
+    }
+    return totals;
+}
+
+// CSV field, quoted only when it contains a separator, quote or line break
+std::string csvField(const std::string& text) {
+    if (text.find_first_of(",\"\r\n") == std::string::npos) return text;
+    std::string out = "\"";
+    for (char c : text) {
+        if (c == '"') out += '"';
+        out += c;
+    }
+    return out + "\"";
+}
+
+double rate(double amount, double seconds) {
+    return seconds > 0 ? amount / seconds : 0;
+}
+
+} // namespace
+
+
+void StatsCollector::add(ImageStats image) {
+    std::lock_guard<std::mutex> lock(mutex_);
+    images_.push_back(std::move(image));
+}
+
+
+std::vector<ImageStats> StatsCollector::sortedImages() const {
+    std::vector<ImageStats> images;
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        images = images_;
+    }
+    std::sort(images.begin(), images.end(),
+              [](const ImageStats& a, const ImageStats& b) { return a.input < b.input; });
+    return images;
+}
+
+
+void StatsCollector::writeJson(std::ostream& out) const {
+    std::vector<ImageStats> images = sortedImages();
+    Totals totals = sum(images);
+
+    out << "{\n  \"mode\": " << jsonQuoted(mode) << ",\n  \"threads\": " << threads << ",\n  \"methods\": [";
+    for (std::size_t m = 0; m < methods.size(); ++m)
+        out << (m ? ", " : "") << jsonQuoted(methods[m]);
+    out << "],\n"
+        << "  \"images\": " << images.size() << ",\n"
+        << "  \"failed\": " << totals.failed << ",\n"
+        << "  \"skipped\": " << totals.skipped << ",\n"
+        << "  \"wall_seconds\": " << wallSeconds << ",\n"
+        << "  \"scan_seconds\": " << scanSeconds << ",\n"
+        << "  \"read_seconds\": " << totals.times.read << ",\n"
+        << "  \"convert_seconds\": " << totals.times.convert << ",\n"
+        << "  \"write_seconds\": " << totals.times.write << ",\n"
+        << "  \"input_bytes\": " << totals.inputBytes << ",\n"
+        << "  \"output_bytes\": " << totals.outputBytes << ",\n"
+        << "  \"pixels\": " << totals.pixels << ",\n"
+        << "  \"pixels_per_second\": " << rate(static_cast<double>(totals.pixels), wallSeconds) << ",\n"
+        << "  \"input_bytes_per_second\": " << rate(static_cast<double>(totals.inputBytes), wallSeconds) << ",\n"
+        << "  \"peak_rss_bytes\": " << peakRssBytes() << ",\n"
+        << "  \"per_image\": [";
+    for (std::size_t k = 0; k < images.size(); ++k) {
+        const ImageStats& image = images[k];
+        out << (k ? "," : "") << "\n    {\"input\": " << jsonQuoted(image.input)
+            << ", \"ok\": " << (image.ok ? "true" : "false")
+            << ", \"skipped\": " << (image.skipped ? "true" : "false")
+            << ", \"read_seconds\": " << image.times.read
+            << ", \"convert_seconds\": " << image.times.convert
+            << ", \"write_seconds\": " << image.times.write
+            << ", \"input_bytes\": " << image.inputBytes
+            << ", \"output_bytes\": " << image.outputBytes
+            << ", \"pixels\": " << image.pixels << "}";
+    }
+    out << (images.empty() ? "]\n}\n" : "\n  ]\n}\n");
+}
+
+
+void StatsCollector::writeCsv(std::ostream& out) const {
+    std::vector<ImageStats> images = sortedImages();
+    Totals totals = sum(images);
+
+    out << "input,ok,skipped,read_seconds,convert_seconds,write_seconds,input_bytes,output_bytes,pixels,"
+           "scan_seconds,wall_seconds,peak_rss_bytes\n";
+    for (const ImageStats& image : images) {
+        out << csvField(image.input) << "," << (image.ok ? 1 : 0) << "," << (image.skipped ? 1 : 0) << ","
+            << image.times.read << ","
+            << image.times.convert << "," << image.times.write << "," << image.inputBytes << ","
+            << image.outputBytes << "," << image.pixels << ",,,\n";
+    }
+    out << "TOTAL," << images.size() - totals.failed << "," << totals.skipped << "," << totals.times.read << "," << totals.times.convert
+        << "," << totals.times.write << "," << totals.inputBytes << "," << totals.outputBytes << ","
+        << totals.pixels << "," << scanSeconds << "," << wallSeconds << "," << peakRssBytes() << "\n";
+}
+
+
+bool StatsCollector::write(const std::string& filename) const {
+    std::ofstream out(filename);
+    if (!out) return false;
+    bool csv = filename.size() >= 4 && filename.compare(filename.size() - 4, 4, ".csv") == 0;
+    if (csv)
+        writeCsv(out);
+    else
+        writeJson(out);
+    out.close();
+    return static_cast<bool>(out);
+}
+
+
+std::uint64_t peakRssBytes() {
+#ifdef STATS_HAS_RUSAGE
+    struct rusage usage;
+    if (getrusage(RUSAGE_SELF, &usage) != 0) return 0;
+#ifdef __APPLE__
+    return static_cast<std::uint64_t>(usage.ru_maxrss);         // bytes
+#else
+    return static_cast<std::uint64_t>(usage.ru_maxrss) * 1024;  // kilobytes
+#endif
+#else
+    return 0;
+#endif
+}
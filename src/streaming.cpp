@@ -0,0 +1,47 @@
+#include "streaming.hpp"
+
+
+bool convertPPMStream(std::istream& in, const std::vector<GrayscaleMethod>& methods,
+                      const std::vector<std::ostream*>& outputs, PnmEncoding encoding,
+                      int bandRows, ThreadPool* pool, ImageStats* stats) {
+    if (methods.size() != outputs.size() || bandRows < 1) return false;
+
+    PhaseTimes unused;
+    PhaseTimes& phases = stats ? stats->times : unused;
+    const bool timed = stats != nullptr;
+
+    PpmStreamReader reader(in);
+    {
+        PhaseTimer timer(timed, phases.read);
+        if (!reader.readHeader()) return false;
+    }
+    const PnmHeader& header = reader.header();
+    if (stats) stats->pixels = static_cast<std::uint64_t>(header.width) * header.height;
+
+    std::vector<PgmStreamWriter> writers;
+    writers.reserve(outputs.size());
+    for (std::ostream* out : outputs)
+        writers.emplace_back(*out, header.width, header.height, encoding);
+
+    RgbImage band;
+    std::vector<GrayImage> grayBands;
+    while (reader.rowsRemaining() > 0) {
+        {
+            PhaseTimer timer(timed, phases.read);
+            if (!reader.readRows(bandRows, band)) return false;
+        }
+        {
+            PhaseTimer timer(timed, phases.convert);
+            convertToGrayscale(band.view(), methods, grayBands, pool);
+        }
+        PhaseTimer timer(timed, phases.write);
+        for (std::size_t m = 0; m < writers.size(); ++m)
+            if (!writers[m].writeRows(grayBands[m].view())) return false;
+    }
+
+    PhaseTimer timer(timed, phases.write);
+    bool ok = true;
+    for (PgmStreamWriter& writer : writers)
+        ok = writer.finish() && ok;
+    return ok;
+}
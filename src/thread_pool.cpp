@@ -0,0 +1,150 @@
+#include <algorithm>
+#include "thread_pool.hpp"
+
+
+namespace {
+
+// pool and worker index of the current thread (currentPool is null outside any pool)
+thread_local const ThreadPool* currentPool = nullptr;
+thread_local unsigned currentWorker = 0;
+
+} // namespace
+
+
+ThreadPool::ThreadPool(unsigned threads) {
+    if (threads == 0) threads = std::thread::hardware_concurrency();
+    if (threads == 0) threads = 1;
+
+    for (unsigned i = 0; i < threads; ++i)
+        queues_.push_back(std::make_unique<WorkerQueue>());
+    for (unsigned i = 0; i < threads; ++i)
+        threads_.emplace_back(&ThreadPool::workerLoop, this, i);
+}
+
+
+ThreadPool::~ThreadPool() {
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        stopping_ = true;
+    }
+    wakeWorkers_.notify_all();
+    for (std::thread& thread : threads_)
+        thread.join();
+}
+
+
+void ThreadPool::submit(std::function<void()> task) {
+    unsigned index = currentPool == this ? currentWorker
+                                         : nextQueue_.fetch_add(1, std::memory_order_relaxed) % size();
+    unfinished_.fetch_add(1);
+    {
+        std::lock_guard<std::mutex> lock(queues_[index]->mutex);
+        queues_[index]->tasks.push_back(std::move(task));
+        queued_.fetch_add(1);
+    }
+    {
+        // a worker that checked queued_ before the increment is now blocked
+        // in wait() and will receive the notification
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+    }
+    wakeWorkers_.notify_one();
+}
+
+
+void ThreadPool::wait() {
+    std::function<void()> task;
+    unsigned start = currentPool == this ? currentWorker : 0;
+    while (unfinished_.load() != 0) {
+        if (popTask(start, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        allDone_.wait(lock, [this] { return unfinished_.load() == 0 || queued_.load() != 0; });
+    }
+}
+
+
+void ThreadPool::parallelFor(std::size_t count, const std::function<void(std::size_t)>& body) {
+    std::atomic<std::size_t> next{0};
+    auto runIndices = [&] {
+        for (std::size_t i = next.fetch_add(1); i < count; i = next.fetch_add(1))
+            body(i);
+    };
+
+    // the caller takes part, so one helper task fewer than workers is enough
+    std::size_t helpers = count > 1 ? std::min<std::size_t>(count, size()) - 1 : 0;
+    std::atomic<std::size_t> runningHelpers{helpers};
+    for (std::size_t h = 0; h < helpers; ++h) {
+        submit([&] {
+            runIndices();
+            runningHelpers.fetch_sub(1, std::memory_order_release);
+        });
+    }
+    runIndices();
+
+    // helpers still queued or running: execute pending tasks meanwhile
+    std::function<void()> task;
+    unsigned start = currentPool == this ? currentWorker : 0;
+    while (runningHelpers.load(std::memory_order_acquire) != 0) {
+        if (popTask(start, task))
+            runTask(task);
+        else
+            std::this_thread::yield();
+    }
+}
+
+
+bool ThreadPool::popTask(unsigned index, std::function<void()>& task) {
+    // own work first (newest task, still warm in cache)
+    {
+        WorkerQueue& own = *queues_[index];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.tasks.empty()) {
+            task = std::move(own.tasks.back());
+            own.tasks.pop_back();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    // then steal the oldest task of another worker
+    for (unsigned k = 1; k < size(); ++k) {
+        WorkerQueue& victim = *queues_[(index + k) % size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.tasks.empty()) {
+            task = std::move(victim.tasks.front());
+            victim.tasks.pop_front();
+            queued_.fetch_sub(1);
+            return true;
+        }
+    }
+    return false;
+}
+
+
+void ThreadPool::runTask(std::function<void()>& task) {
+    task();
+    task = nullptr;
+    if (unfinished_.fetch_sub(1) == 1) {
+        std::lock_guard<std::mutex> lock(sleepMutex_);
+        allDone_.notify_all();
+    }
+}
+
+
+void ThreadPool::workerLoop(unsigned index) {
+    currentPool = this;
+    currentWorker = index;
+
+    std::function<void()> task;
+    for (;;) {
+        if (popTask(index, task)) {
+            runTask(task);
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex_);
+        wakeWorkers_.wait(lock, [this] { return stopping_ || queued_.load() != 0; });
+        if (stopping_ && queued_.load() == 0) return;
+    }
+}
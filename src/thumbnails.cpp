@@ -0,0 +1,169 @@
+#include <algorithm>
+#include <cstdlib>
+#include "thumbnails.hpp"
+
+
+namespace {
+
+// Adds horizontal pairs of `row` into `sums`, the last value alone when the
+// width is odd.
+template <typename T>
+void addPairs(const T* row, int width, std::uint32_t* sums) {
+    int x = 0;
+    for (; x + 1 < width; x += 2) sums[x / 2] += static_cast<std::uint32_t>(row[x]) + row[x + 1];
+    if (x < width) sums[x / 2] += row[x];
+}
+
+// Row y of level `level` from its sums: each divided by the number of image
+// pixels in its square, which is smaller along the right and bottom edges.
+void emitRow(const std::uint32_t* sums, int level, int y, const GrayImage& image, GrayImage& target) {
+    int side = 1 << level;
+    std::uint32_t rows = static_cast<std::uint32_t>(std::min(side, image.height - y * side));
+    std::uint8_t* out = target.row(y);
+    for (int x = 0; x < target.width; ++x) {
+        std::uint32_t count = rows * static_cast<std::uint32_t>(std::min(side, image.width - x * side));
+        out[x] = static_cast<std::uint8_t>((sums[x] + count / 2) / count);
+    }
+}
+
+// Whole decimal number in [1, limit].
+bool parseCount(const std::string& text, long limit, int& value) {
+    if (text.empty() || text.find_first_not_of("0123456789") != std::string::npos || text.size() > 9) return false;
+    long parsed = std::strtol(text.c_str(), nullptr, 10);
+    if (parsed < 1 || parsed > limit) return false;
+    value = static_cast<int>(parsed);
+    return true;
+}
+
+} // namespace
+
+
+std::string ThumbnailSpec::suffix() const {
+    return width > 0 ? "w" + std::to_string(width) : "1-" + std::to_string(1 << shift);
+}
+
+
+bool parseThumbnailSpecs(const std::string& list, std::vector<ThumbnailSpec>& specs, std::string& error) {
+    specs.clear();
+    std::size_t start = 0;
+    while (start <= list.size()) {
+        std::size_t end = std::min(list.find(',', start), list.size());
+        std::string token = list.substr(start, end - start);
+        ThumbnailSpec spec;
+        int value = 0;
+        if (token.size() > 1 && token[0] == 'w' && parseCount(token.substr(1), 1 << 20, value)) {
+            spec.width = value;
+        } else if (token.compare(0, 2, "1/") == 0 && parseCount(token.substr(2), 1 << maxThumbnailShift, value) &&
+                   value > 1 && (value & (value - 1)) == 0) {
+            while ((1 << spec.shift) < value) ++spec.shift;
+        } else {
+            error = "Invalid thumbnail: " + token + " (expected 1/2, 1/4, ... 1/" +
+                    std::to_string(1 << maxThumbnailShift) + " or w<width>)";
+            return false;
+        }
+        bool duplicate = std::any_of(specs.begin(), specs.end(), [&](const ThumbnailSpec& other) {
+            return other.shift == spec.shift && other.width == spec.width;
+        });
+        if (!duplicate) specs.push_back(spec);
+        start = end + 1;
+    }
+    return true;
+}
+
+
+void thumbnailSize(const ThumbnailSpec& spec, int width, int height, int& thumbnailWidth, int& thumbnailHeight) {
+    if (spec.width == 0) {
+        thumbnailWidth = mipExtent(width, spec.shift);
+        thumbnailHeight = mipExtent(height, spec.shift);
+        return;
+    }
+    if (width <= 0 || height <= 0) {
+        thumbnailWidth = thumbnailHeight = 0;
+        return;
+    }
+    thumbnailWidth = std::min(spec.width, width);
+    long long scaled = (static_cast<long long>(height) * thumbnailWidth + width / 2) / width;
+    thumbnailHeight = static_cast<int>(std::max(1LL, scaled));
+}
+
+
+int thumbnailLevel(const ThumbnailSpec& spec, int width, int height) {
+    if (spec.width == 0) return spec.shift;
+    int thumbnailWidth = 0;
+    int thumbnailHeight = 0;
+    thumbnailSize(spec, width, height, thumbnailWidth, thumbnailHeight);
+    int level = 0;
+    while (level < maxThumbnailShift && mipExtent(width, level + 1) >= thumbnailWidth &&
+           mipExtent(height, level + 1) >= thumbnailHeight)
+        ++level;
+    return level;
+}
+
+
+void addMipRows(const GrayImage& image, int first, int rows, int levels, GrayImage* const* targets) {
+    levels = std::min(levels, maxThumbnailShift);
+    if (levels <= 0 || rows <= 0) return;
+
+    // one row of sums per level, filled from two rows of the level below;
+    // never shared with the pool, so a thread's scratch is never reentered
+    thread_local std::vector<std::uint32_t> scratch;
+    std::size_t offsets[maxThumbnailShift + 2] = {};
+    for (int l = 1; l <= levels; ++l)
+        offsets[l + 1] = offsets[l] + static_cast<std::size_t>(mipExtent(image.width, l));
+    scratch.assign(offsets[levels + 1], 0);
+    int pending[maxThumbnailShift + 2] = {};
+
+    for (int y = first; y < first + rows; ++y) {
+        addPairs(image.row(y), image.width, scratch.data() + offsets[1]);
+        ++pending[1];
+        // a level is complete after two rows of the level below, or at the
+        // bottom of the image
+        bool bottom = y == image.height - 1;
+        for (int l = 1; l <= levels && (pending[l] == 2 || bottom); ++l) {
+            std::uint32_t* sums = scratch.data() + offsets[l];
+            int width = mipExtent(image.width, l);
+            if (targets[l - 1]) emitRow(sums, l, y >> l, image, *targets[l - 1]);
+            if (l < levels) {
+                addPairs(sums, width, scratch.data() + offsets[l + 1]);
+                ++pending[l + 1];
+            }
+            std::fill(sums, sums + width, 0);
+            pending[l] = 0;
+        }
+    }
+}
+
+
+void resampleArea(const GrayImage& source, GrayImage& target) {
+    if (source.empty() || target.empty()) return;
+    // target pixel x spans [x * sw, (x + 1) * sw) in units of 1/tw source
+    // pixels, source pixel x spans [x * tw, (x + 1) * tw); likewise for rows.
+    // Overlaps are exact integers, so the weights of a pixel sum to sw * sh.
+    auto sw = static_cast<std::uint64_t>(source.width);
+    auto sh = static_cast<std::uint64_t>(source.height);
+    auto tw = static_cast<std::uint64_t>(target.width);
+    auto th = static_cast<std::uint64_t>(target.height);
+    std::uint64_t divisor = sw * sh;
+
+    thread_local std::vector<std::uint64_t> accumulator;
+    for (std::uint64_t ty = 0; ty < th; ++ty) {
+        accumulator.assign(target.width, 0);
+        std::uint64_t top = ty * sh;
+        std::uint64_t bottom = top + sh;
+        for (std::uint64_t sy = top / th; sy * th < bottom; ++sy) {
+            std::uint64_t rowWeight = std::min(bottom, (sy + 1) * th) - std::max(top, sy * th);
+            const std::uint8_t* row = source.row(static_cast<int>(sy));
+            for (std::uint64_t tx = 0; tx < tw; ++tx) {
+                std::uint64_t left = tx * sw;
+                std::uint64_t right = left + sw;
+                std::uint64_t sum = 0;
+                for (std::uint64_t sx = left / tw; sx * tw < right; ++sx)
+                    sum += row[sx] * (std::min(right, (sx + 1) * tw) - std::max(left, sx * tw));
+                accumulator[tx] += sum * rowWeight;
+            }
+        }
+        std::uint8_t* out = target.row(static_cast<int>(ty));
+        for (std::uint64_t tx = 0; tx < tw; ++tx)
+            out[tx] = static_cast<std::uint8_t>((accumulator[tx] + divisor / 2) / divisor);
+    }
+}
@@ -0,0 +1,115 @@
+#include "archive.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+RgbImage makeRgb(int width, int height, int seed) {
+    RgbImage image(width, height);
+    for (size_t k = 0; k < image.data.size(); k++)
+        image.data[k] = static_cast<std::uint8_t>(k * 7 + seed);
+    return image;
+}
+
+} // namespace
+
+TEST(ArchiveTest, RoundTripInSlotOrder) {
+    std::string path = (fs::path(testing::TempDir()) / "round_trip.gpak").string();
+    RgbImage first = makeRgb(5, 3, 1);
+    RgbImage second = makeRgb(64, 2, 9);
+    GrayImage gray(3, 4);
+    for (size_t k = 0; k < gray.data.size(); k++)
+        gray.data[k] = static_cast<std::uint8_t>(255 - k);
+
+    // a strided view: only the left 2 columns of `second`
+    RgbView narrow = {second.data.data(), 2, 2, second.stride};
+
+    ArchiveWriter writer;
+    ASSERT_TRUE(writer.create(path, 5));
+    // added out of order, slot 3 left empty
+    ASSERT_TRUE(writer.add(4, "narrow.ppm", narrow, 200));
+    ASSERT_TRUE(writer.add(0, "first.ppm", first.view()));
+    ASSERT_TRUE(writer.add(2, "lightness/gray.pgm", gray.view()));
+    ASSERT_TRUE(writer.add(1, "second.ppm", second.view()));
+    EXPECT_FALSE(writer.add(1, "again.ppm", second.view()));
+    EXPECT_FALSE(writer.add(5, "outside.ppm", second.view()));
+    EXPECT_FALSE(writer.add(3, std::string(archiveMaxNameLength + 1, 'x'), second.view()));
+    ASSERT_TRUE(writer.finish());
+
+    ArchiveReader reader;
+    ASSERT_TRUE(reader.open(path));
+    ASSERT_EQ(reader.entries().size(), 4u);
+    EXPECT_EQ(reader.entries()[0].name, "first.ppm");
+    EXPECT_EQ(reader.entries()[1].name, "second.ppm");
+    EXPECT_EQ(reader.entries()[2].name, "lightness/gray.pgm");
+    EXPECT_EQ(reader.entries()[3].name, "narrow.ppm");
+
+    for (const ArchiveEntry& entry : reader.entries())
+        EXPECT_EQ(entry.offset % 64, 0u) << entry.name;
+
+    const ArchiveEntry* entry = reader.find("first.ppm");
+    ASSERT_NE(entry, nullptr);
+    RgbView view = reader.rgb(*entry);
+    ASSERT_EQ(view.width, 5);
+    ASSERT_EQ(view.height, 3);
+    EXPECT_EQ(std::vector<std::uint8_t>(view.data, view.data + 45), first.data);
+
+    entry = reader.find("narrow.ppm");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->maxVal, 200);
+    view = reader.rgb(*entry);
+    for (int i = 0; i < 2; i++)
+        EXPECT_EQ(std::vector<std::uint8_t>(view.row(i), view.row(i) + 6),
+                  std::vector<std::uint8_t>(second.row(i), second.row(i) + 6));
+
+    entry = reader.find("lightness/gray.pgm");
+    ASSERT_NE(entry, nullptr);
+    EXPECT_EQ(entry->channels, 1);
+    GrayView grayView = reader.gray(*entry);
+    EXPECT_EQ(std::vector<std::uint8_t>(grayView.data, grayView.data + 12), gray.data);
+
+    EXPECT_EQ(reader.find("missing.ppm"), nullptr);
+}
+
+TEST(ArchiveTest, RejectsCorruptArchives) {
+    std::string path = (fs::path(testing::TempDir()) / "corrupt.gpak").string();
+    RgbImage image = makeRgb(8, 8, 3);
+    ArchiveWriter writer;
+    ASSERT_TRUE(writer.create(path, 1));
+    ASSERT_TRUE(writer.add(0, "image.ppm", image.view()));
+    ASSERT_TRUE(writer.finish());
+
+    std::string bytes;
+    {
+        std::ifstream in(path, std::ios::binary);
+        bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    auto rejects = [&](const std::string& contents) {
+        std::ofstream(path, std::ios::binary | std::ios::trunc) << contents;
+        ArchiveReader reader;
+        return !reader.open(path);
+    };
+
+    EXPECT_FALSE(rejects(bytes));
+    EXPECT_TRUE(rejects(bytes.substr(0, bytes.size() - 1)));  // payload cut short
+    std::string badMagic = bytes;
+    badMagic[0] = 'X';
+    EXPECT_TRUE(rejects(badMagic));
+    std::string badSize = bytes;
+    badSize[64 + 112] = 9;  // width no longer matches the payload size
+    EXPECT_TRUE(rejects(badSize));
+    EXPECT_TRUE(rejects(bytes.substr(0, 100)));  // index cut short
+}
+
+TEST(ArchiveTest, RecognizesArchivePaths) {
+    EXPECT_TRUE(isArchivePath("images.gpak"));
+    EXPECT_TRUE(isArchivePath("out/run.gpak"));
+    EXPECT_FALSE(isArchivePath(".gpak"));
+    EXPECT_FALSE(isArchivePath("images"));
+    EXPECT_FALSE(isArchivePath("images.gpak/"));
+}
@@ -0,0 +1,108 @@
+#include "dataset.hpp"
+#include "ppm_io.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <string>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+RgbImage generate(const DatasetSpec& spec, std::size_t index, int first, int rows) {
+    int width = 0;
+    int height = 0;
+    datasetImageSize(spec, index, width, height);
+    RgbImage band;
+    band.resize(width, rows);
+    generateDatasetRows(spec, index, first, band);
+    return band;
+}
+
+} // namespace
+
+TEST(DatasetTest, ParsesSizes) {
+    DatasetSpec spec;
+    ASSERT_TRUE(parseDatasetSizes("640x480", spec));
+    EXPECT_EQ(spec.minWidth, 640);
+    EXPECT_EQ(spec.maxHeight, 480);
+    ASSERT_TRUE(parseDatasetSizes("16x8-32768x32768", spec));
+    EXPECT_EQ(spec.minHeight, 8);
+    EXPECT_EQ(spec.maxWidth, 32768);
+    for (const char* bad : {"", "640", "x480", "640x", "0x5", "5x-1", "64x64-32x32", "1x1-2x2-3x3", "9999999x1"})
+        EXPECT_FALSE(parseDatasetSizes(bad, spec)) << bad;
+    EXPECT_EQ(datasetImageName(0), "image_000001.ppm");
+    EXPECT_EQ(datasetImageName(41), "image_000042.ppm");
+}
+
+TEST(DatasetTest, SizesStayInRange) {
+    DatasetSpec spec;
+    ASSERT_TRUE(parseDatasetSizes("16x10-4096x2560", spec));
+    for (SizeDistribution distribution : {SizeDistribution::Uniform, SizeDistribution::LogUniform}) {
+        spec.distribution = distribution;
+        int small = 0;
+        for (std::size_t k = 0; k < 1000; k++) {
+            int width = 0;
+            int height = 0;
+            datasetImageSize(spec, k, width, height);
+            EXPECT_GE(width, 16);
+            EXPECT_LE(width, 4096);
+            EXPECT_GE(height, 10);
+            EXPECT_LE(height, 2560);
+            if (width < 256) small++;
+        }
+        // 256 is 1/16 of the way on a linear scale and half of it on a log one
+        if (distribution == SizeDistribution::Uniform) EXPECT_LT(small, 150);
+        else EXPECT_GT(small, 400);
+    }
+    spec.distribution = SizeDistribution::Fixed;
+    int width = 0;
+    int height = 0;
+    datasetImageSize(spec, 7, width, height);
+    EXPECT_EQ(width, 16);
+    EXPECT_EQ(height, 10);
+}
+
+TEST(DatasetTest, ReproducibleByBand) {
+    DatasetSpec spec;
+    ASSERT_TRUE(parseDatasetSizes("37x21", spec));
+    for (DatasetContent content : {DatasetContent::Noise, DatasetContent::Gradient}) {
+        spec.content = content;
+        RgbImage whole = generate(spec, 3, 0, 21);
+        // bands generated on their own, in any order, give the same rows
+        RgbImage bottom = generate(spec, 3, 13, 8);
+        RgbImage top = generate(spec, 3, 0, 13);
+        for (int i = 0; i < 21; i++) {
+            const std::uint8_t* row = i < 13 ? top.row(i) : bottom.row(i - 13);
+            EXPECT_TRUE(std::equal(row, row + 3 * 37, whole.row(i))) << i;
+        }
+        EXPECT_NE(generate(spec, 4, 0, 21).data, whole.data);
+        spec.seed++;
+        EXPECT_NE(generate(spec, 3, 0, 21).data, whole.data);
+        spec.seed--;
+    }
+}
+
+TEST(DatasetTest, WrittenImagesReadBack) {
+    DatasetSpec spec;
+    ASSERT_TRUE(parseDatasetSizes("3x2-1500x900", spec));
+    spec.distribution = SizeDistribution::LogUniform;
+    spec.content = DatasetContent::Gradient;
+    std::string path = (fs::path(testing::TempDir()) / "dataset.ppm").string();
+    for (PnmEncoding encoding : {PnmEncoding::Plain, PnmEncoding::Raw}) {
+        spec.encoding = encoding;
+        for (std::size_t k = 0; k < 4; k++) {
+            ASSERT_TRUE(writeDatasetImage(spec, k, path));
+            RgbImage image;
+            ASSERT_TRUE(readPPM(path, image));
+            int width = 0;
+            int height = 0;
+            datasetImageSize(spec, k, width, height);
+            RgbImage expected = generate(spec, k, 0, height);
+            ASSERT_EQ(image.width, width);
+            ASSERT_EQ(image.height, height);
+            for (int i = 0; i < height; i++)
+                ASSERT_TRUE(std::equal(image.row(i), image.row(i) + 3 * width, expected.row(i))) << k << " " << i;
+        }
+    }
+}
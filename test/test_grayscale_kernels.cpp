@@ -0,0 +1,149 @@
+#include "grayscale_kernels.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <random>
+#include <vector>
+
+namespace {
+
+const GrayscaleMethod allMethods[] = {
+    GrayscaleMethod::Lightness, GrayscaleMethod::Average, GrayscaleMethod::Luminosity,
+    GrayscaleMethod::RootMeanSquare, GrayscaleMethod::RedChannel,
+    GrayscaleMethod::GreenChannel, GrayscaleMethod::BlueChannel
+};
+
+std::vector<SimdLevel> availableLevels() {
+    std::vector<SimdLevel> levels;
+    for (SimdLevel level : {SimdLevel::Scalar, SimdLevel::Sse41, SimdLevel::Avx2, SimdLevel::Avx512})
+        if (level <= detectSimdLevel()) levels.push_back(level);
+    return levels;
+}
+
+// restores the detected level when a test changes it
+struct SimdLevelGuard {
+    ~SimdLevelGuard() { setSimdLevel(detectSimdLevel()); }
+};
+
+} // namespace
+
+
+// every vector kernel must be bit-exact with the scalar reference, including
+// the tails that are shorter than one vector
+TEST(GrayscaleKernelsTest, VectorKernelsMatchScalarReference) {
+    std::mt19937 rng(42);
+    std::uniform_int_distribution<int> sample(0, 255);
+
+    for (int width : {1, 15, 16, 17, 31, 32, 33, 63, 64, 65, 100, 129, 1000}) {
+        std::vector<std::uint8_t> rgb(3 * width);
+        for (auto& v : rgb) v = static_cast<std::uint8_t>(sample(rng));
+        // a few extreme pixels in every row
+        rgb[0] = rgb[1] = rgb[2] = 255;
+        if (width > 1) rgb[3] = rgb[4] = rgb[5] = 0;
+
+        for (GrayscaleMethod method : allMethods) {
+            std::vector<std::uint8_t> expected(width), result(width);
+            rowKernel(method, SimdLevel::Scalar)(rgb.data(), expected.data(), width);
+            for (SimdLevel level : availableLevels()) {
+                std::fill(result.begin(), result.end(), 0xCD);
+                rowKernel(method, level)(rgb.data(), result.data(), width);
+                EXPECT_EQ(result, expected) << simdLevelName(level) << " width " << width
+                                            << " method " << static_cast<int>(method);
+            }
+        }
+    }
+}
+
+// the pixels where Luminosity depends on double rounding (t % 100 == 0) and
+// the perfect squares of RootMeanSquare are the ones most likely to differ
+TEST(GrayscaleKernelsTest, VectorKernelsMatchOnRoundingEdgeCases) {
+    std::vector<std::uint8_t> rgb;
+    for (int R = 0; R < 256; R++)
+        for (int G = 0; G < 256; G++)
+            for (int B = 0; B < 256; B += 4)
+                if ((21 * R + 72 * G + 7 * B) % 100 == 0 || R == G || G == B)
+                    rgb.insert(rgb.end(), {static_cast<std::uint8_t>(R), static_cast<std::uint8_t>(G),
+                                           static_cast<std::uint8_t>(B)});
+    int width = static_cast<int>(rgb.size() / 3);
+
+    for (GrayscaleMethod method : {GrayscaleMethod::Luminosity, GrayscaleMethod::RootMeanSquare}) {
+        std::vector<std::uint8_t> expected(width), result(width);
+        rowKernel(method, SimdLevel::Scalar)(rgb.data(), expected.data(), width);
+        for (SimdLevel level : availableLevels()) {
+            rowKernel(method, level)(rgb.data(), result.data(), width);
+            EXPECT_EQ(result, expected) << simdLevelName(level);
+        }
+    }
+}
+
+TEST(GrayscaleKernelsTest, ConvertToGrayscaleUsesSelectedLevel) {
+    SimdLevelGuard guard;
+    RgbImage image(37, 5);
+    for (size_t k = 0; k < image.data.size(); k++)
+        image.data[k] = static_cast<std::uint8_t>(k * 97 + 13);
+
+    setSimdLevel(SimdLevel::Scalar);
+    EXPECT_EQ(activeSimdLevel(), SimdLevel::Scalar);
+    GrayImage expected;
+    convertToGrayscale(image, GrayscaleMethod::Luminosity, expected);
+
+    for (SimdLevel level : availableLevels()) {
+        EXPECT_EQ(setSimdLevel(level), level);
+        GrayImage result;
+        convertToGrayscale(image, GrayscaleMethod::Luminosity, result);
+        EXPECT_EQ(result.data, expected.data) << simdLevelName(level);
+    }
+
+    // requests above what the CPU supports are clamped
+    EXPECT_EQ(setSimdLevel(SimdLevel::Avx512), detectSimdLevel());
+}
+
+
+namespace {
+
+// the per-pixel formulas of the original convertToGrayscale implementation
+int originalGrayValue(GrayscaleMethod method, int R, int G, int B) {
+    switch (method) {
+        case GrayscaleMethod::Lightness: return (std::max({R, G, B}) + std::min({R, G, B})) / 2;
+        case GrayscaleMethod::Average: return (R + G + B) / 3;
+        case GrayscaleMethod::Luminosity: return static_cast<int>(0.21 * R + 0.72 * G + 0.07 * B);
+        case GrayscaleMethod::RootMeanSquare: return static_cast<int>(std::sqrt((R * R + G * G + B * B) / 3.0));
+        case GrayscaleMethod::RedChannel: return R;
+        case GrayscaleMethod::GreenChannel: return G;
+        case GrayscaleMethod::BlueChannel: return B;
+        default: return 0;
+    }
+}
+
+} // namespace
+
+
+// proves the fixed-point, lookup-table and vector kernels equivalent to the
+// original double formulas by checking every one of the 2^24 RGB triples
+TEST(GrayscaleKernelsTest, ExhaustiveMatchesOriginalFormulas) {
+    const int width = 1 << 24;
+    std::vector<std::uint8_t> rgb(3 * static_cast<size_t>(width));
+    for (int k = 0; k < width; k++) {
+        rgb[3 * static_cast<size_t>(k)] = static_cast<std::uint8_t>(k >> 16);
+        rgb[3 * static_cast<size_t>(k) + 1] = static_cast<std::uint8_t>(k >> 8);
+        rgb[3 * static_cast<size_t>(k) + 2] = static_cast<std::uint8_t>(k);
+    }
+
+    std::vector<std::uint8_t> expected(width), result(width);
+    for (GrayscaleMethod method : allMethods) {
+        for (int k = 0; k < width; k++)
+            expected[k] = static_cast<std::uint8_t>(originalGrayValue(method, k >> 16, (k >> 8) & 255, k & 255));
+
+        for (SimdLevel level : availableLevels()) {
+            rowKernel(method, level)(rgb.data(), result.data(), width);
+            auto mismatch = std::mismatch(result.begin(), result.end(), expected.begin());
+            if (mismatch.first != result.end()) {
+                long k = mismatch.first - result.begin();
+                ADD_FAILURE() << simdLevelName(level) << " method " << static_cast<int>(method)
+                              << " differs at RGB (" << (k >> 16) << ", " << ((k >> 8) & 255) << ", " << (k & 255)
+                              << "): " << int(*mismatch.first) << " != " << int(*mismatch.second);
+            }
+        }
+    }
+}
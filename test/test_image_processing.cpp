@@ -1,5 +1,7 @@
 #include "image_processing.hpp"
+#include "thread_pool.hpp"
 #include <gtest/gtest.h>
+#include <algorithm>
 
 TEST(GrayscaleTest, RedChannelConversion) {
     std::vector<std::vector<std::array<int, 3>>> image = {{{255, 0, 0}}};
@@ -364,4 +366,122 @@ TEST(GrayscaleTest, MultiplePixelsAndMethods) {
     EXPECT_EQ(result[1][0], 147); // Blue pixel (sqrt((0^2 + 0^2 + 255^2)/3)) => 147
     EXPECT_EQ(result[1][1], 208); // Yellow pixel (sqrt((255^2 + 255^2 + 0^2)/3)) => 208
 
-}
\ No newline at end of file
+}
+
+// flat image tests
+TEST(GrayscaleTest, FlatImageLayout) {
+    RgbImage image(3, 2);
+
+    // a tightly packed RGB image uses one contiguous buffer of width * height * 3 bytes
+    EXPECT_EQ(image.stride, 9u);
+    EXPECT_EQ(image.data.size(), 18u);
+    EXPECT_EQ(image.row(1), image.data.data() + 9);
+    EXPECT_EQ(image.pixel(1, 2), image.data.data() + 15);
+}
+
+TEST(GrayscaleTest, FlatImageMatchesNestedAdapter) {
+    std::vector<std::vector<std::array<int, 3>>> nested = {
+        {{1, 2, 3},     {255, 255, 0}},
+        {{92, 8, 4},     {255, 255, 255}},
+        {{0, 125, 90},     {12, 25, 85}}
+    };
+    RgbImage flat(2, 3);
+    for (int row = 0; row < 3; row++)
+        for (int col = 0; col < 2; col++)
+            for (int c = 0; c < 3; c++)
+                flat.pixel(row, col)[c] = static_cast<std::uint8_t>(nested[row][col][c]);
+
+    const GrayscaleMethod methods[] = {
+        GrayscaleMethod::Lightness, GrayscaleMethod::Average, GrayscaleMethod::Luminosity,
+        GrayscaleMethod::RootMeanSquare, GrayscaleMethod::RedChannel,
+        GrayscaleMethod::GreenChannel, GrayscaleMethod::BlueChannel
+    };
+    for (GrayscaleMethod method : methods) {
+        std::vector<std::vector<int>> expected;
+        GrayImage result;
+        convertToGrayscale(nested, 3, 2, method, expected);
+        convertToGrayscale(flat, method, result);
+
+        ASSERT_EQ(result.width, 2);
+        ASSERT_EQ(result.height, 3);
+        for (int row = 0; row < 3; row++) {
+            for (int col = 0; col < 2; col++) {
+                EXPECT_EQ(result.row(row)[col], expected[row][col]) << " at (" << row << ", " << col << ")";
+            }
+        }
+    }
+}
+
+TEST(GrayscaleTest, FlatImagePaddedStride) {
+    // rows padded to 16 bytes: the padding must be skipped, not converted
+    RgbImage image;
+    image.resize(2, 2, 16);
+    std::fill(image.data.begin(), image.data.end(), 0xAB);
+    image.pixel(0, 0)[0] = 10; image.pixel(0, 1)[0] = 20;
+    image.pixel(1, 0)[0] = 30; image.pixel(1, 1)[0] = 40;
+
+    GrayImage result;
+    convertToGrayscale(image, GrayscaleMethod::RedChannel, result);
+
+    EXPECT_EQ(result.stride, 2u);
+    EXPECT_EQ(result.row(0)[0], 10);
+    EXPECT_EQ(result.row(0)[1], 20);
+    EXPECT_EQ(result.row(1)[0], 30);
+    EXPECT_EQ(result.row(1)[1], 40);
+}
+
+// the fused multi-method conversion must match one conversion per method
+TEST(GrayscaleTest, MultipleMethodsSinglePass) {
+    RgbImage image(5, 4);
+    for (size_t k = 0; k < image.data.size(); k++)
+        image.data[k] = static_cast<std::uint8_t>(k * 37 + 11);
+
+    std::vector<GrayscaleMethod> methods = {
+        GrayscaleMethod::Lightness, GrayscaleMethod::Average, GrayscaleMethod::Luminosity,
+        GrayscaleMethod::RootMeanSquare, GrayscaleMethod::RedChannel,
+        GrayscaleMethod::GreenChannel, GrayscaleMethod::BlueChannel
+    };
+    std::vector<GrayImage> results;
+    convertToGrayscale(image.view(), methods, results);
+
+    ASSERT_EQ(results.size(), methods.size());
+    for (size_t m = 0; m < methods.size(); m++) {
+        GrayImage expected;
+        convertToGrayscale(image, methods[m], expected);
+        EXPECT_EQ(results[m].width, 5);
+        EXPECT_EQ(results[m].height, 4);
+        EXPECT_EQ(results[m].data, expected.data) << "method " << m;
+    }
+}
+
+// converting in row bands on a pool must give exactly the serial result,
+// including the rows of the last, shorter band
+TEST(GrayscaleTest, RowBandsMatchSerialConversion) {
+    RgbImage image(1531, 2053);
+    std::uint32_t state = 12345;
+    for (auto& sample : image.data) {
+        state = state * 1664525u + 1013904223u;
+        sample = static_cast<std::uint8_t>(state >> 24);
+    }
+
+    std::vector<GrayscaleMethod> methods = {
+        GrayscaleMethod::Lightness, GrayscaleMethod::Luminosity, GrayscaleMethod::RootMeanSquare
+    };
+    std::vector<GrayImage> serial;
+    convertToGrayscale(image.view(), methods, serial);
+
+    for (unsigned threads : {2u, 3u, 8u}) {
+        ThreadPool pool(threads);
+        std::vector<GrayImage> banded;
+        convertToGrayscale(image.view(), methods, banded, &pool);
+        ASSERT_EQ(banded.size(), methods.size());
+        for (size_t m = 0; m < methods.size(); m++)
+            EXPECT_EQ(banded[m].data, serial[m].data) << "method " << m << ", " << threads << " threads";
+
+        GrayImage single;
+        convertToGrayscale(image, GrayscaleMethod::Average, single, &pool);
+        GrayImage expected;
+        convertToGrayscale(image, GrayscaleMethod::Average, expected);
+        EXPECT_EQ(single.data, expected.data) << threads << " threads";
+    }
+}
@@ -0,0 +1,115 @@
+#include "io_ring.hpp"
+#include "ppm_io.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<char> contents(std::size_t size, int seed) {
+    std::vector<char> data(size);
+    for (size_t k = 0; k < size; k++) data[k] = static_cast<char>(k * 13 + seed);
+    return data;
+}
+
+std::vector<char> readFile(const std::string& path) {
+    std::ifstream in(path, std::ios::binary);
+    return std::vector<char>(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+}
+
+// Writes a batch through `ring`, one file empty and one in a missing folder,
+// then reads it back with one more missing file.
+void roundTrip(IoRing& ring, const std::string& name) {
+    fs::path folder = fs::path(testing::TempDir()) / name;
+    fs::create_directories(folder);
+
+    // more files than a small ring has entries, so that submissions queue
+    const size_t count = 40;
+    std::vector<std::vector<char>> files;
+    std::vector<std::string> paths;
+    for (size_t k = 0; k < count; k++) {
+        files.push_back(contents(k == 3 ? 0 : k * 1000 + 1, static_cast<int>(k)));
+        paths.push_back((folder / ("file" + std::to_string(k))).string());
+    }
+    paths[7] = (folder / "missing" / "file7").string();
+
+    std::vector<FileWrite> writes(count);
+    for (size_t k = 0; k < count; k++) {
+        writes[k].path = paths[k].c_str();
+        writes[k].data = files[k].data();
+        writes[k].size = files[k].size();
+    }
+    ring.writeFiles(writes.data(), writes.size());
+    for (size_t k = 0; k < count; k++) {
+        EXPECT_EQ(writes[k].ok, k != 7) << k;
+        if (k != 7) {
+            EXPECT_EQ(readFile(paths[k]), files[k]) << k;
+        }
+    }
+
+    std::vector<std::vector<char>> data(count + 1, std::vector<char>(5, 'x'));
+    paths.push_back((folder / "never_written").string());
+    std::vector<FileRead> reads(count + 1);
+    for (size_t k = 0; k <= count; k++) {
+        reads[k].path = paths[k].c_str();
+        reads[k].data = &data[k];
+    }
+    ring.readFiles(reads.data(), reads.size());
+    for (size_t k = 0; k <= count; k++) {
+        bool exists = k != 7 && k != count;
+        EXPECT_EQ(reads[k].ok, exists) << k;
+        if (exists) {
+            EXPECT_EQ(data[k], files[k]) << k;
+        }
+    }
+}
+
+} // namespace
+
+TEST(IoRingTest, BatchedRoundTrip) {
+    IoRing ring;
+    // kernels without io_uring, or sandboxes that forbid it, use the fallback
+    if (!ring.open(8)) GTEST_SKIP() << "io_uring is unavailable";
+    EXPECT_TRUE(ring.isOpen());
+    roundTrip(ring, "io_ring_batched");
+}
+
+TEST(IoRingTest, BlockingFallbackRoundTrip) {
+    IoRing ring;
+    EXPECT_FALSE(ring.isOpen());
+    roundTrip(ring, "io_ring_blocking");
+}
+
+TEST(IoRingTest, FormattedFilesMatchWritePGM) {
+    GrayImage image;
+    image.resize(37, 5, 40);
+    for (size_t k = 0; k < image.data.size(); k++) image.data[k] = static_cast<std::uint8_t>(k * 29);
+    // a strided view, so that the padding must be skipped
+    GrayView view = {image.data.data(), 33, 5, image.stride};
+
+    std::string path = (fs::path(testing::TempDir()) / "formatted.pgm").string();
+    std::vector<char> formatted;
+    for (PnmEncoding encoding : {PnmEncoding::Plain, PnmEncoding::Raw}) {
+        ASSERT_TRUE(writePGM(path, view, encoding));
+        formatPGM(view, encoding, formatted);
+        EXPECT_EQ(formatted, readFile(path));
+    }
+
+    // inputs are parsed from the bytes a batch read: raw pixels in place,
+    // plain ones decoded
+    PpmInput input;
+    std::string raw = "P6\n2 1\n255\n" + std::string("\x01\x02\x03\x04\x05\x06", 6);
+    ASSERT_TRUE(parsePPM(raw.data(), raw.size(), input));
+    EXPECT_EQ(input.pixels.data, reinterpret_cast<const std::uint8_t*>(raw.data()) + 11);
+    EXPECT_EQ(input.pixels.row(0)[5], 6);
+    std::string plain = "P3\n2 1\n255\n1 2 3 4 5 6\n";
+    ASSERT_TRUE(parsePPM(plain.data(), plain.size(), input));
+    EXPECT_EQ(input.pixels.data, input.decoded.data.data());
+    EXPECT_EQ(input.pixels.row(0)[5], 6);
+    EXPECT_FALSE(parsePPM(plain.data(), 8, input));
+}
@@ -0,0 +1,81 @@
+#include "manifest.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <string>
+
+namespace fs = std::filesystem;
+
+TEST(ManifestTest, ContentHashMatchesXxh64) {
+    // reference values of XXH64 with seed 0
+    EXPECT_EQ(contentHash("", 0), 0xEF46DB3751D8E999ULL);
+    EXPECT_EQ(contentHash("a", 1), 0xD24EC4F1A98C6E5BULL);
+    EXPECT_EQ(contentHash("abc", 3), 0x44BC2CF5AD770999ULL);
+    const std::string alphabet = "abcdefghijklmnopqrstuvwxyz";
+    EXPECT_EQ(contentHash(alphabet.data(), alphabet.size()), 0xCFE1F278FA89835CULL);
+
+    // every length class (stripes, 8/4/1-byte tails) reacts to a one-bit change
+    std::string data(100, 'x');
+    for (size_t size : {1u, 3u, 4u, 7u, 8u, 31u, 32u, 33u, 64u, 100u}) {
+        std::string changed = data.substr(0, size);
+        changed[size - 1] ^= 1;
+        EXPECT_NE(contentHash(data.data(), size), contentHash(changed.data(), size)) << size;
+    }
+}
+
+TEST(ManifestTest, SaveAndLoadRoundTrip) {
+    std::string path = (fs::path(testing::TempDir()) / "roundtrip.manifest").string();
+    fs::remove(path);
+
+    Manifest manifest;
+    ASSERT_TRUE(manifest.load(path));  // a missing manifest is empty
+    EXPECT_TRUE(manifest.inputs().empty());
+
+    ManifestEntry entry;
+    entry.size = 107220;
+    entry.mtime = -1234567890123LL;
+    entry.hash = 0xFEDCBA9876543210ULL;
+    entry.parameters = "Lightness,Average;P2";
+    entry.version = "1.0.0";
+    manifest.update("image with spaces.ppm", entry);
+    entry.hash = 1;
+    manifest.update("other.ppm", entry);
+    manifest.update("removed.ppm", entry);
+    manifest.remove("removed.ppm");
+    ASSERT_TRUE(manifest.save(path));
+    EXPECT_FALSE(fs::exists(path + ".tmp"));
+
+    Manifest loaded;
+    ASSERT_TRUE(loaded.load(path));
+    EXPECT_EQ(loaded.inputs(), (std::vector<std::string>{"image with spaces.ppm", "other.ppm"}));
+    ManifestEntry found;
+    ASSERT_TRUE(loaded.find("image with spaces.ppm", found));
+    EXPECT_EQ(found.size, 107220u);
+    EXPECT_EQ(found.mtime, -1234567890123LL);
+    EXPECT_EQ(found.hash, 0xFEDCBA9876543210ULL);
+    EXPECT_EQ(found.parameters, "Lightness,Average;P2");
+    EXPECT_EQ(found.version, "1.0.0");
+    EXPECT_FALSE(loaded.find("removed.ppm", found));
+}
+
+TEST(ManifestTest, RejectsMalformedManifest) {
+    std::string path = (fs::path(testing::TempDir()) / "bad.manifest").string();
+    for (const char* text : {"not a manifest\n", "# convert_grayscale manifest v1\n1.0\tP2\t12\n",
+                             "# convert_grayscale manifest v1\n1.0\tP2\tx\t0\t0\tname\n"}) {
+        std::ofstream(path) << text;
+        Manifest manifest;
+        EXPECT_FALSE(manifest.load(path)) << text;
+    }
+}
+
+TEST(ManifestTest, HashFileMatchesContentHash) {
+    std::string path = (fs::path(testing::TempDir()) / "hashed.bin").string();
+    std::string contents(5000, '\0');
+    for (size_t k = 0; k < contents.size(); k++) contents[k] = static_cast<char>(k * 31);
+    std::ofstream(path, std::ios::binary) << contents;
+
+    std::uint64_t hash = 0;
+    ASSERT_TRUE(hashFile(path, hash));
+    EXPECT_EQ(hash, contentHash(contents.data(), contents.size()));
+    EXPECT_FALSE(hashFile(path + ".missing", hash));
+}
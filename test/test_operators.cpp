@@ -0,0 +1,185 @@
+#include "operators.hpp"
+#include "thread_pool.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace {
+
+GrayHistogram histogramOf(const GrayImage& image) {
+    GrayHistogram histogram{};
+    for (int i = 0; i < image.height; i++)
+        for (int j = 0; j < image.width; j++)
+            ++histogram[image.row(i)[j]];
+    return histogram;
+}
+
+GrayLut stageLut(const GrayOperator& stage, const GrayHistogram& histogram) {
+    return composeOperators({stage}, histogram);
+}
+
+// unfused reference: convert, then apply one stage at a time to the whole
+// image, recounting the histogram before each stage
+GrayImage stagewise(const RgbView& rgb, const OperatorChain& chain) {
+    GrayImage gray;
+    convertToGrayscale(rgb, chain.method, gray);
+    for (const GrayOperator& stage : chain.stages) {
+        GrayLut lut = stageLut(stage, histogramOf(gray));
+        for (int i = 0; i < gray.height; i++)
+            for (int j = 0; j < gray.width; j++)
+                gray.row(i)[j] = lut[gray.row(i)[j]];
+    }
+    return gray;
+}
+
+OperatorChain chain(const std::string& spec) {
+    OperatorChain parsed;
+    std::string error;
+    EXPECT_TRUE(parseOperatorChain(spec, parsed, error)) << spec << ": " << error;
+    return parsed;
+}
+
+} // namespace
+
+TEST(OperatorsTest, ParsesChains) {
+    OperatorChain parsed = chain("Luminosity|stretch:2.5|threshold|invert|threshold:128");
+    EXPECT_EQ(parsed.method, GrayscaleMethod::Luminosity);
+    ASSERT_EQ(parsed.stages.size(), 4u);
+    EXPECT_EQ(parsed.stages[0].kind, GrayOperator::Kind::Stretch);
+    EXPECT_DOUBLE_EQ(parsed.stages[0].clipPercent, 2.5);
+    EXPECT_EQ(parsed.stages[1].kind, GrayOperator::Kind::Threshold);
+    EXPECT_EQ(parsed.stages[1].level, -1);
+    EXPECT_EQ(parsed.stages[2].kind, GrayOperator::Kind::Invert);
+    EXPECT_EQ(parsed.stages[3].level, 128);
+    EXPECT_TRUE(parsed.needsHistogram());
+    EXPECT_FALSE(chain("Average|invert|threshold:10").needsHistogram());
+    EXPECT_TRUE(chain("Average").stages.empty());
+
+    OperatorChain rejected;
+    std::string error;
+    for (const char* spec : {"", "Bogus", "Average|", "Average|blur", "Average|stretch:", "Average|stretch:50",
+                             "Average|threshold:257", "Average|threshold:1.5", "Average|threshold:-1",
+                             "Average|invert:2", "|stretch"}) {
+        EXPECT_FALSE(parseOperatorChain(spec, rejected, error)) << spec;
+        EXPECT_FALSE(error.empty()) << spec;
+    }
+}
+
+TEST(OperatorsTest, StageTables) {
+    GrayHistogram histogram{};
+    for (int v = 10; v <= 20; v++) histogram[v] = 1;
+
+    GrayOperator stretch;
+    stretch.kind = GrayOperator::Kind::Stretch;
+    GrayLut lut = stageLut(stretch, histogram);
+    EXPECT_EQ(lut[10], 0);
+    EXPECT_EQ(lut[15], 128);
+    EXPECT_EQ(lut[20], 255);
+    EXPECT_EQ(lut[0], 0);
+    EXPECT_EQ(lut[255], 255);
+
+    // clipping one pixel in ten at each end stretches 11..19 instead
+    stretch.clipPercent = 10;
+    lut = stageLut(stretch, histogram);
+    EXPECT_EQ(lut[11], 0);
+    EXPECT_EQ(lut[19], 255);
+
+    // a constant image is left alone
+    GrayHistogram constant{};
+    constant[77] = 100;
+    stretch.clipPercent = 0;
+    EXPECT_EQ(stageLut(stretch, constant)[77], 77);
+
+    GrayOperator threshold;
+    threshold.kind = GrayOperator::Kind::Threshold;
+    threshold.level = 128;
+    lut = stageLut(threshold, histogram);
+    EXPECT_EQ(lut[127], 0);
+    EXPECT_EQ(lut[128], 255);
+
+    // Otsu's level separates two clusters
+    GrayHistogram bimodal{};
+    bimodal[40] = bimodal[45] = 500;
+    bimodal[200] = bimodal[210] = 300;
+    threshold.level = -1;
+    lut = stageLut(threshold, bimodal);
+    EXPECT_EQ(lut[45], 0);
+    EXPECT_EQ(lut[200], 255);
+
+    GrayOperator invert;
+    lut = stageLut(invert, histogram);
+    EXPECT_EQ(lut[0], 255);
+    EXPECT_EQ(lut[200], 55);
+
+    // the histogram of a remapped image follows the table
+    GrayHistogram remapped = remapHistogram(histogram, lut);
+    EXPECT_EQ(remapped[245], 1u);
+    EXPECT_EQ(remapped[10], 0u);
+}
+
+TEST(OperatorsTest, FusedMatchesStagewise) {
+    // large enough for several row bands, with padded rows
+    RgbImage rgb;
+    rgb.resize(1501, 700, 1501 * 3 + 5);
+    std::mt19937 random(7);
+    std::normal_distribution<double> noise(100, 30);
+    for (auto& sample : rgb.data)
+        sample = static_cast<std::uint8_t>(std::min(255.0, std::max(0.0, noise(random))));
+
+    std::vector<OperatorChain> chains = {
+        chain("Luminosity|stretch:1|threshold"),
+        chain("Average|invert|threshold:100"),
+        chain("Lightness"),
+        chain("RootMeanSquare|stretch|invert|stretch"),
+        chain("BlueChannel|invert"),
+    };
+    FusedConversion conversion(chains);
+    EXPECT_FALSE(conversion.trivial());
+    EXPECT_TRUE(conversion.needsHistograms());
+
+    for (unsigned threads : {1u, 3u}) {
+        ThreadPool pool(threads);
+        std::vector<GrayImage> outputs;
+        std::vector<GrayHistogram> histograms;
+        conversion.convert(rgb.view(), outputs, &histograms, &pool);
+        ASSERT_EQ(outputs.size(), chains.size());
+        ASSERT_EQ(histograms.size(), chains.size());
+        for (size_t c = 0; c < chains.size(); c++) {
+            GrayImage expected = stagewise(rgb.view(), chains[c]);
+            EXPECT_TRUE(outputs[c].data == expected.data) << "chain " << c << ", " << threads << " threads";
+            EXPECT_EQ(histograms[c], histogramOf(expected)) << "chain " << c;
+        }
+
+        // without histograms the outputs are the same
+        std::vector<GrayImage> plain;
+        conversion.convert(rgb.view(), plain, nullptr, &pool);
+        for (size_t c = 0; c < chains.size(); c++)
+            EXPECT_TRUE(plain[c].data == outputs[c].data) << "chain " << c;
+    }
+}
+
+TEST(OperatorsTest, HistogramReportJson) {
+    HistogramReport report;
+    report.methods = {"Average", "Luminosity|invert"};
+    GrayHistogram first{};
+    first[0] = 3;
+    GrayHistogram second{};
+    second[255] = 3;
+    report.add("b \"quoted\".ppm", {first, second});
+    report.add("a.ppm", {second, first});
+
+    std::ostringstream json;
+    report.writeJson(json);
+    std::string text = json.str();
+    EXPECT_EQ(text.find("\"images\""), std::string::npos);
+    EXPECT_NE(text.find("\"methods\": [\"Average\", \"Luminosity|invert\"]"), std::string::npos);
+    // inputs sorted by path, names escaped, one 256-bin array per output
+    std::size_t a = text.find("{\"input\": \"a.ppm\", \"histograms\": [[0,");
+    std::size_t b = text.find("{\"input\": \"b \\\"quoted\\\".ppm\", \"histograms\": [[3,");
+    EXPECT_NE(text.find("\"inputs\": ["), std::string::npos);
+    ASSERT_NE(a, std::string::npos);
+    ASSERT_NE(b, std::string::npos);
+    EXPECT_LT(a, b);
+}
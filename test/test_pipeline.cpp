@@ -0,0 +1,107 @@
+#include "bounded_queue.hpp"
+#include "pipeline.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+TEST(PipelineTest, BoundedQueueKeepsOrderAndCapacity) {
+    BoundedQueue<int> queue(3);
+    EXPECT_EQ(queue.capacity(), 3u);
+
+    // several laps around the ring
+    for (int lap = 0; lap < 5; lap++) {
+        for (int i = 0; i < 3; i++) {
+            int value = lap * 10 + i;
+            EXPECT_TRUE(queue.tryPush(value));
+        }
+        int extra = -1;
+        EXPECT_FALSE(queue.tryPush(extra));
+        EXPECT_EQ(extra, -1);
+
+        for (int i = 0; i < 3; i++) {
+            int value = -1;
+            ASSERT_TRUE(queue.tryPop(value));
+            EXPECT_EQ(value, lap * 10 + i);
+        }
+        int value;
+        EXPECT_FALSE(queue.tryPop(value));
+    }
+}
+
+TEST(PipelineTest, BoundedQueueManyProducersAndConsumers) {
+    BoundedQueue<long> queue(8);
+    const long perProducer = 20000;
+    std::atomic<long> sum{0};
+    std::atomic<long> popped{0};
+
+    std::vector<std::thread> threads;
+    for (int p = 0; p < 3; p++) {
+        threads.emplace_back([&, p] {
+            for (long i = 1; i <= perProducer; i++) {
+                long value = i * (p + 1);
+                while (!queue.tryPush(value)) std::this_thread::yield();
+            }
+        });
+    }
+    for (int c = 0; c < 3; c++) {
+        threads.emplace_back([&] {
+            long value;
+            while (popped.load() < 3 * perProducer) {
+                if (queue.tryPop(value)) {
+                    sum += value;
+                    popped++;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) thread.join();
+
+    EXPECT_EQ(popped.load(), 3 * perProducer);
+    EXPECT_EQ(sum.load(), (1 + 2 + 3) * perProducer * (perProducer + 1) / 2);
+}
+
+TEST(PipelineTest, EveryItemPassesEveryStageInOrder) {
+    const size_t count = 200;
+    std::vector<std::atomic<int>> stage(count);
+    std::atomic<int> inFlight{0};
+    std::atomic<int> maxInFlight{0};
+    std::atomic<bool> outOfOrder{false};
+
+    PipelineOptions options;
+    options.readers = 2;
+    options.converters = 3;
+    options.writers = 2;
+    options.queueDepth = 2;
+    runPipeline(count, options,
+        [&](size_t k) {
+            if (stage[k].exchange(1) != 0) outOfOrder = true;
+            int now = ++inFlight;
+            int seen = maxInFlight.load();
+            while (now > seen && !maxInFlight.compare_exchange_weak(seen, now)) {}
+        },
+        [&](size_t k) {
+            std::this_thread::sleep_for(std::chrono::microseconds(200));
+            if (stage[k].exchange(2) != 1) outOfOrder = true;
+        },
+        [&](size_t k) {
+            if (stage[k].exchange(3) != 2) outOfOrder = true;
+            --inFlight;
+        });
+
+    EXPECT_FALSE(outOfOrder.load());
+    for (size_t k = 0; k < count; k++)
+        EXPECT_EQ(stage[k].load(), 3) << k;
+    // 2 * queueDepth + one item per stage thread
+    EXPECT_LE(maxInFlight.load(), 2 * 2 + 2 + 3 + 2);
+}
+
+TEST(PipelineTest, EmptyInput) {
+    std::atomic<int> calls{0};
+    runPipeline(0, PipelineOptions(),
+                [&](size_t) { calls++; }, [&](size_t) { calls++; }, [&](size_t) { calls++; });
+    EXPECT_EQ(calls.load(), 0);
+}
@@ -0,0 +1,374 @@
+#include "ppm_io.hpp"
+#include "alloc_counter.hpp"
+#include "mapped_file.hpp"
+#include "thread_pool.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const fs::path dataDir = TEST_DATA_DIR;
+
+// stream-based P3 reader, equivalent to the original readPPM implementation
+bool referenceReadPPM(const std::string& filename, std::vector<int>& samples, int& rows, int& cols) {
+    std::ifstream in(filename);
+    std::string magic;
+    int maxVal;
+    in >> magic >> cols >> rows >> maxVal;
+    if (!in || magic != "P3") return false;
+    samples.resize(static_cast<size_t>(rows) * cols * 3);
+    for (int& s : samples) in >> s;
+    return static_cast<bool>(in);
+}
+
+bool referenceReadPGM(const std::string& filename, std::vector<int>& values, int& rows, int& cols) {
+    std::ifstream in(filename);
+    std::string magic;
+    int maxVal;
+    in >> magic >> cols >> rows >> maxVal;
+    if (!in || magic != "P2") return false;
+    values.resize(static_cast<size_t>(rows) * cols);
+    for (int& v : values) in >> v;
+    return static_cast<bool>(in);
+}
+
+std::string writeTempFile(const std::string& name, const std::string& contents) {
+    std::string path = (fs::path(testing::TempDir()) / name).string();
+    std::ofstream out(path, std::ios::binary);
+    out << contents;
+    return path;
+}
+
+std::vector<fs::path> inputImages() {
+    std::vector<fs::path> files;
+    for (const auto& entry : fs::directory_iterator(dataDir / "input_images"))
+        if (entry.path().extension() == ".ppm") files.push_back(entry.path());
+    return files;
+}
+
+} // namespace
+
+
+// the fast parser must decode every sample exactly like the stream-based reader
+TEST(PpmIoTest, MatchesStreamParserOnInputImages) {
+    auto files = inputImages();
+    ASSERT_FALSE(files.empty());
+    for (const auto& file : files) {
+        std::vector<int> expected;
+        int rows = 0, cols = 0;
+        ASSERT_TRUE(referenceReadPPM(file.string(), expected, rows, cols)) << file;
+
+        RgbImage image;
+        ASSERT_TRUE(readPPM(file.string(), image)) << file;
+        ASSERT_EQ(image.width, cols);
+        ASSERT_EQ(image.height, rows);
+        for (int i = 0; i < rows; i++) {
+            for (int j = 0; j < cols * 3; j++) {
+                ASSERT_EQ(image.row(i)[j], expected[(static_cast<size_t>(i) * cols * 3) + j])
+                    << file << " at (" << i << ", " << j / 3 << ")";
+            }
+        }
+    }
+}
+
+// parsing + conversion must reproduce the reference outputs produced on the cluster
+TEST(PpmIoTest, ConversionMatchesReferenceOutputs) {
+    const std::pair<GrayscaleMethod, const char*> methods[] = {
+        {GrayscaleMethod::Lightness, "lightness"},
+        {GrayscaleMethod::Average, "average"},
+        {GrayscaleMethod::Luminosity, "luminosity"},
+        {GrayscaleMethod::RootMeanSquare, "rootmeansquare"},
+        {GrayscaleMethod::RedChannel, "redchannel"},
+        {GrayscaleMethod::GreenChannel, "greenchannel"},
+        {GrayscaleMethod::BlueChannel, "bluechannel"}
+    };
+    for (const auto& file : inputImages()) {
+        RgbImage image;
+        ASSERT_TRUE(readPPM(file.string(), image)) << file;
+        for (const auto& [method, folder] : methods) {
+            fs::path reference = dataDir / "output_images" / folder / file.stem();
+            reference += ".pgm";
+
+            std::vector<int> expected;
+            int rows = 0, cols = 0;
+            ASSERT_TRUE(referenceReadPGM(reference.string(), expected, rows, cols)) << reference;
+
+            GrayImage result;
+            convertToGrayscale(image, method, result);
+            ASSERT_EQ(result.width, cols);
+            ASSERT_EQ(result.height, rows);
+            for (int i = 0; i < rows; i++)
+                for (int j = 0; j < cols; j++)
+                    ASSERT_EQ(result.row(i)[j], expected[static_cast<size_t>(i) * cols + j])
+                        << reference << " at (" << i << ", " << j << ")";
+        }
+    }
+}
+
+TEST(PpmIoTest, BufferedFallbackMatchesMapping) {
+    std::string path = inputImages().front().string();
+    MappedFile mapped, buffered;
+    ASSERT_TRUE(mapped.open(path));
+    ASSERT_TRUE(buffered.open(path, false));
+    EXPECT_FALSE(buffered.isMapped());
+    ASSERT_EQ(mapped.size(), buffered.size());
+    EXPECT_EQ(std::string(mapped.data(), mapped.size()), std::string(buffered.data(), buffered.size()));
+}
+
+TEST(PpmIoTest, CommentsAndWhitespace) {
+    std::string text = "P3 # magic\n# a full line comment\n2\t1\r\n255#max\n"
+                       "  1 2 3\n\n\t4  5 # trailing comment\n 6 ";
+    RgbImage image;
+    ASSERT_TRUE(parsePPM(text.data(), text.size(), image));
+    ASSERT_EQ(image.width, 2);
+    ASSERT_EQ(image.height, 1);
+    for (int j = 0; j < 6; j++)
+        EXPECT_EQ(image.row(0)[j], j + 1);
+
+    // the same contents read back from disk
+    RgbImage fromFile;
+    ASSERT_TRUE(readPPM(writeTempFile("comments.ppm", text), fromFile));
+    EXPECT_EQ(fromFile.data, image.data);
+}
+
+TEST(PpmIoTest, SmallMaxValIsNotRescaled) {
+    std::string text = "P3\n1 1\n15\n15 7 0\n";
+    RgbImage image;
+    ASSERT_TRUE(parsePPM(text.data(), text.size(), image));
+    EXPECT_EQ(image.row(0)[0], 15);
+    EXPECT_EQ(image.row(0)[1], 7);
+    EXPECT_EQ(image.row(0)[2], 0);
+}
+
+TEST(PpmIoTest, RejectsInvalidInput) {
+    const char* invalid[] = {
+        "",                             // empty file
+        "P2\n1 1\n255\n1 2 3\n",         // wrong magic
+        "P3\n1 1\n0\n0 0 0\n",           // maxVal too small
+        "P3\n1 1\n256\n0 0 0\n",         // maxVal too large for 8-bit samples
+        "P3\n1 1\n100\n0 101 0\n",       // sample above maxVal
+        "P3\n2 1\n255\n1 2 3 4 5\n",     // truncated pixel data
+        "P3\n1 1\n255\n1 2x 3\n",        // garbage inside a token
+        "P3\n1 1\n255\n1 -2 3\n",        // negative sample
+        "P3\n99999999999 1\n255\n",      // dimension overflow
+    };
+    for (const char* text : invalid) {
+        RgbImage image;
+        EXPECT_FALSE(parsePPM(text, std::char_traits<char>::length(text), image)) << text;
+    }
+    RgbImage image;
+    EXPECT_FALSE(readPPM((fs::path(testing::TempDir()) / "missing.ppm").string(), image));
+}
+
+
+// headers promising more samples than the file could hold are rejected
+// before the image is sized for them
+TEST(PpmIoTest, RejectsHostilePlainHeaders) {
+    const char* hostile[] = {
+        "P3\n100000 100000\n255\n",      // 30 G samples in a 20-byte file
+        "P3\n1000000000 1\n255\n1 2 3\n",  // 3 * width above INT_MAX
+        "P3\n2147483647 2147483647\n255\n",
+        "P3\n2 1\n255\n1 2 3 4 5",          // one byte short of a sample per two bytes
+    };
+    ThreadPool pool(3);
+    for (const char* text : hostile) {
+        RgbImage image;
+        EXPECT_FALSE(parsePPM(text, std::char_traits<char>::length(text), image)) << text;
+        EXPECT_FALSE(parsePPM(text, std::char_traits<char>::length(text), image, &pool)) << text;
+        PpmInput input;
+        EXPECT_FALSE(openPPM(writeTempFile("hostile.ppm", text), input)) << text;
+    }
+
+    // the smallest valid raster: single-digit samples, no final newline
+    std::string tight = "P3\n2 1\n255\n1 2 3 4 5 6";
+    RgbImage image;
+    ASSERT_TRUE(parsePPM(tight.data(), tight.size(), image));
+    EXPECT_EQ(image.data, (std::vector<std::uint8_t>{1, 2, 3, 4, 5, 6}));
+}
+
+
+namespace {
+
+// re-encodes a decoded image as a raw (P6) file
+std::string encodeP6(const RgbImage& image, int maxVal = 255) {
+    std::string out = "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) +
+                      "\n" + std::to_string(maxVal) + "\n";
+    out.append(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+    return out;
+}
+
+} // namespace
+
+
+TEST(PpmIoTest, RawInputMatchesPlainInput) {
+    for (const auto& file : inputImages()) {
+        RgbImage plain;
+        ASSERT_TRUE(readPPM(file.string(), plain)) << file;
+        std::string path = writeTempFile("raw_" + file.filename().string(), encodeP6(plain));
+
+        RgbImage raw;
+        ASSERT_TRUE(readPPM(path, raw)) << path;
+        EXPECT_EQ(raw.width, plain.width);
+        EXPECT_EQ(raw.height, plain.height);
+        EXPECT_EQ(raw.data, plain.data);
+
+        // openPPM exposes the raster in place instead of decoding it
+        PpmInput input;
+        ASSERT_TRUE(openPPM(path, input)) << path;
+        EXPECT_TRUE(input.decoded.empty());
+        ASSERT_EQ(input.pixels.height, plain.height);
+        for (int i = 0; i < plain.height; i++)
+            ASSERT_TRUE(std::equal(plain.row(i), plain.row(i) + plain.stride, input.pixels.row(i)));
+    }
+}
+
+TEST(PpmIoTest, RejectsInvalidRawInput) {
+    RgbImage image(2, 1);
+    image.data = {1, 2, 3, 4, 5, 6};
+    std::string valid = encodeP6(image);
+
+    std::string truncated = valid.substr(0, valid.size() - 1);
+    std::string aboveMaxVal = encodeP6(image, 5);
+    std::string noSeparator = valid;
+    noSeparator.erase(noSeparator.find("255") + 3, 1);
+
+    RgbImage result;
+    EXPECT_TRUE(parsePPM(valid.data(), valid.size(), result));
+    EXPECT_FALSE(parsePPM(truncated.data(), truncated.size(), result));
+    EXPECT_FALSE(parsePPM(aboveMaxVal.data(), aboveMaxVal.size(), result));
+    EXPECT_FALSE(parsePPM(noSeparator.data(), noSeparator.size(), result));
+}
+
+namespace {
+
+// a plain file of a few MiB with comments, blank lines and uneven spacing
+std::string largePlainPpm(int width, int height) {
+    std::string text = "P3\n# generated\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    std::uint32_t state = 7;
+    for (int i = 0; i < height; i++) {
+        if (i % 17 == 0) text += "# row " + std::to_string(i) + "\n";
+        for (int j = 0; j < 3 * width; j++) {
+            state = state * 1664525u + 1013904223u;
+            text += std::to_string(state >> 24);
+            text += j % 29 == 28 ? "\n" : (j % 5 == 0 ? "  " : " ");
+        }
+        text += i % 7 == 0 ? "\n\n" : "\n";
+    }
+    return text;
+}
+
+} // namespace
+
+
+TEST(PpmIoTest, ParallelDecodingMatchesSerial) {
+    std::string text = largePlainPpm(700, 600);
+    RgbImage serial;
+    ASSERT_TRUE(parsePPM(text.data(), text.size(), serial));
+
+    ThreadPool pool(4);
+    RgbImage parallel;
+    ASSERT_TRUE(parsePPM(text.data(), text.size(), parallel, &pool));
+    EXPECT_EQ(parallel.data, serial.data);
+
+    // trailing data after the raster is ignored either way
+    std::string trailing = text + "junk\n";
+    ASSERT_TRUE(parsePPM(trailing.data(), trailing.size(), parallel, &pool));
+    EXPECT_EQ(parallel.data, serial.data);
+
+    std::string raw = encodeP6(serial);
+    ASSERT_TRUE(parsePPM(raw.data(), raw.size(), parallel, &pool));
+    EXPECT_EQ(parallel.data, serial.data);
+
+    // malformed samples deep inside the raster are still rejected
+    std::string bad = text;
+    bad[bad.find('\n', bad.size() * 3 / 4) + 1] = 'x';
+    EXPECT_FALSE(parsePPM(bad.data(), bad.size(), parallel, &pool));
+    std::string aboveMaxVal = text;
+    aboveMaxVal.replace(aboveMaxVal.find("\n255\n") + 1, 3, "254");
+    bool hasMax = serial.data.end() != std::find(serial.data.begin(), serial.data.end(), 255);
+    EXPECT_EQ(parsePPM(aboveMaxVal.data(), aboveMaxVal.size(), parallel, &pool), !hasMax);
+    std::string truncated = text.substr(0, text.size() / 2);
+    EXPECT_FALSE(parsePPM(truncated.data(), truncated.size(), parallel, &pool));
+}
+
+TEST(PpmIoTest, WritesPlainAndRawPgm) {
+    GrayImage image(3, 2);
+    image.data = {0, 7, 255, 10, 100, 1};
+
+    std::string plainPath = (fs::path(testing::TempDir()) / "plain.pgm").string();
+    std::string rawPath = (fs::path(testing::TempDir()) / "raw.pgm").string();
+    ASSERT_TRUE(writePGM(plainPath, image));
+    ASSERT_TRUE(writePGM(rawPath, image, PnmEncoding::Raw));
+
+    MappedFile plain, raw;
+    ASSERT_TRUE(plain.open(plainPath));
+    ASSERT_TRUE(raw.open(rawPath));
+    EXPECT_EQ(std::string(plain.data(), plain.size()), "P2\n3 2\n255\n0 7 255 \n10 100 1 \n");
+    EXPECT_EQ(std::string(raw.data(), raw.size()), std::string("P5\n3 2\n255\n") +
+              std::string(reinterpret_cast<const char*>(image.data.data()), image.data.size()));
+}
+
+// every gray value, rows padded past their width, and enough data to need
+// several output buffers: the fast serializer must match per-value formatting
+TEST(PpmIoTest, PlainPgmMatchesFormattedOutput) {
+    GrayImage image;
+    image.resize(1000, 700, 1003);
+    for (size_t k = 0; k < image.data.size(); k++)
+        image.data[k] = static_cast<std::uint8_t>(k * 7 + k / 255);
+
+    std::ostringstream expected;
+    expected << "P2\n" << image.width << " " << image.height << "\n255\n";
+    for (int i = 0; i < image.height; i++) {
+        for (int j = 0; j < image.width; j++)
+            expected << static_cast<int>(image.row(i)[j]) << " ";
+        expected << "\n";
+    }
+
+    std::string path = (fs::path(testing::TempDir()) / "large_plain.pgm").string();
+    ASSERT_TRUE(writePGM(path, image));
+    MappedFile file;
+    ASSERT_TRUE(file.open(path));
+    EXPECT_TRUE(std::string(file.data(), file.size()) == expected.str());
+
+    std::ostringstream streamed;
+    PgmStreamWriter writer(streamed, image.width, image.height, PnmEncoding::Plain);
+    ASSERT_TRUE(writer.writeRows(image.view().rows(0, 300)));
+    ASSERT_TRUE(writer.writeRows(image.view().rows(300, 400)));
+    ASSERT_TRUE(writer.finish());
+    EXPECT_TRUE(streamed.str() == expected.str());
+}
+
+// reading, converting and writing an image into buffers kept from the
+// previous image of the same size must not touch the heap
+TEST(PpmIoTest, SteadyStateConversionDoesNotAllocate) {
+    std::vector<fs::path> inputs = inputImages();
+    ASSERT_GE(inputs.size(), 2u);
+    std::string outputPath = (fs::path(testing::TempDir()) / "steady_state.pgm").string();
+    std::vector<GrayscaleMethod> methods = {GrayscaleMethod::Lightness, GrayscaleMethod::Luminosity};
+
+    PpmInput input;
+    std::vector<GrayImage> grayscaleImages;
+    for (PnmEncoding encoding : {PnmEncoding::Plain, PnmEncoding::Raw}) {
+        for (size_t k = 0; k < 2; k++) {
+            std::uint64_t allocations = 0;
+            {
+                AllocationScope scope(allocations);
+                ASSERT_TRUE(openPPM(inputs[k].native(), input));
+                convertToGrayscale(input.pixels, methods, grayscaleImages);
+                input.file.close();
+                for (const GrayImage& image : grayscaleImages)
+                    ASSERT_TRUE(writePGM(outputPath, image, encoding));
+            }
+            if (k > 0) {
+                EXPECT_EQ(allocations, 0u) << inputs[k];
+            }
+        }
+    }
+}
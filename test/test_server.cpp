@@ -0,0 +1,230 @@
+#include "server.hpp"
+#include "thread_pool.hpp"
+#include <gtest/gtest.h>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const fs::path dataDir = TEST_DATA_DIR;
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// Everything a pipe holds until its write end is closed.
+std::string drain(int fd) {
+    std::string data;
+    char buffer[4096];
+    ssize_t got;
+    while ((got = ::read(fd, buffer, sizeof(buffer))) > 0)
+        data.append(buffer, static_cast<size_t>(got));
+    return data;
+}
+
+} // namespace
+
+TEST(ServerTest, ParsesRequests) {
+    ServerRequest request;
+    std::string error;
+    ASSERT_TRUE(parseServerRequest("convert\tLuminosity\tin dir/a.ppm\tout.pgm", request, error));
+    EXPECT_EQ(request.kind, ServerRequest::Kind::Convert);
+    EXPECT_EQ(request.method, GrayscaleMethod::Luminosity);
+    EXPECT_EQ(request.input, "in dir/a.ppm");
+    EXPECT_EQ(request.output, "out.pgm");
+    EXPECT_EQ(request.encoding, PnmEncoding::Plain);
+
+    ASSERT_TRUE(parseServerRequest("inline\tAverage\t1234\tout.pgm\tP5", request, error));
+    EXPECT_EQ(request.kind, ServerRequest::Kind::Inline);
+    EXPECT_EQ(request.inlineBytes, 1234u);
+    EXPECT_EQ(request.encoding, PnmEncoding::Raw);
+
+    ASSERT_TRUE(parseServerRequest("ping", request, error));
+    EXPECT_EQ(request.kind, ServerRequest::Kind::Ping);
+    ASSERT_TRUE(parseServerRequest("shutdown", request, error));
+    EXPECT_EQ(request.kind, ServerRequest::Kind::Shutdown);
+
+    for (const char* line : {"", "convert", "convert\tBogus\ta.ppm\tb.pgm", "convert\tAverage\ta.ppm\tb.pgm\tP6",
+                             "convert\tAverage\t\tb.pgm", "inline\tAverage\t-5\tb.pgm", "inline\tAverage\t12\t",
+                             "ping\textra", "convert Average a.ppm b.pgm"}) {
+        EXPECT_FALSE(parseServerRequest(line, request, error)) << line;
+        EXPECT_FALSE(error.empty()) << line;
+    }
+}
+
+TEST(ServerTest, AnswersInRequestOrder) {
+    fs::path input = dataDir / "input_images" / "random_image_2.ppm";
+    fs::path folder = fs::path(testing::TempDir()) / "server_connection";
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+    std::string ppm = readFile(input);
+
+    std::string requests =
+        "ping\n"
+        "convert\tLuminosity\t" + input.string() + "\t" + (folder / "a.pgm").string() + "\n"
+        "\n"
+        "convert\tAverage\t" + (folder / "missing.ppm").string() + "\t" + (folder / "b.pgm").string() + "\n"
+        "inline\tLightness\t" + std::to_string(ppm.size()) + "\t" + (folder / "c.pgm").string() + "\n" + ppm +
+        "inline\tLightness\t3\t" + (folder / "d.pgm").string() + "\nP3x" +
+        "bogus\n";
+
+    int in[2], out[2];
+    ASSERT_EQ(::pipe(in), 0);
+    ASSERT_EQ(::pipe(out), 0);
+    std::thread writer([&] {
+        ASSERT_EQ(::write(in[1], requests.data(), requests.size()), static_cast<ssize_t>(requests.size()));
+        ::close(in[1]);
+    });
+    ThreadPool pool(3);
+    EXPECT_FALSE(serveConnection(in[0], out[1], pool));
+    writer.join();
+    ::close(in[0]);
+    ::close(out[1]);
+    std::string responses = drain(out[0]);
+    ::close(out[0]);
+
+    EXPECT_EQ(responses,
+              "ok\tpong\n"
+              "ok\t" + (folder / "a.pgm").string() + "\n"
+              "error\tFailed to read " + (folder / "missing.ppm").string() + "\n"
+              "ok\t" + (folder / "c.pgm").string() + "\n"
+              "error\tFailed to read inline image\n"
+              "error\tUnknown request: bogus\n");
+    EXPECT_EQ(readFile(folder / "a.pgm"), readFile(dataDir / "output_images" / "luminosity" / "random_image_2.pgm"));
+    EXPECT_EQ(readFile(folder / "c.pgm"), readFile(dataDir / "output_images" / "lightness" / "random_image_2.pgm"));
+}
+
+// an oversized inline image is refused without reading or allocating it, and
+// the connection ends there since its bytes would follow
+TEST(ServerTest, RejectsOversizedInlineImages) {
+    ServerRequest request;
+    std::string error;
+    EXPECT_TRUE(parseServerRequest("inline\tAverage\t" + std::to_string(maxInlineBytes) + "\tout.pgm", request, error));
+    EXPECT_FALSE(parseServerRequest("inline\tAverage\t" + std::to_string(maxInlineBytes + 1) + "\tout.pgm", request, error));
+    EXPECT_FALSE(parseServerRequest("inline\tLuminosity\t999999999999\tout.pgm", request, error));
+    EXPECT_NE(error.find("too large"), std::string::npos) << error;
+
+    std::string requests = "ping\n"
+                           "inline\tLuminosity\t999999999999\tout.pgm\n"
+                           "P3\n1 1\n255\n1 2 3\n"
+                           "ping\n";
+    int in[2], out[2];
+    ASSERT_EQ(::pipe(in), 0);
+    ASSERT_EQ(::pipe(out), 0);
+    ASSERT_EQ(::write(in[1], requests.data(), requests.size()), static_cast<ssize_t>(requests.size()));
+    ::close(in[1]);
+    ThreadPool pool(2);
+    EXPECT_FALSE(serveConnection(in[0], out[1], pool));
+    ::close(in[0]);
+    ::close(out[1]);
+    std::string responses = drain(out[0]);
+    ::close(out[0]);
+
+    EXPECT_EQ(responses, "ok\tpong\n"
+                         "error\tInline image too large: 999999999999 bytes (at most " +
+                             std::to_string(maxInlineBytes) + ")\n");
+}
+
+// Runs serveConnection over a pipe holding `requests` and returns the responses.
+std::string serveRequests(const std::string& requests, ThreadPool& pool) {
+    int in[2], out[2];
+    if (::pipe(in) != 0 || ::pipe(out) != 0) return "pipe failed";
+    std::string responses;
+    std::thread reader([&] { responses = drain(out[0]); });
+    std::thread writer([&] {
+        EXPECT_EQ(::write(in[1], requests.data(), requests.size()), static_cast<ssize_t>(requests.size()));
+        ::close(in[1]);
+    });
+    serveConnection(in[0], out[1], pool);
+    writer.join();
+    ::close(in[0]);
+    ::close(out[1]);
+    reader.join();
+    ::close(out[0]);
+    return responses;
+}
+
+// the payload of an inline request rejected for its method, format or output
+// is skipped, never read as requests; without a valid count the connection
+// ends instead
+TEST(ServerTest, SkipsPayloadsOfRejectedInlineRequests) {
+    std::string payload = "ping\nconvert\tAverage\t/nonexistent.ppm\tx.pgm\nshutdown\n";
+    std::string count = std::to_string(payload.size());
+    ThreadPool pool(2);
+    EXPECT_EQ(serveRequests("inline\tBogus\t" + count + "\tout.pgm\n" + payload +
+                                "inline\tAverage\t" + count + "\tout.pgm\tP6\n" + payload +
+                                "inline\tAverage\t" + count + "\t\n" + payload +
+                                "inline\tAverage\t" + count + "\n" + payload + "ping\n",
+                            pool),
+              "error\tInvalid grayscale method: Bogus\n"
+              "error\tInvalid output format: P6\n"
+              "error\tMalformed request: empty output path\n"
+              "error\tMalformed request: expected inline<TAB>method<TAB>bytes<TAB>output[<TAB>P2|P5]\n"
+              "ok\tpong\n");
+    EXPECT_EQ(serveRequests("inline\tAverage\t12x\tout.pgm\n" + payload, pool), "error\tInvalid byte count: 12x\n");
+    EXPECT_EQ(serveRequests("inline\n" + payload, pool), "error\tInvalid byte count: \n");
+}
+
+// more pipelined requests than may be in flight at once are all answered,
+// in order, as reading pauses and resumes
+TEST(ServerTest, ThrottlesPipelinedRequests) {
+    fs::path folder = fs::path(testing::TempDir()) / "server_throttle";
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+    std::string ppm = "P3\n2 1\n255\n1 2 3 4 5 6\n";
+    std::string requests;
+    std::string expected;
+    for (std::size_t k = 0; k < 2 * maxInFlightRequests + 3; k++) {
+        std::string output = (folder / ("o" + std::to_string(k % 8) + ".pgm")).string();
+        requests += "inline\tAverage\t" + std::to_string(ppm.size()) + "\t" + output + "\n" + ppm;
+        expected += "ok\t" + output + "\n";
+    }
+    ThreadPool pool(3);
+    EXPECT_EQ(serveRequests(requests, pool), expected);
+}
+
+TEST(ServerTest, UnixSocketClientAndShutdown) {
+    fs::path folder = fs::path(testing::TempDir()) / "server_socket";
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+    std::string socketPath = (folder / "s.sock").string();
+    fs::path input = dataDir / "input_images" / "random_image_3.ppm";
+
+    ThreadPool pool(2);
+    bool served = false;
+    std::thread server([&] { served = serveUnixSocket(socketPath, pool); });
+    // the client may start before the server listens
+    while (!fs::exists(socketPath))
+        std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+    int out[2];
+    ASSERT_EQ(::pipe(out), 0);
+    std::string request = "convert\tRedChannel\t" + input.string() + "\t" + (folder / "r.pgm").string() + "\tP2\n";
+    bool ok = false;
+    for (int attempt = 0; attempt < 1000 && !ok; attempt++)
+        ok = runClient(socketPath, request, out[1]);
+    EXPECT_TRUE(ok);
+    EXPECT_FALSE(runClient(socketPath, "convert\tRedChannel\t/nonexistent.ppm\tx.pgm\n", out[1]));
+    EXPECT_TRUE(runClient(socketPath, "shutdown\n", out[1]));
+    server.join();
+    EXPECT_FALSE(runClient(socketPath, "ping\n", out[1]));
+    ::close(out[1]);
+    std::string responses = drain(out[0]);
+    ::close(out[0]);
+
+    EXPECT_TRUE(served);
+    EXPECT_EQ(responses, "ok\t" + (folder / "r.pgm").string() + "\n"
+                         "error\tFailed to read /nonexistent.ppm\n"
+                         "ok\tshutdown\n");
+    EXPECT_EQ(readFile(folder / "r.pgm"), readFile(dataDir / "output_images" / "redchannel" / "random_image_3.pgm"));
+    EXPECT_FALSE(fs::exists(socketPath));
+}
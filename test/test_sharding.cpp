@@ -0,0 +1,99 @@
+#include "sharding.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+std::vector<std::uint64_t> shardTotals(const std::vector<std::pair<std::uint64_t, std::string>>& files,
+                                       const std::vector<int>& shards, int count) {
+    std::vector<std::uint64_t> totals(count, 0);
+    for (size_t k = 0; k < files.size(); k++)
+        totals[shards[k]] += files[k].first;
+    return totals;
+}
+
+} // namespace
+
+TEST(ShardingTest, BalancesBySizeAndIgnoresListingOrder) {
+    // one big file and many small ones: splitting by count would put the big
+    // file together with half of the small ones
+    std::vector<std::pair<std::uint64_t, std::string>> files = {{1000, "big.ppm"}};
+    for (int k = 0; k < 20; k++)
+        files.emplace_back(100, "small_" + std::to_string(k) + ".ppm");
+
+    std::vector<int> shards = assignShards(files, 2);
+    std::vector<std::uint64_t> totals = shardTotals(files, shards, 2);
+    EXPECT_EQ(totals[0], 1500u);
+    EXPECT_EQ(totals[1], 1500u);
+
+    // the same files listed in another order land on the same shards
+    std::vector<std::pair<std::uint64_t, std::string>> reversed(files.rbegin(), files.rend());
+    std::vector<int> reversedShards = assignShards(reversed, 2);
+    for (size_t k = 0; k < files.size(); k++)
+        EXPECT_EQ(reversedShards[files.size() - 1 - k], shards[k]) << files[k].second;
+
+    // every file is assigned exactly once, to a valid shard
+    std::vector<int> three = assignShards(files, 3);
+    for (int shard : three) {
+        EXPECT_GE(shard, 0);
+        EXPECT_LT(shard, 3);
+    }
+    EXPECT_EQ(assignShards(files, 1), std::vector<int>(files.size(), 0));
+}
+
+TEST(ShardingTest, SummaryRoundTripAndMerge) {
+    fs::path folder = fs::path(testing::TempDir()) / "shard_summaries";
+    fs::remove_all(folder);
+    fs::create_directories(folder);
+
+    for (int index : {0, 2}) {
+        ShardSummary summary;
+        summary.index = index;
+        summary.count = 3;
+        summary.images = 10 + index;
+        summary.failed = index == 2 ? 1 : 0;
+        summary.skipped = 4;
+        summary.inputBytes = 1000 * (index + 1);
+        summary.wallSeconds = 1.5 + index;
+        ASSERT_TRUE(writeShardSummary((folder / shardSummaryName(index, 3)).string(), summary));
+    }
+
+    ShardSummary read;
+    ASSERT_TRUE(readShardSummary((folder / "shard-2-of-3.summary").string(), read));
+    EXPECT_EQ(read.index, 2);
+    EXPECT_EQ(read.images, 12u);
+    EXPECT_EQ(read.wallSeconds, 3.5);
+
+    ShardSummary total;
+    std::vector<int> missing;
+    ASSERT_TRUE(mergeShardSummaries(folder.string(), total, missing));
+    EXPECT_EQ(total.count, 3);
+    EXPECT_EQ(total.images, 22u);
+    EXPECT_EQ(total.failed, 1u);
+    EXPECT_EQ(total.skipped, 8u);
+    EXPECT_EQ(total.inputBytes, 4000u);
+    EXPECT_EQ(total.wallSeconds, 3.5);
+    EXPECT_EQ(missing, std::vector<int>{1});
+
+    // a leftover summary of a run with another shard count is rejected
+    ShardSummary other;
+    other.count = 2;
+    ASSERT_TRUE(writeShardSummary((folder / shardSummaryName(0, 2)).string(), other));
+    EXPECT_FALSE(mergeShardSummaries(folder.string(), total, missing));
+}
+
+TEST(ShardingTest, RejectsMalformedSummary) {
+    std::string path = (fs::path(testing::TempDir()) / "bad.summary").string();
+    for (const char* text : {"shard_index 0\n", "shard_index 3\nshard_count 2\nimages 1\nfailed 0\nskipped 0\n"
+                                                "input_bytes 0\nwall_seconds 0\n", "unknown 1\n"}) {
+        std::ofstream(path) << text;
+        ShardSummary summary;
+        EXPECT_FALSE(readShardSummary(path, summary)) << text;
+    }
+}
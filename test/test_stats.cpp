@@ -0,0 +1,80 @@
+#include "stats.hpp"
+#include <gtest/gtest.h>
+#include <sstream>
+#include <string>
+
+namespace {
+
+void fillSample(StatsCollector& stats) {
+    stats.mode = "pool";
+    stats.threads = 2;
+    stats.methods = {"Luminosity", "Average"};
+    stats.scanSeconds = 0.5;
+    stats.wallSeconds = 2;
+
+    ImageStats b;
+    b.input = "dir/b \"quoted\".ppm";
+    b.times = {1, 2, 3};
+    b.inputBytes = 100;
+    b.outputBytes = 40;
+    b.pixels = 10;
+    ImageStats a;
+    a.input = "dir/a,comma.ppm";
+    a.ok = false;
+    a.times = {0.25, 0, 0};
+    a.inputBytes = 50;
+    stats.add(b);
+    stats.add(a);
+}
+
+} // namespace
+
+TEST(StatsTest, JsonReportHasTotalsAndImages) {
+    StatsCollector stats;
+    fillSample(stats);
+    std::ostringstream out;
+    stats.writeJson(out);
+    std::string json = out.str();
+
+    EXPECT_NE(json.find("\"mode\": \"pool\""), std::string::npos);
+    EXPECT_NE(json.find("\"methods\": [\"Luminosity\", \"Average\"]"), std::string::npos);
+    EXPECT_NE(json.find("\"images\": 2,"), std::string::npos);
+    EXPECT_NE(json.find("\"failed\": 1,"), std::string::npos);
+    EXPECT_NE(json.find("\"read_seconds\": 1.25,"), std::string::npos);
+    EXPECT_NE(json.find("\"input_bytes\": 150,"), std::string::npos);
+    EXPECT_NE(json.find("\"pixels_per_second\": 5,"), std::string::npos);
+    // quotes in paths are escaped and images are listed by path
+    size_t first = json.find("dir/a,comma.ppm");
+    size_t second = json.find("dir/b \\\"quoted\\\".ppm");
+    ASSERT_NE(first, std::string::npos);
+    ASSERT_NE(second, std::string::npos);
+    EXPECT_LT(first, second);
+}
+
+TEST(StatsTest, CsvReportHasOneRowPerImageAndTotal) {
+    StatsCollector stats;
+    fillSample(stats);
+    std::ostringstream out;
+    stats.writeCsv(out);
+    std::istringstream in(out.str());
+    std::string header, rowA, rowB, total, extra;
+    ASSERT_TRUE(std::getline(in, header));
+    ASSERT_TRUE(std::getline(in, rowA));
+    ASSERT_TRUE(std::getline(in, rowB));
+    ASSERT_TRUE(std::getline(in, total));
+    EXPECT_FALSE(std::getline(in, extra));
+
+    EXPECT_EQ(header.rfind("input,ok,skipped,read_seconds,", 0), 0u);
+    EXPECT_EQ(rowA, "\"dir/a,comma.ppm\",0,0,0.25,0,0,50,0,0,,,");
+    EXPECT_EQ(rowB.rfind("\"dir/b \"\"quoted\"\".ppm\",1,0,1,2,3,100,40,10", 0), 0u);
+    EXPECT_EQ(total.rfind("TOTAL,1,0,1.25,2,3,150,40,10,0.5,2,", 0), 0u);
+}
+
+TEST(StatsTest, DisabledTimerLeavesTargetAlone) {
+    double seconds = 7;
+    { PhaseTimer timer(false, seconds); }
+    EXPECT_EQ(seconds, 7);
+    { PhaseTimer timer(true, seconds); }
+    EXPECT_GE(seconds, 7);
+    EXPECT_GT(peakRssBytes(), 0u);
+}
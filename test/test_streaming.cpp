@@ -0,0 +1,189 @@
+#include "streaming.hpp"
+#include <gtest/gtest.h>
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <streambuf>
+#include <string>
+#include <unistd.h>
+
+namespace fs = std::filesystem;
+
+namespace {
+
+const fs::path dataDir = TEST_DATA_DIR;
+
+std::string readFile(const fs::path& path) {
+    std::ifstream in(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << in.rdbuf();
+    return contents.str();
+}
+
+// P6 image of the given size whose raster is generated on the fly, so that
+// arbitrarily large inputs never exist in memory or on disk
+class SyntheticPpmBuffer : public std::streambuf {
+public:
+    SyntheticPpmBuffer(int width, int height)
+        : header_("P6\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n"),
+          remaining_(static_cast<std::uint64_t>(width) * height * 3), chunk_(1 << 16) {
+        setg(header_.data(), header_.data(), header_.data() + header_.size());
+    }
+
+protected:
+    int_type underflow() override {
+        if (remaining_ == 0) return traits_type::eof();
+        std::size_t n = static_cast<std::size_t>(std::min<std::uint64_t>(remaining_, chunk_.size()));
+        for (std::size_t k = 0; k < n; k += 8) {
+            state_ ^= state_ << 13;
+            state_ ^= state_ >> 7;
+            state_ ^= state_ << 17;
+            std::memcpy(chunk_.data() + k, &state_, std::min<std::size_t>(8, n - k));
+        }
+        remaining_ -= n;
+        setg(chunk_.data(), chunk_.data(), chunk_.data() + n);
+        return traits_type::to_int_type(chunk_[0]);
+    }
+
+private:
+    std::string header_;
+    std::uint64_t remaining_;
+    std::vector<char> chunk_;
+    std::uint64_t state_ = 0x9E3779B97F4A7C15ull;
+};
+
+std::size_t residentBytes() {
+    long pages = 0, resident = 0;
+    if (std::FILE* statm = std::fopen("/proc/self/statm", "r")) {
+        if (std::fscanf(statm, "%ld %ld", &pages, &resident) != 2) resident = 0;
+        std::fclose(statm);
+    }
+    return static_cast<std::size_t>(resident) * static_cast<std::size_t>(sysconf(_SC_PAGESIZE));
+}
+
+// discards its output, counting bytes and sampling the resident set size
+class MeasuringSink : public std::streambuf {
+public:
+    std::uint64_t bytes = 0;
+    std::size_t peakResident = 0;
+
+protected:
+    std::streamsize xsputn(const char*, std::streamsize n) override {
+        account(static_cast<std::uint64_t>(n));
+        return n;
+    }
+    int_type overflow(int_type c) override {
+        account(1);
+        return c;
+    }
+
+private:
+    void account(std::uint64_t n) {
+        if ((bytes >> 24) != ((bytes + n) >> 24))
+            peakResident = std::max(peakResident, residentBytes());
+        bytes += n;
+    }
+};
+
+} // namespace
+
+
+// streamed output must be byte-identical to the reference outputs, whatever the band size
+TEST(StreamingTest, MatchesReferenceOutputs) {
+    const fs::path input = dataDir / "input_images" / "random_image_1.ppm";
+    const std::vector<GrayscaleMethod> methods = {GrayscaleMethod::Luminosity, GrayscaleMethod::RootMeanSquare};
+    const std::string expected[] = {
+        readFile(dataDir / "output_images" / "luminosity" / "random_image_1.pgm"),
+        readFile(dataDir / "output_images" / "rootmeansquare" / "random_image_1.pgm")
+    };
+
+    for (int bandRows : {1, 7, 64, 1000}) {
+        std::ifstream in(input, std::ios::binary);
+        std::ostringstream luminosity, rms;
+        ASSERT_TRUE(convertPPMStream(in, methods, {&luminosity, &rms}, PnmEncoding::Plain, bandRows));
+        EXPECT_EQ(luminosity.str(), expected[0]) << "band rows " << bandRows;
+        EXPECT_EQ(rms.str(), expected[1]) << "band rows " << bandRows;
+    }
+}
+
+TEST(StreamingTest, RawStreamsMatchWholeImageConversion) {
+    RgbImage image;
+    ASSERT_TRUE(readPPM((dataDir / "input_images" / "random_image_2.ppm").string(), image));
+    std::string p6 = "P6\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+    p6.append(reinterpret_cast<const char*>(image.data.data()), image.data.size());
+
+    GrayImage expected;
+    convertToGrayscale(image, GrayscaleMethod::Average, expected);
+    std::string header = "P5\n" + std::to_string(image.width) + " " + std::to_string(image.height) + "\n255\n";
+
+    std::istringstream in(p6);
+    std::ostringstream out;
+    ASSERT_TRUE(convertPPMStream(in, {GrayscaleMethod::Average}, {&out}, PnmEncoding::Raw, 9));
+    EXPECT_EQ(out.str(), header + std::string(expected.data.begin(), expected.data.end()));
+}
+
+// tiny chunks force every token and comment to straddle a refill
+TEST(StreamingTest, TokensSpanningChunks) {
+    std::string text = "P3 # magic\n2 2 # size\n255\n10 200 # a comment\n30 40 50 60\n# another\n70 80 90 100 110 120\n";
+    RgbImage expected;
+    ASSERT_TRUE(parsePPM(text.data(), text.size(), expected));
+
+    for (std::size_t chunk : {1, 2, 3, 5, 64}) {
+        std::istringstream in(text);
+        PpmStreamReader reader(in, chunk);
+        ASSERT_TRUE(reader.readHeader());
+        RgbImage first, second;
+        ASSERT_TRUE(reader.readRows(1, first)) << "chunk " << chunk;
+        ASSERT_TRUE(reader.readRows(5, second)) << "chunk " << chunk;
+        EXPECT_EQ(reader.rowsRemaining(), 0);
+        EXPECT_TRUE(std::equal(first.data.begin(), first.data.end(), expected.row(0))) << "chunk " << chunk;
+        EXPECT_TRUE(std::equal(second.data.begin(), second.data.end(), expected.row(1))) << "chunk " << chunk;
+    }
+}
+
+TEST(StreamingTest, RejectsTruncatedInput) {
+    for (std::string text : {std::string("P3\n2 1\n255\n1 2 3 4 5\n"), std::string("P6\n2 1\n255\n\x01\x02\x03\x04", 16)}) {
+        std::istringstream in(text);
+        std::ostringstream out;
+        EXPECT_FALSE(convertPPMStream(in, {GrayscaleMethod::Average}, {&out}, PnmEncoding::Raw));
+    }
+
+    // headers far larger than the input are rejected before a band is
+    // allocated, whether the input is all buffered or seekable
+    std::string huge = "P3\n2000000000 2\n255\n";
+    std::istringstream in(huge);
+    std::ostringstream out;
+    EXPECT_FALSE(convertPPMStream(in, {GrayscaleMethod::Average}, {&out}, PnmEncoding::Raw));
+    std::string path = (fs::path(testing::TempDir()) / "huge_header.ppm").string();
+    std::ofstream(path, std::ios::binary) << "P6\n2000000000 2\n255\n" << std::string(3 << 20, '\x7f');
+    std::ifstream file(path, std::ios::binary);
+    EXPECT_FALSE(convertPPMStream(file, {GrayscaleMethod::Average}, {&out}, PnmEncoding::Raw));
+}
+
+// a 2 GiB image is converted while the resident set stays within a fixed budget
+TEST(StreamingTest, LargeImageInConstantMemory) {
+#ifndef __linux__
+    GTEST_SKIP() << "resident set size is only sampled on Linux";
+#endif
+    const int width = 16384;
+    const int height = 43691; // 3 * 16384 * 43691 bytes > 2 GiB
+    const std::size_t budget = 64u << 20;
+
+    SyntheticPpmBuffer source(width, height);
+    std::istream in(&source);
+    MeasuringSink sink;
+    std::ostream out(&sink);
+
+    std::size_t baseline = residentBytes();
+    ASSERT_TRUE(convertPPMStream(in, {GrayscaleMethod::Luminosity}, {&out}, PnmEncoding::Raw, 64));
+
+    std::string header = "P5\n" + std::to_string(width) + " " + std::to_string(height) + "\n255\n";
+    EXPECT_EQ(sink.bytes, header.size() + static_cast<std::uint64_t>(width) * height);
+    EXPECT_GT(sink.peakResident, 0u);
+    EXPECT_LT(sink.peakResident, baseline + budget)
+        << "baseline " << (baseline >> 20) << " MiB, peak " << (sink.peakResident >> 20) << " MiB";
+}
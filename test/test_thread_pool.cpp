@@ -0,0 +1,72 @@
+#include "thread_pool.hpp"
+#include <gtest/gtest.h>
+#include <atomic>
+#include <chrono>
+#include <mutex>
+#include <set>
+#include <thread>
+#include <vector>
+
+TEST(ThreadPoolTest, RunsEveryTask) {
+    ThreadPool pool(4);
+    EXPECT_EQ(pool.size(), 4u);
+
+    std::atomic<int> sum{0};
+    for (int i = 1; i <= 1000; i++)
+        pool.submit([&sum, i] { sum += i; });
+    pool.wait();
+    EXPECT_EQ(sum.load(), 1000 * 1001 / 2);
+
+    // the pool can be reused after wait()
+    pool.submit([&sum] { sum = -1; });
+    pool.wait();
+    EXPECT_EQ(sum.load(), -1);
+}
+
+TEST(ThreadPoolTest, IdleWorkersStealQueuedTasks) {
+    ThreadPool pool(4);
+    std::mutex mutex;
+    std::set<std::thread::id> threads;
+
+    // all tasks are queued on the deque of the worker running the first task;
+    // the other workers can only get them by stealing
+    pool.submit([&] {
+        for (int i = 0; i < 64; i++) {
+            pool.submit([&] {
+                std::this_thread::sleep_for(std::chrono::milliseconds(2));
+                std::lock_guard<std::mutex> lock(mutex);
+                threads.insert(std::this_thread::get_id());
+            });
+        }
+    });
+    pool.wait();
+    EXPECT_GT(threads.size(), 1u);
+}
+
+TEST(ThreadPoolTest, ParallelForRunsEveryIndexOnce) {
+    ThreadPool pool(4);
+    std::vector<std::atomic<int>> hits(1000);
+    pool.parallelFor(hits.size(), [&](size_t i) { hits[i]++; });
+    for (size_t i = 0; i < hits.size(); i++)
+        EXPECT_EQ(hits[i].load(), 1) << i;
+
+    // empty and single-index loops run on the calling thread
+    pool.parallelFor(0, [&](size_t) { FAIL(); });
+    std::thread::id caller;
+    pool.parallelFor(1, [&](size_t) { caller = std::this_thread::get_id(); });
+    EXPECT_EQ(caller, std::this_thread::get_id());
+}
+
+TEST(ThreadPoolTest, ParallelForInsideTasks) {
+    // every worker is busy in an outer task that runs its own parallel loop;
+    // the loops must complete without a free worker to help them
+    ThreadPool pool(2);
+    std::atomic<int> sum{0};
+    for (int t = 0; t < 8; t++) {
+        pool.submit([&] {
+            pool.parallelFor(100, [&](size_t i) { sum += static_cast<int>(i); });
+        });
+    }
+    pool.wait();
+    EXPECT_EQ(sum.load(), 8 * 4950);
+}
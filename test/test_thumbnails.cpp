@@ -0,0 +1,116 @@
+#include "operators.hpp"
+#include "thread_pool.hpp"
+#include "thumbnails.hpp"
+#include <gtest/gtest.h>
+#include <random>
+#include <string>
+#include <vector>
+
+namespace {
+
+// naive reference: every pixel the rounded average of its side x side block,
+// clipped at the edges
+GrayImage blockAverage(const GrayImage& image, int side) {
+    GrayImage result((image.width + side - 1) / side, (image.height + side - 1) / side);
+    for (int i = 0; i < result.height; i++) {
+        for (int j = 0; j < result.width; j++) {
+            unsigned sum = 0;
+            unsigned count = 0;
+            for (int y = i * side; y < std::min((i + 1) * side, image.height); y++)
+                for (int x = j * side; x < std::min((j + 1) * side, image.width); x++, count++)
+                    sum += image.row(y)[x];
+            result.row(i)[j] = static_cast<std::uint8_t>((sum + count / 2) / count);
+        }
+    }
+    return result;
+}
+
+std::vector<ThumbnailSpec> specs(const std::string& list) {
+    std::vector<ThumbnailSpec> parsed;
+    std::string error;
+    EXPECT_TRUE(parseThumbnailSpecs(list, parsed, error)) << list << ": " << error;
+    return parsed;
+}
+
+} // namespace
+
+TEST(ThumbnailsTest, ParsesSpecs) {
+    std::vector<ThumbnailSpec> parsed = specs("1/2,1/64,w160,1/2");
+    ASSERT_EQ(parsed.size(), 3u);
+    EXPECT_EQ(parsed[0].shift, 1);
+    EXPECT_EQ(parsed[1].shift, 6);
+    EXPECT_EQ(parsed[2].width, 160);
+    EXPECT_EQ(parsed[0].suffix(), "1-2");
+    EXPECT_EQ(parsed[2].suffix(), "w160");
+
+    std::vector<ThumbnailSpec> rejected;
+    std::string error;
+    for (const char* list : {"", "1/2,", "1/3", "1/1", "1/128", "2", "w", "w0", "w-5", "1/2x"}) {
+        EXPECT_FALSE(parseThumbnailSpecs(list, rejected, error)) << list;
+        EXPECT_FALSE(error.empty()) << list;
+    }
+
+    int width = 0;
+    int height = 0;
+    thumbnailSize(parsed[2], 1501, 701, width, height);
+    EXPECT_EQ(width, 160);
+    EXPECT_EQ(height, 75);
+    // never larger than the image
+    thumbnailSize(specs("w5000")[0], 1501, 701, width, height);
+    EXPECT_EQ(width, 1501);
+    EXPECT_EQ(height, 701);
+    EXPECT_EQ(thumbnailLevel(parsed[2], 1501, 701), 3);
+}
+
+TEST(ThumbnailsTest, ResamplesByArea) {
+    GrayImage source(3, 1);
+    source.data = {0, 90, 180};
+    GrayImage target(2, 1);
+    resampleArea(source, target);
+    // 1.5 source pixels per target pixel
+    EXPECT_EQ(target.data, (std::vector<std::uint8_t>{30, 150}));
+
+    GrayImage square(4, 4);
+    for (int i = 0; i < 16; i++) square.data[i] = static_cast<std::uint8_t>(i * 10);
+    GrayImage half(2, 2);
+    resampleArea(square, half);
+    EXPECT_TRUE(half.data == blockAverage(square, 2).data);
+}
+
+TEST(ThumbnailsTest, MipChainMatchesBlockAverages) {
+    // several row bands, odd sizes so that the last row and column of every
+    // level are partial
+    RgbImage rgb;
+    rgb.resize(1501, 701, 1501 * 3 + 5);
+    std::mt19937 random(11);
+    std::uniform_int_distribution<int> sample(0, 255);
+    for (auto& value : rgb.data) value = static_cast<std::uint8_t>(sample(random));
+
+    std::vector<OperatorChain> chains(2);
+    std::string error;
+    ASSERT_TRUE(parseOperatorChain("Luminosity|invert", chains[0], error));
+    // histogram-dependent, so its mip chain is built in the second pass
+    ASSERT_TRUE(parseOperatorChain("Average|stretch", chains[1], error));
+    std::vector<ThumbnailSpec> thumbnails = specs("1/2,1/8,1/64,w160");
+    FusedConversion conversion(chains, thumbnails);
+
+    for (unsigned threads : {1u, 3u}) {
+        ThreadPool pool(threads);
+        std::vector<GrayImage> outputs;
+        std::vector<GrayImage> results;
+        conversion.convert(rgb.view(), outputs, nullptr, &pool, &results);
+        ASSERT_GE(results.size(), chains.size() * thumbnails.size());
+        for (size_t c = 0; c < chains.size(); c++) {
+            const GrayImage* result = &results[c * thumbnails.size()];
+            EXPECT_TRUE(result[0].data == blockAverage(outputs[c], 2).data) << "chain " << c << ", " << threads;
+            EXPECT_TRUE(result[1].data == blockAverage(outputs[c], 8).data) << "chain " << c << ", " << threads;
+            EXPECT_EQ(result[2].width, 24);
+            EXPECT_EQ(result[2].height, 11);
+            EXPECT_TRUE(result[2].data == blockAverage(outputs[c], 64).data) << "chain " << c << ", " << threads;
+
+            GrayImage expected(160, 75);
+            resampleArea(blockAverage(outputs[c], 8), expected);
+            EXPECT_TRUE(result[3].data == expected.data) << "chain " << c << ", " << threads;
+        }
+    }
+}